@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Cycle benchmark of the firmware hot paths under simavr.
+
+Builds the benchmark firmware (PlatformIO environment "bench") and the
+simavr harness, runs the firmware and compares the cycle counts to
+baseline.txt. Exits with 1 if any benchmark is missing, got slower
+than its tolerance or crossed its limit. A benchmark without a
+baseline is only checked against its limit.
+
+Usage:
+    bench/bench.py            compare against the baseline
+    bench/bench.py --update   record the current counts as the baseline
+
+Needs PlatformIO, a C compiler, simavr and libelf.
+"""
+
+import os
+import subprocess
+import sys
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_DIR = os.path.dirname(BENCH_DIR)
+BUILD_DIR = os.path.join(PROJECT_DIR, ".pio", "build", "bench")
+BASELINE = os.path.join(BENCH_DIR, "baseline.txt")
+
+
+def build():
+    subprocess.run(["pio", "run", "-e", "bench"], cwd=PROJECT_DIR, check=True)
+    harness = os.path.join(BUILD_DIR, "bench_sim")
+    subprocess.run(["cc", "-O2", os.path.join(BENCH_DIR, "bench_sim.c"),
+                    "-lsimavr", "-lelf", "-o", harness], check=True)
+    return harness, os.path.join(BUILD_DIR, "firmware.elf")
+
+
+def run(harness, firmware):
+    output = subprocess.run([harness, firmware], check=True,
+                            stdout=subprocess.PIPE, text=True).stdout
+    cycles = {}
+    for line in output.splitlines():
+        name, count = line.split()
+        cycles[name] = int(count)
+    return cycles
+
+
+def read_baseline():
+    """Returns the header comment and a list of
+    [name, baseline, tolerance, limit] rows."""
+    header, rows = [], []
+    with open(BASELINE) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                header.append(line)
+                continue
+            rows.append(line.split())
+    return header, rows
+
+
+def write_baseline(header, rows):
+    with open(BASELINE, "w") as f:
+        f.writelines(header)
+        for row in rows:
+            f.write("{:<24}{:<10}{:<11}{}\n".format(*row))
+
+
+def compare(rows, cycles):
+    failed = False
+    for name, baseline, tolerance, limit in rows:
+        if name not in cycles:
+            print("{:<24}missing".format(name))
+            failed = True
+            continue
+        count = cycles[name]
+        verdict = "ok"
+        if baseline == "-":
+            # Only the limit is checked until the baseline is recorded.
+            verdict = "ok, no baseline yet"
+        elif count > int(baseline) * (100 + int(tolerance)) // 100:
+            verdict = "SLOWER than {} (+{}%)".format(baseline, tolerance)
+            failed = True
+        if limit != "-" and count > int(limit):
+            verdict = "OVER LIMIT {}".format(limit)
+            failed = True
+        print("{:<24}{:>8}  {}".format(name, count, verdict))
+    return failed
+
+
+def main():
+    update = "--update" in sys.argv[1:]
+    cycles = run(*build())
+    header, rows = read_baseline()
+
+    if update:
+        for row in rows:
+            if row[0] in cycles:
+                row[1] = str(cycles[row[0]])
+        write_baseline(header, rows)
+
+    return 1 if compare(rows, cycles) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,157 @@
+/* simavr harness for the benchmark firmware (src/bench.c).
+ * Runs the firmware on a simulated ATmega328P at 16 MHz with
+ * an SSD1306 stand-in on the I2C bus that acknowledges every
+ * byte, and prints one line per measurement:
+ *  <name> <cycles>
+ * Build: cc -O2 bench_sim.c -lsimavr -lelf -o bench_sim
+ * Usage: bench_sim firmware.elf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_twi.h>
+
+#define BENCH_F_CPU         16000000UL
+#define BENCH_OLED_ADDRESS  0x3C
+
+// Data space addresses of the marker registers
+#define BENCH_GPIOR0    0x3E
+#define BENCH_GPIOR1    0x4A
+#define BENCH_GPIOR2    0x4B
+
+// Give up after 10 simulated seconds
+#define BENCH_MAX_CYCLES (10 * BENCH_F_CPU)
+
+#define BENCH_NAME_LEN  32
+#define BENCH_DEPTH     8
+
+typedef struct bench_marker {
+    char name[BENCH_NAME_LEN];
+    avr_cycle_count_t start;
+    avr_cycle_count_t slept;    // Sleep cycles at the start, if awake only
+    uint8_t awake;
+} bench_marker_t;
+
+char bench_name[BENCH_NAME_LEN];
+uint8_t bench_name_len;
+bench_marker_t bench_stack[BENCH_DEPTH];
+uint8_t bench_depth;
+
+// Cycles the CPU spent sleeping so far
+avr_cycle_count_t bench_slept;
+
+avr_irq_t *twi_input;
+uint8_t twi_selected;
+
+/* This function collects the name of the next measurement.
+ */
+void _gpior0_write(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    if (bench_name_len < BENCH_NAME_LEN - 1) bench_name[bench_name_len++] = v;
+}
+
+/* This function starts a measurement. Measurements can
+ * be nested. Writing 2 instead of 1 leaves out the cycles
+ * in which the CPU was sleeping.
+ */
+void _gpior1_write(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    if (bench_depth == BENCH_DEPTH) {
+        fprintf(stderr, "bench_sim: measurements nested too deep\n");
+        exit(2);
+    }
+    bench_name[bench_name_len] = 0;
+    strcpy(bench_stack[bench_depth].name, bench_name);
+    bench_stack[bench_depth].start = avr->cycle;
+    bench_stack[bench_depth].slept = bench_slept;
+    bench_stack[bench_depth].awake = v == 2;
+    bench_depth++;
+    bench_name_len = 0;
+}
+
+/* This function ends the innermost measurement
+ * and prints it.
+ */
+void _gpior2_write(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    if (bench_depth == 0) {
+        fprintf(stderr, "bench_sim: end marker without a start\n");
+        exit(2);
+    }
+    bench_depth--;
+    bench_marker_t *marker = &bench_stack[bench_depth];
+    avr_cycle_count_t cycles = avr->cycle - marker->start;
+    if (marker->awake) cycles -= bench_slept - marker->slept;
+    printf("%s %llu\n", marker->name, (unsigned long long)cycles);
+}
+
+/* This function acknowledges every transfer to the
+ * display address, like the SSD1306 does.
+ */
+void _twi_hook(struct avr_irq_t *irq, uint32_t value, void *param) {
+    avr_twi_msg_irq_t msg;
+    msg.u.v = value;
+
+    if (msg.u.twi.msg & TWI_COND_STOP) twi_selected = 0;
+
+    if (msg.u.twi.msg & TWI_COND_START) {
+        twi_selected = (msg.u.twi.addr >> 1) == BENCH_OLED_ADDRESS;
+        if (twi_selected) {
+            avr_raise_irq(twi_input, avr_twi_irq_msg(TWI_COND_ACK, msg.u.twi.addr, 1));
+        }
+    }
+
+    if (twi_selected && (msg.u.twi.msg & TWI_COND_WRITE)) {
+        avr_raise_irq(twi_input, avr_twi_irq_msg(TWI_COND_ACK, msg.u.twi.addr, 1));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s firmware.elf\n", argv[0]);
+        return 2;
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[1], &firmware)) {
+        fprintf(stderr, "bench_sim: can't read %s\n", argv[1]);
+        return 2;
+    }
+    firmware.frequency = BENCH_F_CPU;
+
+    avr_t *avr = avr_make_mcu_by_name("atmega328p");
+    if (!avr) return 2;
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->log = LOG_ERROR;
+
+    avr_register_io_write(avr, BENCH_GPIOR0, _gpior0_write, 0);
+    avr_register_io_write(avr, BENCH_GPIOR1, _gpior1_write, 0);
+    avr_register_io_write(avr, BENCH_GPIOR2, _gpior2_write, 0);
+
+    twi_input = avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+                            _twi_hook, 0);
+
+    // The firmware ends the simulation by sleeping with interrupts off.
+    int state = cpu_Running;
+    while (state != cpu_Done && state != cpu_Crashed) {
+        avr_cycle_count_t cycle = avr->cycle;
+        uint8_t sleeping = avr->state == cpu_Sleeping;
+        state = avr_run(avr);
+        if (sleeping) bench_slept += avr->cycle - cycle;
+        if (avr->cycle > BENCH_MAX_CYCLES) {
+            fprintf(stderr, "bench_sim: timed out\n");
+            return 1;
+        }
+    }
+
+    if (state == cpu_Crashed || bench_depth != 0) {
+        fprintf(stderr, "bench_sim: firmware didn't finish\n");
+        return 1;
+    }
+    return 0;
+}
@@ -3,8 +3,41 @@
 
 #include <stdint.h>
 
-void buttons_init(void);
+// Button masks, T1-T4 on D4-D7
+#define BUTTON_LEFT     0x01
+#define BUTTON_RIGHT    0x02
+#define BUTTON_UP       0x04
+#define BUTTON_DOWN     0x08
+
+/* A button is pressed once its input has been low for
+ * BUTTONS_DEBOUNCE_MS longer than it has been high, and
+ * released the other way around. Held for BUTTONS_LONG_MS,
+ * it sends a long press and then repeats, starting every
+ * BUTTONS_REPEAT_MS and speeding up by a quarter with every
+ * repeat, down to BUTTONS_REPEAT_MIN_MS.
+ */
+#define BUTTONS_DEBOUNCE_MS     4
+#define BUTTONS_LONG_MS         600
+#define BUTTONS_REPEAT_MS       200
+#define BUTTONS_REPEAT_MIN_MS   40
+
+// Event types
+#define BUTTON_EVENT_PRESS      1
+#define BUTTON_EVENT_RELEASE    2
+#define BUTTON_EVENT_LONG       3
+#define BUTTON_EVENT_REPEAT     4
+
+typedef struct button_event {
+    uint8_t type;
+    uint8_t button;     // The button that caused the event
+    uint8_t state;      // All buttons that were held at the time
+    uint16_t time;      // rtos_get_time_ms()
+} button_event_t;
+
+void buttons_init(void (*wakeup)(void));
 uint8_t buttons_get_state(void);
-uint8_t buttons_get_press(void);
+void buttons_update(void);
+uint8_t buttons_idle(void);
+uint8_t buttons_get_event(button_event_t *event);
 
-#endif
\ No newline at end of file
+#endif
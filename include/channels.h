@@ -0,0 +1,33 @@
+#ifndef CHANNELS_H_INCLUDED
+#define CHANNELS_H_INCLUDED
+
+#include <stdint.h>
+#include "hal.h"
+
+/* The channel database in program memory, generated into
+ * src/channel_table.c by scripts/channels_gen.py. Channel n is
+ * channel n % CHANNEL_PER_BAND of band n / CHANNEL_PER_BAND,
+ * the bands are named by channel_band_letters.
+ */
+#define CHANNEL_BANDS       8
+#define CHANNEL_PER_BAND    8
+#define CHANNEL_COUNT       (CHANNEL_BANDS * CHANNEL_PER_BAND)
+#define CHANNEL_INDEX(band, channel) ((band) * CHANNEL_PER_BAND + (channel))
+
+typedef struct channel {
+    uint16_t freq;  // MHz
+    uint32_t word;  // The SYN_REG_B write, see video_rx_set_word()
+} channel_t;
+
+extern const char channel_band_letters[] PROGMEM;
+extern const channel_t channels[CHANNEL_COUNT] PROGMEM;
+// The channel indices sorted by frequency
+extern const uint8_t channels_by_freq[CHANNEL_COUNT] PROGMEM;
+
+uint16_t channel_freq(uint8_t index);
+uint32_t channel_word(uint8_t index);
+uint8_t channel_nth(uint8_t n);
+uint8_t channel_nearest(uint16_t freq);
+uint8_t channel_next(uint16_t freq, int8_t direction);
+
+#endif
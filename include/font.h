@@ -0,0 +1,18 @@
+#ifndef FONT_H_INCLUDED
+#define FONT_H_INCLUDED
+
+#include <stdint.h>
+#include "hal.h"
+
+/* The 6x8 font in program memory, generated from 6x8.png by
+ * scripts/font_gen.py. Glyph n is the character FONT_FIRST + n:
+ * the printable ASCII characters, a full block at 0x7F and the
+ * symbols from 0x80 on.
+ */
+#define FONT_FIRST  0x20
+#define FONT_GLYPHS 102
+#define FONT_WIDTH  6
+
+extern const uint8_t font_glyphs[FONT_GLYPHS][FONT_WIDTH] PROGMEM;
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef HAL_H_INCLUDED
+#define HAL_H_INCLUDED
+
+/* Hardware abstraction layer.
+ *
+ * Configuration registers are written directly, but every access
+ * through which the hardware reports back (flags, status, data) goes
+ * through the hal_ macros below. On the AVR they expand to exactly the
+ * register expressions the drivers used before, so the generated code
+ * is unchanged. The native build (HAL_NATIVE, see hal_native.h) turns
+ * the registers into plain variables and the macros into functions of
+ * a simulated back-end, so the drivers and tasks can run on a PC.
+ */
+
+#ifdef HAL_NATIVE
+
+#include "hal_native.h"
+
+#else
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+// I2C (TWI)
+#define hal_twi_set_control(value)  (TWCR = (value))
+#define hal_twi_control()           (TWCR)
+#define hal_twi_status()            (TWSR & 0xF8)
+#define hal_twi_set_data(value)     (TWDR = (value))
+
+// SPI
+#define hal_spi_set_data(value)     (SPDR = (value))
+#define hal_spi_done()              (SPSR & (1 << SPIF))
+
+// ADC
+#define hal_adc_result()            (ADC)
+#define hal_adc_busy()              (ADCSRA & (1 << ADSC))
+
+// Buttons on D4-D7
+#define hal_buttons_pins()          (PIND)
+
+/* EEPROM. The write must be called with interrupts disabled,
+ * EEPE has to be set within 4 cycles after EEMPE.
+ */
+#define hal_eeprom_busy()                   (EECR & (1 << EEPE))
+#define hal_eeprom_read(address)            (EEAR = (address), EECR |= (1 << EERE), EEDR)
+#define hal_eeprom_write(address, value)    (EEAR = (address), EEDR = (value), \
+                                             EECR |= (1 << EEMPE), EECR |= (1 << EEPE))
+
+// USART0
+#define hal_uart_set_data(value)    (UDR0 = (value))
+#define hal_uart_data()             (UDR0)
+
+// Stack pointer
+#define hal_stack_pointer()         (SP)
+
+// Reset flags
+#define hal_reset_flags()           (MCUSR)
+
+// Variables that the C runtime doesn't clear, they survive a reset
+#define HAL_NOINIT                  __attribute__((section(".noinit")))
+
+// Timer1 (RTOS slice timer)
+#define hal_timer1_count()          (TCNT1)
+#define hal_timer1_pending()        (TIFR1 & (1 << ICF1))
+
+#endif
+
+#endif
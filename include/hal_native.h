@@ -0,0 +1,503 @@
+#ifndef HAL_NATIVE_H_INCLUDED
+#define HAL_NATIVE_H_INCLUDED
+
+/* Native (PC) back-end of the hardware abstraction layer.
+ *
+ * The ATmega328P registers are plain variables, defined in
+ * hal_native.c. Interrupt handlers become ordinary functions named
+ * after their vector, so a test can call them directly. The hal_
+ * functions simulate just enough of the hardware for the drivers:
+ * the TWI answers like an SSD1306 at the configured address, SPI
+ * and UART transfers complete at once, and the ADC, buttons and
+ * Timer1 return whatever the test put into the hal_native_ variables.
+ * Bytes sent over TWI, SPI and the UART are recorded for inspection.
+ */
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+// 8-bit registers
+extern volatile uint8_t PORTB;
+extern volatile uint8_t DDRB;
+extern volatile uint8_t PINB;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t DDRC;
+extern volatile uint8_t PINC;
+extern volatile uint8_t PORTD;
+extern volatile uint8_t DDRD;
+extern volatile uint8_t PIND;
+extern volatile uint8_t TWCR;
+extern volatile uint8_t TWDR;
+extern volatile uint8_t TWSR;
+extern volatile uint8_t TWBR;
+extern volatile uint8_t TWAR;
+extern volatile uint8_t TWAMR;
+extern volatile uint8_t SPCR;
+extern volatile uint8_t SPSR;
+extern volatile uint8_t SPDR;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCL;
+extern volatile uint8_t ADCH;
+extern volatile uint8_t DIDR0;
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint8_t TCCR1C;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+extern volatile uint8_t TCCR0A;
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t OCR0B;
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t TIFR0;
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t TCNT2;
+extern volatile uint8_t OCR2A;
+extern volatile uint8_t OCR2B;
+extern volatile uint8_t TIMSK2;
+extern volatile uint8_t TIFR2;
+extern volatile uint8_t ASSR;
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCMSK0;
+extern volatile uint8_t PCMSK1;
+extern volatile uint8_t PCMSK2;
+extern volatile uint8_t PCIFR;
+extern volatile uint8_t EICRA;
+extern volatile uint8_t EIMSK;
+extern volatile uint8_t EECR;
+extern volatile uint8_t EEDR;
+extern volatile uint8_t SMCR;
+extern volatile uint8_t MCUCR;
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t PRR;
+extern volatile uint8_t WDTCSR;
+extern volatile uint8_t UCSR0A;
+extern volatile uint8_t UCSR0B;
+extern volatile uint8_t UCSR0C;
+extern volatile uint8_t UDR0;
+extern volatile uint8_t GPIOR0;
+extern volatile uint8_t GPIOR1;
+extern volatile uint8_t GPIOR2;
+extern volatile uint8_t SREG;
+extern volatile uint8_t ACSR;
+
+// 16-bit registers
+extern volatile uint16_t ADC;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t ICR1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint16_t EEAR;
+extern volatile uint16_t UBRR0;
+extern volatile uint16_t SP;
+
+// Register bits
+#define TWIE      0
+#define TWEN      2
+#define TWWC      3
+#define TWSTO     4
+#define TWSTA     5
+#define TWEA      6
+#define TWINT     7
+
+#define TWPS0     0
+#define TWPS1     1
+#define TWS3      3
+#define TWS4      4
+#define TWS5      5
+#define TWS6      6
+#define TWS7      7
+
+#define SPR0      0
+#define SPR1      1
+#define CPHA      2
+#define CPOL      3
+#define MSTR      4
+#define DORD      5
+#define SPE       6
+#define SPIE      7
+
+#define SPI2X     0
+#define WCOL      6
+#define SPIF      7
+
+#define ADPS0     0
+#define ADPS1     1
+#define ADPS2     2
+#define ADIE      3
+#define ADIF      4
+#define ADATE     5
+#define ADSC      6
+#define ADEN      7
+
+#define ADTS0     0
+#define ADTS1     1
+#define ADTS2     2
+#define ACME      6
+
+#define MUX0      0
+#define MUX1      1
+#define MUX2      2
+#define MUX3      3
+#define ADLAR     5
+#define REFS0     6
+#define REFS1     7
+
+#define ADC0D     0
+#define ADC1D     1
+#define ADC2D     2
+#define ADC3D     3
+#define ADC4D     4
+#define ADC5D     5
+
+#define WGM10     0
+#define WGM11     1
+#define COM1B0    4
+#define COM1B1    5
+#define COM1A0    6
+#define COM1A1    7
+
+#define CS10      0
+#define CS11      1
+#define CS12      2
+#define WGM12     3
+#define WGM13     4
+#define ICES1     6
+#define ICNC1     7
+
+#define TOIE1     0
+#define OCIE1A    1
+#define OCIE1B    2
+#define ICIE1     5
+
+#define TOV1      0
+#define OCF1A     1
+#define OCF1B     2
+#define ICF1      5
+
+#define WGM00     0
+#define WGM01     1
+#define COM0B0    4
+#define COM0B1    5
+#define COM0A0    6
+#define COM0A1    7
+
+#define CS00      0
+#define CS01      1
+#define CS02      2
+#define WGM02     3
+#define FOC0B     6
+#define FOC0A     7
+
+#define TOIE0     0
+#define OCIE0A    1
+#define OCIE0B    2
+
+#define TOV0      0
+#define OCF0A     1
+#define OCF0B     2
+
+#define WGM20     0
+#define WGM21     1
+#define COM2B0    4
+#define COM2B1    5
+#define COM2A0    6
+#define COM2A1    7
+
+#define CS20      0
+#define CS21      1
+#define CS22      2
+#define WGM22     3
+#define FOC2B     6
+#define FOC2A     7
+
+#define TOIE2     0
+#define OCIE2A    1
+#define OCIE2B    2
+
+#define TOV2      0
+#define OCF2A     1
+#define OCF2B     2
+
+#define PCIE0     0
+#define PCIE1     1
+#define PCIE2     2
+
+#define PCIF0     0
+#define PCIF1     1
+#define PCIF2     2
+
+#define PCINT16   0
+#define PCINT17   1
+#define PCINT18   2
+#define PCINT19   3
+#define PCINT20   4
+#define PCINT21   5
+#define PCINT22   6
+#define PCINT23   7
+
+#define EERE      0
+#define EEPE      1
+#define EEMPE     2
+#define EERIE     3
+#define EEPM0     4
+#define EEPM1     5
+
+#define SE        0
+#define SM0       1
+#define SM1       2
+#define SM2       3
+
+#define IVCE      0
+#define IVSEL     1
+#define PUD       4
+#define BODSE     5
+#define BODS      6
+
+#define PORF      0
+#define EXTRF     1
+#define BORF      2
+#define WDRF      3
+
+#define PRADC     0
+#define PRUSART0  1
+#define PRSPI     2
+#define PRTIM1    3
+#define PRTIM0    5
+#define PRTIM2    6
+#define PRTWI     7
+
+#define ACD       7
+
+#define WDP0      0
+#define WDP1      1
+#define WDP2      2
+#define WDE       3
+#define WDCE      4
+#define WDP3      5
+#define WDIE      6
+#define WDIF      7
+
+#define MPCM0     0
+#define U2X0      1
+#define UPE0      2
+#define DOR0      3
+#define FE0       4
+#define UDRE0     5
+#define TXC0      6
+#define RXC0      7
+
+#define TXB80     0
+#define RXB80     1
+#define UCSZ02    2
+#define TXEN0     3
+#define RXEN0     4
+#define UDRIE0    5
+#define TXCIE0    6
+#define RXCIE0    7
+
+#define UCPOL0    0
+#define UCSZ00    1
+#define UCSZ01    2
+#define USBS0     3
+#define UPM00     4
+#define UPM01     5
+#define UMSEL00   6
+#define UMSEL01   7
+
+// Port bits
+#define DDB0      0
+#define DDB1      1
+#define DDB2      2
+#define DDB3      3
+#define DDB4      4
+#define DDB5      5
+#define DDB6      6
+#define DDB7      7
+#define PORTB0    0
+#define PORTB1    1
+#define PORTB2    2
+#define PORTB3    3
+#define PORTB4    4
+#define PORTB5    5
+#define PORTB6    6
+#define PORTB7    7
+#define PINB0     0
+#define PINB1     1
+#define PINB2     2
+#define PINB3     3
+#define PINB4     4
+#define PINB5     5
+#define PINB6     6
+#define PINB7     7
+
+#define DDC0      0
+#define DDC1      1
+#define DDC2      2
+#define DDC3      3
+#define DDC4      4
+#define DDC5      5
+#define DDC6      6
+#define DDC7      7
+#define PORTC0    0
+#define PORTC1    1
+#define PORTC2    2
+#define PORTC3    3
+#define PORTC4    4
+#define PORTC5    5
+#define PORTC6    6
+#define PORTC7    7
+#define PINC0     0
+#define PINC1     1
+#define PINC2     2
+#define PINC3     3
+#define PINC4     4
+#define PINC5     5
+#define PINC6     6
+#define PINC7     7
+
+#define DDD0      0
+#define DDD1      1
+#define DDD2      2
+#define DDD3      3
+#define DDD4      4
+#define DDD5      5
+#define DDD6      6
+#define DDD7      7
+#define PORTD0    0
+#define PORTD1    1
+#define PORTD2    2
+#define PORTD3    3
+#define PORTD4    4
+#define PORTD5    5
+#define PORTD6    6
+#define PORTD7    7
+#define PIND0     0
+#define PIND1     1
+#define PIND2     2
+#define PIND3     3
+#define PIND4     4
+#define PIND5     5
+#define PIND6     6
+#define PIND7     7
+
+#define _BV(bit)    (1 << (bit))
+#define RAMEND      0x08FF
+#define E2END       0x03FF
+
+// Interrupts
+#define ISR(vector, ...)    void vector(void)
+#define sei()               (SREG |= 0x80)
+#define cli()               (SREG &= ~0x80)
+
+void TIMER1_CAPT_vect(void);
+void TWI_vect(void);
+void ADC_vect(void);
+void PCINT2_vect(void);
+void EE_READY_vect(void);
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+void WDT_vect(void);
+
+// Sleep modes do nothing, there is nothing to wake up from
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_ADC          2
+#define SLEEP_MODE_PWR_DOWN     4
+#define SLEEP_MODE_PWR_SAVE     6
+#define set_sleep_mode(mode)    ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+#define sleep_mode()
+
+// The watchdog is only configured, it never resets
+#define WDTO_15MS               0
+#define WDTO_30MS               1
+#define WDTO_60MS               2
+#define WDTO_120MS              3
+#define WDTO_250MS              4
+#define WDTO_500MS              5
+#define WDTO_1S                 6
+#define WDTO_2S                 7
+#define wdt_enable(timeout)     (WDTCSR = (1 << WDE) | (timeout))
+#define wdt_disable()           (WDTCSR = 0)
+#define wdt_reset()
+
+// Nothing survives a reset
+#define HAL_NOINIT
+
+// There is only one address space
+#define PROGMEM
+#define PGM_P                   const char *
+#define PSTR(s)                 (s)
+#define pgm_read_byte(address)  (*(const uint8_t *)(address))
+#define pgm_read_word(address)  (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_ptr(address)   (*(const void * const *)(address))
+
+// Delays only advance the simulated time
+#define _delay_us(us)   hal_native_delay_us(us)
+#define _delay_ms(ms)   hal_native_delay_us((ms) * 1000UL)
+void hal_native_delay_us(uint32_t us);
+extern uint32_t hal_native_time_us;
+
+// Simulated peripherals, see hal.h for the AVR versions
+void hal_twi_set_control(uint8_t value);
+uint8_t hal_twi_control(void);
+uint8_t hal_twi_status(void);
+void hal_twi_set_data(uint8_t value);
+
+void hal_spi_set_data(uint8_t value);
+uint8_t hal_spi_done(void);
+
+uint16_t hal_adc_result(void);
+uint8_t hal_adc_busy(void);
+
+uint8_t hal_buttons_pins(void);
+
+uint8_t hal_eeprom_busy(void);
+uint8_t hal_eeprom_read(uint16_t address);
+void hal_eeprom_write(uint16_t address, uint8_t value);
+
+void hal_uart_set_data(uint8_t value);
+uint8_t hal_uart_data(void);
+
+uint16_t hal_stack_pointer(void);
+
+uint8_t hal_reset_flags(void);
+
+uint16_t hal_timer1_count(void);
+uint8_t hal_timer1_pending(void);
+
+// Inputs of the simulation, set by the test
+extern uint8_t hal_native_twi_address;  // Address that ACKs, 0 for none
+extern uint16_t hal_native_adc;         // ADC result
+extern uint8_t hal_native_pind;         // PIND, buttons pull to GND
+
+// Contents of the simulated EEPROM, starts out erased (0xFF)
+#define HAL_NATIVE_EEPROM_LEN 1024
+extern uint8_t hal_native_eeprom[HAL_NATIVE_EEPROM_LEN];
+
+// Traffic recorded by the simulation
+#define HAL_NATIVE_LOG_LEN 4096
+extern uint8_t hal_native_twi_log[HAL_NATIVE_LOG_LEN];
+extern uint16_t hal_native_twi_log_len;
+extern uint8_t hal_native_spi_log[HAL_NATIVE_LOG_LEN];
+extern uint16_t hal_native_spi_log_len;
+extern uint8_t hal_native_uart_log[HAL_NATIVE_LOG_LEN];
+extern uint16_t hal_native_uart_log_len;
+
+void hal_native_run_twi(void);
+void hal_native_run_eeprom(void);
+void hal_native_run_uart(void);
+void hal_native_uart_receive(uint8_t byte);
+void hal_native_reset(void);
+
+#endif
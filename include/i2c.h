@@ -0,0 +1,58 @@
+#ifndef I2C_H_INCLUDED
+#define I2C_H_INCLUDED
+
+#include <stdint.h>
+
+/* SCL frequency. The SSD1306 supports fast mode (400 kHz),
+ * set it to 100000 for standard mode on long or weak buses.
+ */
+#ifndef I2C_SCL_HZ
+#define I2C_SCL_HZ 400000UL
+#endif
+
+// Size of the transaction queue and of the byte buffer behind it
+#define I2C_QUEUE_LEN   8
+#define I2C_BUFFER_LEN  128
+
+/* Transactions that don't complete within this many RTOS
+ * slices are aborted and the bus is recovered.
+ */
+#define I2C_TIMEOUT_TICKS 4
+
+/* The blocking functions and i2c_wait_idle() give up on
+ * the TWI after this many microseconds without progress.
+ */
+#define I2C_WAIT_TIMEOUT_US 1000
+
+// Transaction status codes passed to the completion callback
+#define I2C_OK          0
+#define I2C_NACK        1
+#define I2C_BUS_ERROR   2
+#define I2C_TIMEOUT     3
+
+typedef void (* i2c_callback)(uint8_t status);
+
+void i2c_init(void);
+
+/* Blocking functions. A return value of 0 means success,
+ * other values indicate an error.
+ */
+uint8_t i2c_start(uint8_t address);
+uint8_t i2c_write(uint8_t data);
+void i2c_stop(void);
+
+/* Queued (non-blocking) functions. A transaction is built with
+ * i2c_queue_begin() and i2c_queue_put() and handed over to the
+ * interrupt driven engine with i2c_queue_commit(). The callback
+ * is called from interrupt context once it completes.
+ */
+uint8_t i2c_queue_begin(uint8_t address, i2c_callback callback);
+uint8_t i2c_queue_put(uint8_t data);
+uint8_t i2c_queue_commit(void);
+uint8_t i2c_queue_free(void);
+uint8_t i2c_busy(void);
+uint8_t i2c_wait_idle(void);
+void i2c_poll(void);
+void i2c_recover_bus(void);
+
+#endif
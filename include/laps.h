@@ -0,0 +1,72 @@
+#ifndef LAPS_H_INCLUDED
+#define LAPS_H_INCLUDED
+
+#include <stdint.h>
+
+/* Lap timing on the RSSI of a quad that passes the receiver.
+ *
+ * Every raw RSSI sample (VIDEO_RX_SAMPLE_US apart, ~2.4 kHz) goes
+ * through a 1/2^n exponential filter. A pass starts when the
+ * filtered RSSI rises to the enter threshold and ends when it falls
+ * below the exit threshold, and its time is the middle of the peak
+ * in between, to half a sample (~0.2 ms). The first pass after
+ * laps_start() only starts the clock, every one after it ends a lap.
+ * Passes sooner than the shortest lap after the last one are
+ * ignored, the quad can't be back that soon.
+ *
+ * The times count the samples, so they are as accurate as the ADC
+ * clock, and they have the delay of the filter, which is the same
+ * for every pass. They wrap around after ~71 minutes, lap times
+ * are differences and stay right.
+ */
+
+// Defaults of the configuration, the thresholds are RSSI (0-99)
+#ifndef LAPS_ENTER_RSSI
+#define LAPS_ENTER_RSSI     60
+#endif
+#ifndef LAPS_EXIT_RSSI
+#define LAPS_EXIT_RSSI      45
+#endif
+#ifndef LAPS_FILTER_SHIFT
+#define LAPS_FILTER_SHIFT   3
+#endif
+#ifndef LAPS_MIN_LAP_MS
+#define LAPS_MIN_LAP_MS     3000
+#endif
+
+// Largest filter shift laps_configure() takes
+#define LAPS_FILTER_MAX     8
+
+// Number of the newest lap times that are kept, must be a power of 2
+#define LAPS_LEN            8
+
+typedef struct laps_config {
+    uint8_t enter;          // RSSI that starts a pass
+    uint8_t exit;           // RSSI that ends it, below enter
+    uint8_t filter;         // Filter shift n, 0 for no filter
+    uint16_t min_lap_ms;    // Shortest lap
+} laps_config_t;
+
+typedef struct laps_pass {
+    uint16_t lap;           // Number of the lap it ended, 0 if it started the clock
+    uint32_t time_us;       // Time of the peak since laps_start()
+    uint32_t lap_us;        // Time since the pass before, 0 if it started the clock
+    uint8_t peak;           // Filtered RSSI at the peak
+} laps_pass_t;
+
+uint8_t laps_configure(const laps_config_t *config);
+void laps_get_config(laps_config_t *config);
+void laps_start(uint16_t freq);
+void laps_stop(void);
+uint8_t laps_running(void);
+uint16_t laps_freq(void);
+uint8_t laps_process(const uint16_t *samples, uint8_t count);
+void laps_skip(uint8_t count);
+uint16_t laps_count(void);
+uint32_t laps_time(uint8_t back);
+uint32_t laps_best(void);
+uint16_t laps_passes(void);
+void laps_last_pass(laps_pass_t *pass);
+uint8_t laps_rssi(void);
+
+#endif
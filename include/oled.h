@@ -2,36 +2,87 @@
 #define OLED_H_INCLUDED
 
 #include <stdint.h>
+#include "font.h"
+
+#define OLED_ADDRESS 0x3C
 
-uint8_t i2c_start(void);
-void i2c_stop(void);
 uint8_t oled_init(void);
+uint8_t oled_display_on(void);
+
+/* Streaming functions. A transaction is opened with
+ * oled_command_begin() or oled_data_begin(), any number of
+ * bytes is sent with oled_stream() or oled_stream_fill()
+ * and the transaction is closed with oled_end().
+ */
+uint8_t oled_command_begin(void);
+uint8_t oled_data_begin(void);
+uint8_t oled_stream(const uint8_t *data, uint16_t len);
+uint8_t oled_stream_fill(uint8_t value, uint16_t len);
+void oled_end(void);
+uint8_t oled_set_window(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1);
+uint8_t oled_fill_region(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1, uint8_t value);
+uint8_t oled_clear_region(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1);
 uint8_t oled_raw_write(uint8_t data);
 uint8_t oled_raw_set_position(uint8_t x, uint8_t y);
 uint8_t oled_write_num_fixed(uint32_t n, uint8_t len, uint8_t x, uint8_t y, uint8_t invert);
-uint8_t oled_write_text(char *text, uint8_t x, uint8_t y, uint8_t invert);
-uint8_t oled_write_symbol(char *symbols, uint8_t x, uint8_t y, uint8_t invert);
-
-/* Macros for symbols, can be concatenated. For example:
- * OLED_A OLED_B OLED_E is equal to "012", which can be
- * used for oled_write_text().
- */ 
-#define OLED_A  "0"
-#define OLED_B  "1"
-#define OLED_E  "2"
-#define OLED_F  "3"
-#define OLED_H  "4"
-#define OLED_I  "5"
-#define OLED_M  "6"
-#define OLED_R  "7"
-#define OLED_S  "8"
-#define OLED_z  "9"
-
-#define OLED_SMALL_DOT  "0"
-#define OLED_LARGE_DOT  "1"
-#define OLED_LEFT       "2"
-#define OLED_RIGHT      "3"
-#define OLED_UP         "4"
-#define OLED_DOWN       "5"
+uint8_t oled_write_text(const char *text, uint8_t x, uint8_t y, uint8_t invert);
+uint8_t oled_clear(void);
+
+/* Tile map functions. The screen is split into a grid of 6x8
+ * tiles, and these functions only change the shadow copy in RAM.
+ * oled_flush() then sends just the tiles that changed.
+ */
+void oled_tile_set(uint8_t col, uint8_t row, uint8_t glyph, uint8_t invert);
+void oled_tile_invalidate(void);
+void oled_tile_reserve(uint8_t rows);
+void oled_tile_num_fixed(uint32_t n, uint8_t len, uint8_t col, uint8_t row, uint8_t invert);
+void oled_tile_text(const char *text, uint8_t col, uint8_t row, uint8_t invert);
+void oled_tile_text_P(PGM_P text, uint8_t col, uint8_t row, uint8_t invert);
+void oled_tile_fill(uint8_t glyph, uint8_t len, uint8_t col, uint8_t row, uint8_t invert);
+uint8_t oled_flush(void);
+
+/* Queued versions of the functions above. They return as soon as
+ * the data is in the I2C queue. Errors that happen later, while the
+ * data is being sent, are reported by oled_async_error().
+ */
+uint8_t oled_init_async(void);
+uint8_t oled_write_num_fixed_async(uint32_t n, uint8_t len, uint8_t x, uint8_t y, uint8_t invert);
+uint8_t oled_write_text_async(const char *text, uint8_t x, uint8_t y, uint8_t invert);
+uint8_t oled_fill_region_async(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1, uint8_t value);
+uint8_t oled_bar_async(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1, uint8_t height, uint8_t old_height);
+uint8_t oled_flush_async(void);
+uint8_t oled_async_error(void);
+
+/* Tile map geometry. The 21 tile columns cover pixels 1-126,
+ * pixel columns 0 and 127 are outside of the tile map.
+ */
+#define OLED_TILE_COLS  21
+#define OLED_TILE_ROWS  8
+#define OLED_TILE_WIDTH 6
+#define OLED_TILE_X0    1
+
+// Longest number the num_fixed functions write
+#define OLED_NUM_MAX_LEN 10
+
+/* Glyph indices for oled_tile_set() and oled_tile_fill().
+ * OLED_GLYPH(c) is the glyph of the character c, and the
+ * digits follow each other from OLED_GLYPH_DIGIT.
+ */
+#define OLED_GLYPH(c)       ((uint8_t)(c) - FONT_FIRST)
+#define OLED_GLYPH_BLANK    OLED_GLYPH(' ')
+#define OLED_GLYPH_DIGIT    OLED_GLYPH('0')
+#define OLED_GLYPH_BLOCK    OLED_GLYPH(0x7F)
+
+/* Symbols, as characters above the ASCII range. They can be
+ * concatenated with other strings, for example "RSSI" OLED_UP.
+ * Use the macros instead of writing the escapes by hand, a hex
+ * escape takes in all the hex digits that follow it.
+ */
+#define OLED_SMALL_DOT  "\x80"
+#define OLED_LARGE_DOT  "\x81"
+#define OLED_LEFT       "\x82"
+#define OLED_RIGHT      "\x83"
+#define OLED_UP         "\x84"
+#define OLED_DOWN       "\x85"
 
 #endif
\ No newline at end of file
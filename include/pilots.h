@@ -0,0 +1,40 @@
+#ifndef PILOTS_H_INCLUDED
+#define PILOTS_H_INCLUDED
+
+#include <stdint.h>
+
+/* Watches the RSSI of up to PILOTS_MAX pilots on channels of the
+ * channel database (channels.h) by hopping between them.
+ *
+ * The channels are visited in a zig-zag through their frequencies,
+ * every other one on the way up and the rest on the way down, so no
+ * hop is longer than two neighbours and there is no long jump back
+ * to the start. Every hop waits the scan's settle time (scan.h) for
+ * its size, with 8 Raceband pilots that is 2 slices per hop, ~12
+ * readings per second of every pilot. Odd channels are measured 1
+ * MHz lower, without the slow SYN_REG_A write.
+ */
+#define PILOTS_MAX          8
+
+// Slot without a channel
+#define PILOTS_NONE         0xFF
+
+/* The readings of a pilot go through a 1/2^n exponential filter.
+ * A pilot is lost when the filtered RSSI falls below
+ * PILOTS_LOST_RSSI, and found again PILOTS_LOST_HYSTERESIS above.
+ */
+#define PILOTS_FILTER_SHIFT     2
+#define PILOTS_LOST_RSSI        30
+#define PILOTS_LOST_HYSTERESIS  5
+
+uint8_t pilots_set_channel(uint8_t slot, uint8_t index);
+uint8_t pilots_channel(uint8_t slot);
+void pilots_start(void);
+void pilots_stop(void);
+uint8_t pilots_running(void);
+uint8_t pilots_step(void);
+uint8_t pilots_rssi(uint8_t slot);
+uint8_t pilots_lost(uint8_t slot);
+uint16_t pilots_cycle_ms(void);
+
+#endif
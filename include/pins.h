@@ -1,7 +1,7 @@
 #ifndef PINS_H_INCLUDED
 #define PINS_H_INCLUDED
 
-#include <avr/io.h>
+#include "hal.h"
 
 // Register level macro "functions"
 #define _setGpioOutput(port, pin)       DDR##port |=  (1 << pin)
@@ -9,6 +9,8 @@
 #define _setGpioInputPullup(port, pin)  DDR##port &= ~(1 << pin), PORT##port |=  (1 << pin)
 #define _setGpioHigh(port, pin)         PORT##port |=  (1 << pin)
 #define _setGpioLow(port, pin)          PORT##port &= ~(1 << pin)
+#define _readGpio(port, pin)            (PIN##port & (1 << pin))
+#define _toggleGpio(port, pin)          PIN##port = (1 << pin)
 
 // Helper functions, so parameters match
 #define setGpioOutput(...)              _setGpioOutput(__VA_ARGS__)
@@ -16,9 +18,15 @@
 #define setGpioInputPullup(...)         _setGpioInputPullup(__VA_ARGS__)
 #define setGpioHigh(...)                _setGpioHigh(__VA_ARGS__)
 #define setGpioLow(...)                 _setGpioLow(__VA_ARGS__)
+#define readGpio(...)                   _readGpio(__VA_ARGS__)
+#define toggleGpio(...)                 _toggleGpio(__VA_ARGS__)
 
 // Pin definitions
-#define LED_BUILTIN D,1
 #define VIDEO_RX_CS B,2
+#define VIDEO_RX_B_CS   B,1     // Second RX, diversity only
+#define VIDEO_SWITCH    D,2     // Video switch, high selects the second RX
+#define I2C_SDA     C,4
+#define I2C_SCL     C,5
+#define TRACE_PIN   D,3     // Latency trace, only with TRACE_GPIO
 
 #endif
\ No newline at end of file
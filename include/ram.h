@@ -0,0 +1,19 @@
+#ifndef RAM_H_INCLUDED
+#define RAM_H_INCLUDED
+
+#include <stdint.h>
+
+/* At reset, before anything runs, the RAM between the end of
+ * .bss and the top of the stack is filled with RAM_CANARY. The
+ * stack overwrites it as it grows, so the lowest byte that is not
+ * a canary anymore is the deepest the stack has ever been,
+ * interrupts included. There is no heap (no malloc()).
+ */
+#define RAM_CANARY 0xC5
+
+uint16_t ram_static(void);
+uint16_t ram_stack_peak(void);
+uint16_t ram_stack_free(void);
+uint16_t ram_stack_now(void);
+
+#endif
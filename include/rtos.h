@@ -6,14 +6,80 @@
 // Kazalec na funkcijo
 typedef void (* ptr_function)(void);
 
+// Dolžina časovne rezine v mikrosekundah
+#define RTOS_SLICE_US 5000
+
+/* Statistika izvajanja opravila. Čase meri RTOS s
+ * Timer1 (ločljivost 0,5 us), povprečje in obremenitev
+ * se osvežita vsakih RTOS_STATS_WINDOW rezin.
+ */
+#define RTOS_STATS_WINDOW 200
+
+/* Brez tiktakanja: ko nobeno opravilo ni pripravljeno in
+ * se v naslednjih rezinah nobeno ne sprosti, rtos_idle()
+ * podaljša trenutno rezino do naslednje sprostitve, da
+ * časovnik procesorja ne zbuja po nepotrebnem.
+ */
+#ifndef RTOS_TICKLESS
+#define RTOS_TICKLESS 1
+#endif
+
+/* Ravnanje ob zamujenem roku. Opravila se ne da prekiniti,
+ * zato se zamuda vedno le prešteje (stats.misses), rok pa
+ * začne teči znova od trenutne rezine. Pravilo določi, kaj
+ * se zgodi z zamujeno sprostitvijo, ki se še ni izvedla.
+ */
+#define RTOS_OVERRUN_DEFER  0   // Ostane pripravljena in se izvede, ko je procesor prost
+#define RTOS_OVERRUN_SKIP   1   // Se opusti, opravilo čaka na naslednjo periodo
+#define RTOS_OVERRUN_SHED   2   // Kot SKIP, poleg tega se opravilo po zamudi
+                                // kateregakoli opravila RTOS_SHED_SLICES rezin ne sprošča
+
+// Trajanje razbremenitve po zamudi v rezinah
+#define RTOS_SHED_SLICES 200
+
+typedef struct rtos_stats {
+    uint16_t min_us;    // Najkrajše izvajanje
+    uint16_t max_us;    // Najdaljše izvajanje
+    uint16_t avg_us;    // Povprečje v zadnjem oknu
+    uint16_t load;      // Delež procesorja v zadnjem oknu v 1/1000
+    uint16_t overruns;  // Izvajanja, daljša od wcet_us
+    uint16_t misses;    // Zamujeni roki
+    uint16_t stack;     // Največja vzorčena globina sklada v bajtih
+
+    // Seštevek trenutnega okna
+    uint32_t window_us;
+    uint16_t window_runs;
+} rtos_stats_t;
+
+// Stanja opravila
+#define RTOS_TASK_IDLE      0
+#define RTOS_TASK_READY     1
+#define RTOS_TASK_RUNNING   2
+
 typedef struct rtos_task {
     ptr_function driver;
     ptr_function init;
+    uint8_t period;     // Perioda v časovnih rezinah
+    uint8_t priority;   // Prioriteta, 0 je najvišja
+    uint8_t deadline;   // Relativni rok v rezinah, 0 pomeni enak periodi
+    uint16_t wcet_us;   // Najdaljši čas izvajanja v mikrosekundah
+    uint8_t overrun;    // Ravnanje ob zamujenem roku, RTOS_OVERRUN_
+
+    // Notranje stanje, ki ga vodi RTOS
+    uint8_t countdown;
+    uint8_t state;
+    uint8_t suspended;  // Ne sprošča se, dokler ga ne zbudi rtos_resume()
+    uint16_t release_tick;
+    uint8_t released;   // Sprostitev med izvajanjem, čaka na konec izvajanja
+    uint16_t released_tick;
+    rtos_stats_t stats;
 } rtos_task_t;
 
 /* Sprejme velikost časovne rezine.
  * Konfigurira SysTick timer.
- * Vrne 0 če je ok, sicer je predolga rezina.
+ * Vrne 0 če je ok, 1 če je predolga rezina
+ * in 2 če opravila skupaj presegajo 100 %
+ * procesorskega časa (glede na wcet_us).
  */
 uint8_t rtos_init(uint16_t slice_us);
 
@@ -27,4 +93,65 @@ void rtos_enable(void);
  */
 void rtos_disable(void);
 
+/* Izvede pripravljeno opravilo z najvišjo prioriteto.
+ * Kliče se iz glavne zanke.
+ * Vrne 1 če je bilo opravilo izvedeno, sicer 0.
+ */
+uint8_t rtos_dispatch(void);
+
+/* Uspava procesor do naslednje prekinitve, če nobeno
+ * opravilo ni pripravljeno. Kliče se iz glavne zanke,
+ * kadar rtos_dispatch() vrne 0.
+ */
+void rtos_idle(void);
+
+/* Opravilo se ne sprošča več periodično, dokler ga
+ * ne zbudi rtos_resume(). Kliče ga opravilo samo,
+ * ko nima več dela.
+ */
+void rtos_suspend(rtos_task_t *task);
+
+/* Zbudi ustavljeno opravilo in ga takoj sprosti.
+ * Lahko se kliče tudi iz prekinitve.
+ */
+void rtos_resume(rtos_task_t *task);
+
+/* Vrne statistiko i-tega opravila v seznamu
+ * ali 0, če opravilo ne obstaja.
+ */
+const rtos_stats_t *rtos_get_stats(uint8_t i);
+
+/* Vrne skupno obremenitev procesorja
+ * v zadnjem oknu v 1/1000.
+ */
+uint16_t rtos_get_load(void);
+
+/* Pobriše najkrajše in najdaljše čase, števce
+ * prekoračitev in zamud ter vzorce sklada vseh
+ * opravil.
+ */
+void rtos_stats_reset(void);
+
+/* Vrne število časovnih rezin od zagona RTOS.
+ * Števec se po 65535 preliva nazaj na 0.
+ */
+uint16_t rtos_get_ticks(void);
+
+/* Vrne čas od zagona RTOS v milisekundah. Rezina
+ * mora biti dolga celo število milisekund. Tudi ta
+ * števec se preliva, razlike se računajo kot uint16_t.
+ */
+uint16_t rtos_get_time_ms(void);
+
+/* Vrne čas od zagona RTOS v mikrosekundah. Preliva
+ * se skupaj s števcem rezin, po 65536 rezinah, zato
+ * razlike veljajo le, če med njima ni bilo preliva.
+ */
+uint32_t rtos_get_time_us(void);
+
+/* Vrne število mikrosekund, ki so pretekle od časa,
+ * ki ga je vrnila rtos_get_time_us(), tudi čez preliv.
+ */
+uint32_t rtos_elapsed_us(uint32_t since);
+
 #endif // RTOS_H_INCLUDED
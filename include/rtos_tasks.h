@@ -2,6 +2,20 @@
 #define RTOS_TASKS_H_INCLUDED
 
 #include <rtos.h>
+
+/* The screens. The buttons task selects one, the OLED
+ * task draws it.
+ */
+#define OLED_PAGE_MAIN      0
+#define OLED_PAGE_SCAN      1
+#define OLED_PAGE_STATS     2
+#define OLED_PAGE_SETTINGS  3
+#define OLED_PAGE_RAM       4
+#define OLED_PAGE_SPECTRUM  5
+#define OLED_PAGE_LAPS      6
+#define OLED_PAGE_PILOTS    7
+#define OLED_PAGES          8
+
 void init_rx_freq();
 void driver_rx_freq();
 void init_rx_rssi();
@@ -10,6 +24,26 @@ void init_oled();
 void driver_oled();
 void init_buttons();
 void driver_buttons();
+void init_scan();
+void driver_scan();
+void init_settings();
+void driver_settings();
+void init_telemetry();
+void driver_telemetry();
+void init_spectrum();
+void driver_spectrum();
+void init_pilots();
+void driver_pilots();
+
+extern rtos_task_t task_rx_freq;
+extern rtos_task_t task_rx_rssi;
+extern rtos_task_t task_oled;
+extern rtos_task_t task_buttons;
+extern rtos_task_t task_scan;
+extern rtos_task_t task_settings;
+extern rtos_task_t task_telemetry;
+extern rtos_task_t task_spectrum;
+extern rtos_task_t task_pilots;
 
 extern rtos_task_t *rtos_task_list[];
 
@@ -0,0 +1,40 @@
+#ifndef SCAN_H_INCLUDED
+#define SCAN_H_INCLUDED
+
+#include <stdint.h>
+
+// Number of best channels kept in the results
+#define SCAN_RESULTS 4
+
+/* Settle time after every hop. The synthesizer needs longer to
+ * settle after a big frequency jump, so the time grows with the
+ * size of the jump. The scan visits channels in frequency order
+ * to keep the jumps small, and tunes odd channels 1 MHz lower so
+ * it never waits for the SYN_REG_A write (video_rx.h).
+ */
+#define SCAN_SETTLE_BASE_US     5000
+#define SCAN_SETTLE_PER_MHZ_US  40
+#define SCAN_SETTLE_MAX_US      30000
+
+// Return values of scan_step()
+#define SCAN_IDLE       0
+#define SCAN_RUNNING    1
+#define SCAN_DONE       2
+
+typedef struct scan_result {
+    uint16_t freq;
+    uint8_t index;  // Channel index (channels.h), 0xFF in range mode
+    uint8_t rssi;
+} scan_result_t;
+
+void scan_start_channels(void);
+void scan_start_range(uint16_t freq_low, uint16_t freq_high);
+void scan_cancel(void);
+uint8_t scan_step(void);
+uint8_t scan_running(void);
+uint16_t scan_current_freq(void);
+uint8_t scan_progress(void);
+uint8_t scan_result_count(void);
+const scan_result_t *scan_get_result(uint8_t rank);
+
+#endif
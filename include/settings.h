@@ -0,0 +1,29 @@
+#ifndef SETTINGS_H_INCLUDED
+#define SETTINGS_H_INCLUDED
+
+#include <stdint.h>
+#include "hal.h"
+
+/* The settings are stored in the EEPROM as a ring of records.
+ * Every save goes into the next slot, which spreads the wear
+ * over the whole EEPROM (100k writes per cell). The EEPROM is
+ * only read at boot, settings_load() returns a copy in RAM.
+ */
+#define SETTINGS_RECORD_LEN 8
+#define SETTINGS_SLOTS      ((E2END + 1) / SETTINGS_RECORD_LEN)
+
+// Change when the record layout changes, old records are ignored
+#define SETTINGS_VERSION    1
+
+typedef struct settings {
+    int8_t band;        // -1 for a custom frequency
+    int8_t channel;
+    uint16_t freq;
+} settings_t;
+
+void settings_init(void);
+uint8_t settings_load(settings_t *settings);
+uint8_t settings_save(const settings_t *settings);
+uint8_t settings_busy(void);
+
+#endif
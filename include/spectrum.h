@@ -0,0 +1,31 @@
+#ifndef SPECTRUM_H_INCLUDED
+#define SPECTRUM_H_INCLUDED
+
+#include <stdint.h>
+
+/* The band that is swept, divided into SPECTRUM_BINS bins. Only
+ * even frequencies are visited, they are tuned with a single
+ * write (see video_rx_set_frequency()).
+ */
+#define SPECTRUM_FREQ_LOW   5646
+#define SPECTRUM_FREQ_HIGH  5944
+#define SPECTRUM_BINS       63
+
+/* Settle time after a hop to the next bin. The bins are only
+ * ~5 MHz apart, so this is shorter than the scan's (scan.h),
+ * which is still used for the jump back to the first bin.
+ */
+#define SPECTRUM_SETTLE_US  4000
+
+// Return value of spectrum_step() when no bin was measured
+#define SPECTRUM_NONE       0xFF
+
+void spectrum_start(void);
+void spectrum_stop(void);
+uint8_t spectrum_step(void);
+uint8_t spectrum_running(void);
+uint16_t spectrum_freq(uint8_t bin);
+uint8_t spectrum_level(uint8_t bin);
+uint8_t spectrum_peak(void);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef STATE_H_INCLUDED
+#define STATE_H_INCLUDED
+
+#include <stdint.h>
+#include "rtos.h"
+
+/* The receiver state that is shared between the tasks. It is
+ * written as a whole under a sequence counter, so a reader
+ * always gets a consistent copy, even from an interrupt.
+ */
+typedef struct rx_state {
+    int8_t band;        // -1 for a custom frequency
+    int8_t channel;
+    uint16_t freq;      // MHz
+    uint8_t rssi;       // 0-99
+    uint8_t page;       // The screen that is shown
+} rx_state_t;
+
+/* Change events, one bit each, so a subscriber can select
+ * the ones it wants with a mask.
+ */
+#define STATE_EVENT_FREQ        0x01    // The frequency changed
+#define STATE_EVENT_POSITION    0x02    // The band or channel changed
+#define STATE_EVENT_RSSI        0x04    // The RSSI changed
+#define STATE_EVENT_PAGE        0x08    // Another screen was selected
+#define STATE_EVENT_RETUNE      0x10    // The RX was tuned by someone else
+#define STATE_EVENT_ALL         0xFF
+
+// Must be a power of 2
+#define STATE_QUEUE_LEN     8
+
+// Leave a few free, the tasks check that theirs fit (rtos_tasks.c)
+#define STATE_SUBSCRIBERS   8
+
+/* The event queue of a subscriber. Every queue has a single
+ * producer (the task that publishes) and a single consumer (the
+ * subscriber). If it overflows, the subscriber gets all events
+ * of its mask once it has read the queue. A subscribed task may
+ * suspend itself, it is resumed by the next event.
+ */
+typedef struct state_queue {
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    volatile uint8_t overrun;
+    uint8_t mask;
+    rtos_task_t *task;
+    uint8_t events[STATE_QUEUE_LEN];
+} state_queue_t;
+
+void state_init(const rx_state_t *state);
+uint8_t state_try_read(rx_state_t *state);
+void state_read(rx_state_t *state);
+void state_set_position(int8_t band, int8_t channel, uint16_t freq);
+void state_set_rssi(uint8_t rssi);
+void state_set_page(uint8_t page);
+void state_publish(uint8_t event);
+uint8_t state_subscribe(state_queue_t *queue, uint8_t mask, rtos_task_t *task);
+uint8_t state_get_event(state_queue_t *queue);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef TELEMETRY_H_INCLUDED
+#define TELEMETRY_H_INCLUDED
+
+#include <stdint.h>
+
+/* Binary protocol over the UART. Every frame is
+ *   COBS(type, payload, CRC low, CRC high) 0x00
+ * The CRC is CRC-16/MCRF4XX (CCITT polynomial, reflected, initial
+ * value 0xFFFF) of the type and the payload. COBS removes all zero
+ * bytes, so a zero always ends a frame and both sides can resync on
+ * it. Multi-byte values are little endian. scripts/telemetry.py is
+ * the host side.
+ */
+#define TELEMETRY_MAX_PAYLOAD 40
+
+// Frames sent by the receiver
+#define TELEMETRY_RSSI          0x01    // Raw RSSI samples, uint16 each
+#define TELEMETRY_STATUS        0x02    // freq u16, band i8, channel i8, rssi u8, active RX u8, scan u8, display u8,
+                                        // diversity switches u16 (wraps around, 0 without diversity)
+#define TELEMETRY_STATS         0x03    // task u8, avg_us u16, max_us u16, load u16, overruns u16, misses u16
+#define TELEMETRY_SETTINGS      0x04    // result u8, band i8, channel i8, freq u16
+#define TELEMETRY_ACK           0x05    // command u8, result u8
+#define TELEMETRY_BOOT          0x06    // reset flags u8 (MCUSR), watchdog resets u8, sent once at boot
+#define TELEMETRY_TRACE         0x07    // trace u8, entries u8, open u8, first u8, then per entry:
+                                        // event u8, arg u8, time u16 (see trace.h)
+#define TELEMETRY_LAP           0x08    // lap u16, time u32 (us), lap time u32 (us), peak rssi u8,
+                                        // sent for every pass of the lap timer (see laps.h)
+#define TELEMETRY_PILOTS        0x09    // round u16 (ms), then per pilot: channel u8, rssi u8, lost u8,
+                                        // sent with the status while the pilots are watched (see pilots.h)
+
+// Commands sent by the host
+#define TELEMETRY_CMD_TUNE      0x81    // band i8, channel i8, freq u16 (used if band is -1)
+#define TELEMETRY_CMD_SCAN      0x82    // Starts a scan of all channels, or with low u16, high u16
+                                        // of the frequencies in between in 2 MHz steps
+#define TELEMETRY_CMD_SETTINGS  0x83    // Reads the saved settings
+#define TELEMETRY_CMD_STREAM    0x84    // streams u8, see below
+#define TELEMETRY_CMD_TRACE     0x85    // Sends the latency trace, TELEMETRY_TRACE_ENTRIES per frame
+#define TELEMETRY_CMD_LAPS      0x86    // enter rssi u8, exit rssi u8, filter shift u8, shortest lap u16 (ms)
+#define TELEMETRY_CMD_PILOTS    0x87    // PILOTS_MAX channels u8 (band * 8 + channel, 0xFF for none)
+
+// Streams selected by TELEMETRY_CMD_STREAM
+#define TELEMETRY_STREAM_RSSI   0x01    // Every RSSI sample
+#define TELEMETRY_STREAM_STATUS 0x02    // Status 10 times per second
+#define TELEMETRY_STREAM_STATS  0x04    // Task statistics every second
+
+// Entries of the latency trace in one TELEMETRY_TRACE frame
+#define TELEMETRY_TRACE_ENTRIES 8
+
+// Result of a command in TELEMETRY_ACK
+#define TELEMETRY_OK            0
+#define TELEMETRY_INVALID       1
+#define TELEMETRY_UNKNOWN       2
+
+uint8_t telemetry_send(uint8_t type, const uint8_t *payload, uint8_t length);
+uint8_t telemetry_receive(uint8_t *type, uint8_t *payload, uint8_t *length);
+uint16_t telemetry_dropped(void);
+uint16_t telemetry_errors(void);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <stdint.h>
+
+/* Latency trace from a button press to a stable picture.
+ *
+ * A button edge opens a trace, and every event of the list below
+ * is recorded with the time since that edge, until TRACE_WINDOW_MS
+ * have passed or TRACE_LEN events were recorded. Events while no
+ * trace is open are ignored, so the buffer always holds the last
+ * trace. The host reads it with TELEMETRY_CMD_TRACE.
+ */
+#define TRACE_LEN           24
+#define TRACE_WINDOW_MS     1000
+
+// Unit of the event times, 2^n us
+#define TRACE_TIME_SHIFT    4
+#define TRACE_TIME_US       (1 << TRACE_TIME_SHIFT)
+
+// Events, with what their argument holds
+#define TRACE_BUTTON_EDGE   1   // pins, a set bit means down (pin change interrupt)
+#define TRACE_BUTTON_EVENT  2   // type << 4 | buttons, handled by driver_buttons()
+#define TRACE_RX_TUNE       3   // register written (SYN_REG_A 0, SYN_REG_B 1)
+#define TRACE_RSSI_LOCK     4   // RSSI of the first sample above the threshold
+#define TRACE_OLED_DONE     5   // I2C status, the display queue is empty
+
+/* RSSI (0-99, video_rx_rssi_scale()) that counts as a picture. The
+ * sample that was being taken during the write is skipped.
+ */
+#ifndef TRACE_RSSI_THRESHOLD
+#define TRACE_RSSI_THRESHOLD 40
+#endif
+
+/* With TRACE_GPIO every recorded event toggles TRACE_PIN (pins.h),
+ * to line up the trace with a logic analyzer on the SPI and I2C.
+ */
+#ifndef TRACE_GPIO
+#define TRACE_GPIO 0
+#endif
+
+typedef struct trace_entry {
+    uint8_t event;
+    uint8_t arg;
+    uint16_t time;  // Since the opening edge, in TRACE_TIME_US
+} trace_entry_t;
+
+void trace_event(uint8_t event, uint8_t arg);
+void trace_rssi(uint16_t sample);
+uint8_t trace_read(trace_entry_t *entries, uint8_t first, uint8_t max);
+uint8_t trace_count(void);
+uint8_t trace_number(void);
+uint8_t trace_open(void);
+
+#endif
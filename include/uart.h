@@ -0,0 +1,23 @@
+#ifndef UART_H_INCLUDED
+#define UART_H_INCLUDED
+
+#include <stdint.h>
+
+/* Baud rate. With the double speed mode 500000 and 1000000
+ * are exact at 16 MHz, 115200 is 2.1 % off.
+ */
+#ifndef UART_BAUD
+#define UART_BAUD 500000UL
+#endif
+
+// Ring buffer sizes, must be powers of 2
+#define UART_TX_LEN 128
+#define UART_RX_LEN 32
+
+void uart_init(void);
+uint8_t uart_write(const uint8_t *data, uint8_t length);
+uint8_t uart_tx_free(void);
+uint8_t uart_read(uint8_t *byte);
+uint8_t uart_rx_overruns(void);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef UI_H_INCLUDED
+#define UI_H_INCLUDED
+
+#include <stdint.h>
+#include "hal.h"
+
+/* Retained widgets on top of the tile map (oled.h).
+ *
+ * A page is a table of widgets in program memory. The values
+ * shown by the widgets are kept in slots in RAM: ui_set() marks
+ * the widgets of a slot for redrawing only when its value changes,
+ * and ui_render() draws the marked widgets into the tile map, which
+ * in turn only sends the tiles that changed. Widgets of a page must
+ * not overlap, ui_show() blanks the tiles that no widget covers.
+ */
+
+// Widget types
+#define UI_LABEL    0   // text, at most width characters, padded with blanks to width
+#define UI_NUMBER   1   // width digits, clamped to max if it is not 0
+#define UI_CHOICE   2   // the character of text at the index in the slot
+#define UI_GRID     3   // width x height cells, see below
+#define UI_BAR      4   // width tiles, filled in proportion to the slot / max
+
+/* A grid has a small dot in every other column, and a large dot
+ * in the cell whose index (row * width + column) is in the slot,
+ * 0xFF for none. The columns are numbered in the row above, the
+ * rows are labelled with the characters of text two columns to
+ * the left. A grid with UI_SCROLL shows height rows of a taller
+ * grid, from the row in the next slot on.
+ */
+#define UI_NONE     0xFF
+
+// Widget flags
+#define UI_INVERT   1
+#define UI_SCROLL   2
+
+/* Number of value slots. NUMBER, CHOICE and BAR widgets of height
+ * h take h slots from slot on, one per row. A GRID takes one,
+ * or two with UI_SCROLL. Several widgets may show the same slot.
+ */
+#define UI_SLOTS    48
+
+typedef struct ui_widget {
+    uint8_t type;
+    uint8_t col;
+    uint8_t row;
+    uint8_t width;
+    uint8_t height;     // Rows, 0 means 1
+    uint8_t slot;       // First value slot
+    uint8_t flags;
+    PGM_P text;
+    uint16_t max;
+} ui_widget_t;
+
+// Number of widgets in a page table
+#define UI_COUNT(page) (sizeof(page) / sizeof((page)[0]))
+
+void ui_show(const ui_widget_t *page, uint8_t count);
+void ui_set(uint8_t slot, uint16_t value);
+void ui_invalidate(void);
+void ui_render(void);
+
+#endif
@@ -3,9 +3,79 @@
 
 #include <stdint.h>
 
+// RSSI conversion triggers
+#define VIDEO_RX_ADC_FREE_RUNNING   0
+#define VIDEO_RX_ADC_TIMER0         1
+
+/* By default the ADC runs freely at 125 kHz / 13 = ~9.6k
+ * conversions per second. With the Timer0 trigger the rate
+ * is set by VIDEO_RX_ADC_RATE_HZ instead.
+ */
+#ifndef VIDEO_RX_ADC_TRIGGER
+#define VIDEO_RX_ADC_TRIGGER VIDEO_RX_ADC_FREE_RUNNING
+#endif
+#ifndef VIDEO_RX_ADC_RATE_HZ
+#define VIDEO_RX_ADC_RATE_HZ 8000
+#endif
+
+/* Every RSSI sample is the sum of 4^n conversions shifted
+ * right by n, which gives n extra bits of resolution. With
+ * n = 1 and the free running ADC there are ~2400 samples/s.
+ */
+#ifndef VIDEO_RX_OVERSAMPLE_BITS
+#define VIDEO_RX_OVERSAMPLE_BITS 1
+#endif
+
+// Must be a power of 2
+#define VIDEO_RX_RSSI_BUFFER_LEN 64
+
+/* Diversity with a second RX on VIDEO_RX_B_CS and ADC1. Both
+ * are tuned together and their RSSI is sampled alternately,
+ * and VIDEO_SWITCH selects the stronger one. The other RX has
+ * to be stronger by VIDEO_RX_SWITCH_HYSTERESIS (in samples)
+ * and the selection is held for VIDEO_RX_SWITCH_DWELL_MS.
+ */
+#ifndef VIDEO_RX_DIVERSITY
+#define VIDEO_RX_DIVERSITY 0
+#endif
+#ifndef VIDEO_RX_SWITCH_HYSTERESIS
+#define VIDEO_RX_SWITCH_HYSTERESIS 16
+#endif
+#ifndef VIDEO_RX_SWITCH_DWELL_MS
+#define VIDEO_RX_SWITCH_DWELL_MS 10
+#endif
+
+#if VIDEO_RX_DIVERSITY
+#define VIDEO_RX_COUNT 2
+#else
+#define VIDEO_RX_COUNT 1
+#endif
+
+/* Time between two RSSI samples in the buffer, in us. The free
+ * running ADC takes 13 ADC clocks of 128 CPU cycles, which gives
+ * exactly 416 us at 16 MHz. With diversity it is twice as long.
+ */
+#if VIDEO_RX_ADC_TRIGGER == VIDEO_RX_ADC_TIMER0
+#define VIDEO_RX_SAMPLE_US \
+    ((1000000UL * VIDEO_RX_COUNT << (2 * VIDEO_RX_OVERSAMPLE_BITS)) / VIDEO_RX_ADC_RATE_HZ)
+#else
+#define VIDEO_RX_SAMPLE_US \
+    ((128UL * 13 * VIDEO_RX_COUNT << (2 * VIDEO_RX_OVERSAMPLE_BITS)) / (F_CPU / 1000000UL))
+#endif
+
 void video_rx_init_spi(void);
 void video_rx_init_adc(void);
 void video_rx_set_frequency(uint16_t freq);
+void video_rx_set_word(uint32_t word, uint16_t freq);
+void video_rx_tune_step(void);
+uint8_t video_rx_tuning(void);
 uint8_t video_rx_get_rssi(void);
+uint8_t video_rx_get_rssi_of(uint8_t rx);
+uint8_t video_rx_active(void);
+uint16_t video_rx_switches(void);
+uint8_t video_rx_rssi_read(uint16_t *samples, uint8_t max);
+void video_rx_rssi_flush(void);
+uint8_t video_rx_rssi_overruns(void);
+uint8_t video_rx_rssi_scale(uint16_t sample);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef WATCHDOG_H_INCLUDED
+#define WATCHDOG_H_INCLUDED
+
+#include <stdint.h>
+#include "hal.h"
+
+/* The watchdog resets the MCU if the main loop stops coming back
+ * for longer than this, for example when a task hangs. The RTOS
+ * timer wakes the loop at least every 6 slices (30 ms), so the
+ * timeout leaves plenty of room.
+ */
+#define WATCHDOG_TIMEOUT WDTO_120MS
+
+/* With WATCHDOG_TEST, holding all four buttons hangs the buttons
+ * task for a second, so the watchdog resets the receiver. It
+ * tests the recovery, leave it off in a normal build.
+ */
+#ifndef WATCHDOG_TEST
+#define WATCHDOG_TEST 0
+#endif
+
+void watchdog_init(void);
+void watchdog_kick(void);
+uint8_t watchdog_reset_flags(void);
+uint8_t watchdog_recovered(void);
+uint8_t watchdog_resets(void);
+
+#endif
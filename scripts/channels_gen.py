@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Generates src/channel_table.c, the channel database in program memory.
+
+Every channel gets the SYN_REG_B write that tunes the RTC6715 to it,
+as the 25 bits that _spi_write() in video_rx.c sends: the N and A
+parameters of _freq_to_data(), the write bit and the register address.
+Even frequencies use the default 2 MHz steps, odd ones 1 MHz steps and
+need the deferred A register write (video_rx_tune_step()). Next to
+the table is the index of all channels sorted by frequency.
+
+The bands are listed below, the order of the letters is the band
+number used everywhere else (the settings, the telemetry), new bands
+go to the end. L, X and U are below the 5645-5945 MHz the RTC6715 is
+specified for, it tunes there but receives worse. L is the low race
+band of the RX5808 firmwares, U the one with 40 MHz spacing that the
+VTX tables call LOWRACE.
+
+Runs before every PlatformIO build (extra_scripts) and regenerates the
+table when this script has changed. It can also be run by hand.
+"""
+
+import os
+
+BANDS = (
+    ("A", (5865, 5845, 5825, 5805, 5785, 5765, 5745, 5725)),    # Boscam A
+    ("B", (5733, 5752, 5771, 5790, 5809, 5828, 5847, 5866)),    # Boscam B
+    ("E", (5705, 5685, 5665, 5645, 5885, 5905, 5925, 5945)),    # Boscam E
+    ("F", (5740, 5760, 5780, 5800, 5820, 5840, 5860, 5880)),    # Fatshark
+    ("R", (5658, 5695, 5732, 5769, 5806, 5843, 5880, 5917)),    # Raceband
+    ("L", (5362, 5399, 5436, 5473, 5510, 5547, 5584, 5621)),    # Low raceband
+    ("X", (4990, 5020, 5050, 5080, 5110, 5140, 5170, 5200)),    # Low band
+    ("U", (5333, 5373, 5413, 5453, 5493, 5533, 5573, 5613)),    # Low race, 40 MHz
+)
+CHANNELS_PER_BAND = 8
+
+SYN_REG_B = 0x01
+
+
+def freq_to_data(freq):
+    """The same as _freq_to_data() in video_rx.c."""
+    f_lo = freq - 479
+    if not freq & 1:
+        f_lo >>= 1
+    return ((f_lo // 32) << 7) | (f_lo % 32)
+
+
+def spi_word(freq):
+    """The data combined with the write bit and the address, the
+    same as _spi_write() in video_rx.c."""
+    return (((freq_to_data(freq) << 1) | 1) << 4) | SYN_REG_B
+
+
+def generate(out_path):
+    channels = []
+    for letter, freqs in BANDS:
+        if len(freqs) != CHANNELS_PER_BAND:
+            raise ValueError("band %s doesn't have %d channels" % (letter, CHANNELS_PER_BAND))
+        for i, freq in enumerate(freqs):
+            channels.append(("%s%d" % (letter, i + 1), freq))
+    # Stable, so equal frequencies keep the order of the bands.
+    by_freq = sorted(range(len(channels)), key=lambda i: channels[i][1])
+
+    lines = [
+        "/* Generated by scripts/channels_gen.py, do not edit.",
+        " * The channels in band order, with the SYN_REG_B write that",
+        " * tunes the RX to them, and their indices sorted by frequency.",
+        " */",
+        "",
+        "#include \"channels.h\"",
+        "",
+        "#if CHANNEL_BANDS != %d || CHANNEL_PER_BAND != %d" % (len(BANDS), CHANNELS_PER_BAND),
+        "#error \"CHANNEL_BANDS or CHANNEL_PER_BAND don't match the table\"",
+        "#endif",
+        "",
+        "const char channel_band_letters[] PROGMEM = \"%s\";" % "".join(b[0] for b in BANDS),
+        "",
+        "const channel_t channels[CHANNEL_COUNT] PROGMEM = {",
+    ]
+    for name, freq in channels:
+        lines.append("    {%d, 0x%08XUL}, // %s" % (freq, spi_word(freq), name))
+    lines += [
+        "};",
+        "",
+        "const uint8_t channels_by_freq[CHANNEL_COUNT] PROGMEM = {",
+    ]
+    for start in range(0, len(by_freq), 8):
+        lines.append("    %s," % ", ".join("%2d" % i for i in by_freq[start:start + 8]))
+    lines.append("};")
+
+    with open(out_path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main(project_dir):
+    script_path = os.path.join(project_dir, "scripts", "channels_gen.py")
+    out_path = os.path.join(project_dir, "src", "channel_table.c")
+    if os.path.exists(out_path) and os.path.getmtime(out_path) >= os.path.getmtime(script_path):
+        return
+    generate(out_path)
+    print("channels_gen.py: generated %s" % os.path.relpath(out_path, project_dir))
+
+
+try:
+    # PlatformIO extra script
+    Import("env")  # noqa: F821
+    main(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    main(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
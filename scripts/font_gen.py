@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Generates src/font.c from the glyph sheet 6x8.png.
+
+The sheet is a grid of 6x8 pixel cells, read left to right and top to
+bottom. The cells hold the ASCII characters from ' ' to 0x7F, followed
+by the symbols (0x80 and up, see OLED_SMALL_DOT and friends in oled.h).
+Dark pixels are set. Empty cells at the end of the sheet are not part
+of the font.
+
+Runs before every PlatformIO build (extra_scripts) and regenerates the
+font when the sheet has changed. It can also be run by hand.
+"""
+
+import os
+import struct
+import zlib
+
+CELL_WIDTH = 6
+CELL_HEIGHT = 8
+FIRST_CHAR = 0x20
+
+
+def read_png(path):
+    """Returns the width, height and rows of gray levels of an 8-bit,
+    non-interlaced PNG."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("%s is not a PNG file" % path)
+
+    pos, idat, palette = 8, b"", None
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+        elif kind == b"PLTE":
+            palette = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+    if depth != 8 or interlace:
+        raise ValueError("%s must be 8-bit and not interlaced" % path)
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    stride = width * channels
+    raw = zlib.decompress(idat)
+    rows, prev = [], bytearray(stride)
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for x in range(stride):
+            a = line[x - channels] if x >= channels else 0
+            b = prev[x]
+            c = prev[x - channels] if x >= channels else 0
+            if kind == 1:
+                line[x] = (line[x] + a) & 0xFF
+            elif kind == 2:
+                line[x] = (line[x] + b) & 0xFF
+            elif kind == 3:
+                line[x] = (line[x] + (a + b) // 2) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                line[x] = (line[x] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 0xFF
+        prev = line
+
+        gray = []
+        for x in range(width):
+            pixel = line[x * channels:(x + 1) * channels]
+            if color == 3:
+                pixel = palette[pixel[0] * 3:pixel[0] * 3 + 3]
+            gray.append(sum(pixel[:3]) // len(pixel[:3]) if color in (2, 3, 6) else pixel[0])
+        rows.append(gray)
+    return width, height, rows
+
+
+def read_glyphs(path):
+    """Returns the glyphs as lists of 6 column bytes, bit 0 at the top."""
+    width, height, rows = read_png(path)
+    if width % CELL_WIDTH or height % CELL_HEIGHT:
+        raise ValueError("%s is not a grid of %dx%d cells" % (path, CELL_WIDTH, CELL_HEIGHT))
+
+    glyphs = []
+    for cy in range(0, height, CELL_HEIGHT):
+        for cx in range(0, width, CELL_WIDTH):
+            glyph = []
+            for x in range(cx, cx + CELL_WIDTH):
+                column = 0
+                for y in range(CELL_HEIGHT):
+                    if rows[cy + y][x] < 128:
+                        column |= 1 << y
+                glyph.append(column)
+            glyphs.append(glyph)
+
+    while glyphs and not any(glyphs[-1]):
+        glyphs.pop()
+    return glyphs
+
+
+def glyph_name(index):
+    code = FIRST_CHAR + index
+    if code < 0x7F:
+        return "'%s'" % chr(code) if chr(code) not in "\\'" else "'\\%s'" % chr(code)
+    return "0x%02X" % code
+
+
+def generate(png_path, out_path):
+    glyphs = read_glyphs(png_path)
+    lines = [
+        "/* Generated from 6x8.png by scripts/font_gen.py, do not edit.",
+        " * Each glyph is 6 columns of 8 pixels, bit 0 at the top.",
+        " */",
+        "",
+        "#include \"font.h\"",
+        "",
+        "#if FONT_GLYPHS != %d" % len(glyphs),
+        "#error \"FONT_GLYPHS doesn't match the glyph sheet\"",
+        "#endif",
+        "",
+        "const uint8_t font_glyphs[FONT_GLYPHS][FONT_WIDTH] PROGMEM = {",
+    ]
+    for i, glyph in enumerate(glyphs):
+        lines.append("    {%s}, // %s" % (", ".join("0x%02X" % c for c in glyph), glyph_name(i)))
+    lines.append("};")
+
+    with open(out_path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main(project_dir):
+    png_path = os.path.join(project_dir, "6x8.png")
+    out_path = os.path.join(project_dir, "src", "font.c")
+    if os.path.exists(out_path) and os.path.getmtime(out_path) >= os.path.getmtime(png_path):
+        return
+    generate(png_path, out_path)
+    print("font_gen.py: generated %s" % os.path.relpath(out_path, project_dir))
+
+
+try:
+    # PlatformIO extra script
+    Import("env")  # noqa: F821
+    main(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    main(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
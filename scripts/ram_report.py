@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Reports the RAM that every module takes.
+
+Sums the .data, .bss and .rodata sections of every object file in the
+build directory (on AVR .rodata is copied to RAM like .data, only
+PROGMEM stays in flash) and the common symbols, and prints a table
+sorted by size. The table is also written to ram_report.txt in the
+build directory. The stack gets what is left, ram_stack_free() in
+src/ram.c tells how much of it was never used.
+
+Runs after every AVR PlatformIO build (extra_scripts). It can also be
+run by hand:
+    scripts/ram_report.py .pio/build/nanoatmega328new
+"""
+
+import os
+import subprocess
+import sys
+
+RAM_SIZE = 2048
+SECTIONS = (".data", ".bss", ".rodata")
+
+
+def section_sizes(size_tool, path):
+    """Returns the sizes of the RAM sections of an object file."""
+    sizes = dict.fromkeys(SECTIONS, 0)
+    output = subprocess.run([size_tool, "-A", path], capture_output=True,
+                            text=True, check=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) < 2 or not fields[1].isdigit():
+            continue
+        for section in SECTIONS:
+            if fields[0] == section or fields[0].startswith(section + "."):
+                sizes[section] += int(fields[1])
+    return sizes
+
+
+def common_size(nm_tool, path):
+    """Returns the size of the common symbols (uninitialised globals
+    that end up in .bss when linking)."""
+    output = subprocess.run([nm_tool, "-S", path], capture_output=True,
+                            text=True, check=True).stdout
+    total = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[2] in ("C", "c"):
+            total += int(fields[1], 16)
+    return total
+
+
+def report(build_dir, size_tool="avr-size", nm_tool="avr-nm"):
+    rows = []
+    for root, _, files in os.walk(build_dir):
+        for name in sorted(files):
+            if not name.endswith(".o"):
+                continue
+            path = os.path.join(root, name)
+            sizes = section_sizes(size_tool, path)
+            sizes[".bss"] += common_size(nm_tool, path)
+            total = sum(sizes.values())
+            if total:
+                rows.append((os.path.relpath(path, build_dir), sizes, total))
+    rows.sort(key=lambda row: -row[2])
+
+    lines = ["%-40s %6s %6s %7s %6s" % ("module", ".data", ".bss", ".rodata", "total")]
+    for module, sizes, total in rows:
+        lines.append("%-40s %6d %6d %7d %6d" % (
+            module, sizes[".data"], sizes[".bss"], sizes[".rodata"], total))
+    static = sum(row[2] for row in rows)
+    lines.append("%-40s %29d" % ("static", static))
+    lines.append("%-40s %29d" % ("left for the stack", RAM_SIZE - static))
+
+    text = "\n".join(lines) + "\n"
+    with open(os.path.join(build_dir, "ram_report.txt"), "w") as f:
+        f.write(text)
+    return text
+
+
+def _post_action(target, source, env):
+    print(report(env.subst("$BUILD_DIR"),
+                 env.subst("$SIZETOOL") or "avr-size",
+                 env.subst("$NM") or "avr-nm"), end="")
+
+
+try:
+    # PlatformIO extra script
+    Import("env")  # noqa: F821
+    if env.subst("$PIOPLATFORM") == "atmelavr":  # noqa: F821
+        env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", _post_action)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) != 2:
+            sys.exit(__doc__)
+        print(report(sys.argv[1]), end="")
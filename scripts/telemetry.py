@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+"""Host side of the telemetry protocol (include/telemetry.h).
+
+Decodes the frames the receiver sends and prints one line per frame,
+and sends commands to it. Frames are COBS encoded, end with a zero
+byte and carry a CRC-16/MCRF4XX of their type and payload.
+
+Usage:
+    scripts/telemetry.py PORT [--baud 500000] [--stream rssi,status,stats]
+                              [--tune 5740 | --channel R3] [--scan [LOW,HIGH]]
+                              [--settings] [--trace]
+                              [--laps ENTER,EXIT,FILTER,MIN_MS]
+                              [--pilots R1,R2,-,...] [--seconds N]
+    scripts/telemetry.py --decode capture.bin
+
+Reading a serial port needs pyserial, decoding a capture doesn't.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+RSSI = 0x01
+STATUS = 0x02
+STATS = 0x03
+SETTINGS = 0x04
+ACK = 0x05
+BOOT = 0x06
+TRACE = 0x07
+LAP = 0x08
+PILOTS = 0x09
+
+CMD_TUNE = 0x81
+CMD_SCAN = 0x82
+CMD_SETTINGS = 0x83
+CMD_STREAM = 0x84
+CMD_TRACE = 0x85
+CMD_LAPS = 0x86
+CMD_PILOTS = 0x87
+
+STREAMS = {"rssi": 0x01, "status": 0x02, "stats": 0x04}
+BANDS = "ABEFRLXU"  # The bands of scripts/channels_gen.py
+RESULTS = {0: "ok", 1: "invalid", 2: "unknown"}
+RESET_FLAGS = ("power-on", "external", "brown-out", "watchdog")
+# Events of include/trace.h, times are in 16 us units
+TRACE_EVENTS = {1: "edge", 2: "button", 3: "tune", 4: "rssi", 5: "oled"}
+TRACE_TIME_US = 16
+# include/pilots.h
+PILOTS_MAX = 8
+PILOTS_NONE = 0xFF
+
+
+def crc16(data):
+    """CRC-16/MCRF4XX, the same as _crc16_update() in telemetry.c."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_position = 0
+    for byte in data:
+        if byte == 0 or len(out) - code_position == 0xFF:
+            out[code_position] = len(out) - code_position
+            code_position = len(out)
+            out.append(0)
+            if byte == 0:
+                continue
+        out.append(byte)
+    out[code_position] = len(out) - code_position
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("broken COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(frame_type, payload=b""):
+    body = bytes([frame_type]) + payload
+    return cobs_encode(body + struct.pack("<H", crc16(body))) + b"\0"
+
+
+def decode_frame(encoded):
+    """Returns (type, payload) or raises ValueError."""
+    body = cobs_decode(encoded)
+    if len(body) < 3:
+        raise ValueError("frame too short")
+    if struct.unpack("<H", body[-2:])[0] != crc16(body[:-2]):
+        raise ValueError("bad CRC")
+    return body[0], body[1:-2]
+
+
+def position(band, channel):
+    return "custom" if band < 0 else "{}{}".format(BANDS[band], channel + 1)
+
+
+def describe(frame_type, payload):
+    if frame_type == RSSI:
+        samples = struct.unpack("<{}H".format(len(payload) // 2), payload)
+        return "rssi " + " ".join(str(s) for s in samples)
+    if frame_type == STATUS:
+        freq, band, channel, rssi, rx, scan, display, switches = struct.unpack("<HbbBBBBH", payload)
+        return "status {} MHz {} rssi {} rx {} switches {}{}{}".format(
+            freq, position(band, channel), rssi, "AB"[rx & 1], switches, " scanning" if scan else "",
+            "" if display else " no display")
+    if frame_type == STATS:
+        task, avg, peak, load, overruns, misses = struct.unpack("<BHHHHH", payload)
+        return "stats task {} avg {} us max {} us load {}/1000 overruns {} misses {}".format(
+            task, avg, peak, load, overruns, misses)
+    if frame_type == SETTINGS:
+        result, band, channel, freq = struct.unpack("<BbbH", payload)
+        if result:
+            return "settings none saved"
+        return "settings {} MHz {}".format(freq, position(band, channel))
+    if frame_type == ACK:
+        command, result = struct.unpack("<BB", payload)
+        return "ack 0x{:02x} {}".format(command, RESULTS.get(result, result))
+    if frame_type == BOOT:
+        flags, resets = struct.unpack("<BB", payload)
+        causes = [name for bit, name in enumerate(RESET_FLAGS) if flags & (1 << bit)]
+        return "boot reset {} watchdog resets {}".format(",".join(causes) or "unknown", resets)
+    if frame_type == TRACE:
+        number, count, still_open, first = struct.unpack("<BBBB", payload[:4])
+        events = []
+        for i, (event, arg, t) in enumerate(struct.iter_unpack("<BBH", payload[4:])):
+            events.append("\n  {:2} {:8.3f} ms {:6} 0x{:02x}".format(
+                first + i, t * TRACE_TIME_US / 1000, TRACE_EVENTS.get(event, event), arg))
+        return "trace {} entries {}{}{}".format(
+            number, count, " open" if still_open else "", "".join(events))
+    if frame_type == LAP:
+        lap, t, lap_us, peak = struct.unpack("<HIIB", payload)
+        if lap == 0:
+            return "pass at {:.4f} s starts the clock, peak {}".format(t / 1e6, peak)
+        return "lap {} {:.4f} s at {:.4f} s, peak {}".format(lap, lap_us / 1e6, t / 1e6, peak)
+    if frame_type == PILOTS:
+        (round_ms,) = struct.unpack("<H", payload[:2])
+        pilots = []
+        for slot, (index, rssi, lost) in enumerate(struct.iter_unpack("<BBB", payload[2:])):
+            if index == PILOTS_NONE:
+                continue
+            pilots.append("\n  {} {:3} rssi {:2}{}".format(
+                slot + 1, position(index // 8, index % 8), rssi, " lost" if lost else ""))
+        return "pilots round {} ms{}".format(round_ms, "".join(pilots))
+    return "unknown 0x{:02x} {}".format(frame_type, payload.hex())
+
+
+class Decoder:
+    """Splits a byte stream into frames and decodes them."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.errors = 0
+
+    def feed(self, data):
+        frames = []
+        for byte in data:
+            if byte != 0:
+                self.buffer.append(byte)
+                continue
+            if self.buffer:
+                try:
+                    frames.append(decode_frame(bytes(self.buffer)))
+                except (ValueError, struct.error):
+                    self.errors += 1
+            self.buffer.clear()
+        return frames
+
+
+def parse_channel(name):
+    band = BANDS.index(name[0].upper())
+    channel = int(name[1:]) - 1
+    if not 0 <= channel < 8:
+        raise ValueError(name)
+    return band, channel
+
+
+def parse_pilots(names):
+    indices = []
+    for name in names.split(","):
+        if name == "-":
+            indices.append(PILOTS_NONE)
+        else:
+            band, channel = parse_channel(name)
+            indices.append(band * 8 + channel)
+    if len(indices) > PILOTS_MAX:
+        raise ValueError(names)
+    return indices + [PILOTS_NONE] * (PILOTS_MAX - len(indices))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", nargs="?")
+    parser.add_argument("--baud", type=int, default=500000)
+    parser.add_argument("--decode", metavar="FILE", help="decode a capture instead")
+    parser.add_argument("--stream", help="comma separated: rssi, status, stats")
+    parser.add_argument("--tune", type=int, metavar="MHZ")
+    parser.add_argument("--channel", help="channel position, e.g. R3")
+    parser.add_argument("--scan", nargs="?", const="", metavar="LOW,HIGH",
+                        help="scan all channels, or the MHz from LOW to HIGH")
+    parser.add_argument("--settings", action="store_true")
+    parser.add_argument("--trace", action="store_true", help="dump the latency trace")
+    parser.add_argument("--laps", metavar="ENTER,EXIT,FILTER,MIN_MS",
+                        help="configure the lap timer, thresholds in RSSI (0-99)")
+    parser.add_argument("--pilots", metavar="R1,R2,-,...",
+                        help="channels of the watched pilots, - for none")
+    parser.add_argument("--seconds", type=float, help="stop after this long")
+    args = parser.parse_args()
+
+    decoder = Decoder()
+
+    if args.decode:
+        with open(args.decode, "rb") as f:
+            for frame in decoder.feed(f.read()):
+                print(describe(*frame))
+        print("{} broken frames".format(decoder.errors), file=sys.stderr)
+        return 0
+
+    if not args.port:
+        parser.error("a port or --decode is needed")
+
+    import serial
+    port = serial.Serial(args.port, args.baud, timeout=0.1)
+
+    if args.stream is not None:
+        mask = 0
+        for name in filter(None, args.stream.split(",")):
+            mask |= STREAMS[name]
+        port.write(encode_frame(CMD_STREAM, bytes([mask])))
+    if args.tune is not None:
+        port.write(encode_frame(CMD_TUNE, struct.pack("<bbH", -1, 0, args.tune)))
+    if args.channel:
+        band, channel = parse_channel(args.channel)
+        port.write(encode_frame(CMD_TUNE, struct.pack("<bbH", band, channel, 0)))
+    if args.scan == "":
+        port.write(encode_frame(CMD_SCAN))
+    elif args.scan:
+        low, high = (int(v) for v in args.scan.split(","))
+        port.write(encode_frame(CMD_SCAN, struct.pack("<HH", low, high)))
+    if args.settings:
+        port.write(encode_frame(CMD_SETTINGS))
+    if args.trace:
+        port.write(encode_frame(CMD_TRACE))
+    if args.laps:
+        enter, leave, shift, min_ms = (int(v) for v in args.laps.split(","))
+        port.write(encode_frame(CMD_LAPS, struct.pack("<BBBH", enter, leave, shift, min_ms)))
+    if args.pilots:
+        port.write(encode_frame(CMD_PILOTS, bytes(parse_pilots(args.pilots))))
+
+    end = time.monotonic() + args.seconds if args.seconds else None
+    try:
+        while end is None or time.monotonic() < end:
+            for frame in decoder.feed(port.read(4096)):
+                print(describe(*frame), flush=True)
+    except KeyboardInterrupt:
+        pass
+    print("{} broken frames".format(decoder.errors), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
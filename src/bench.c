@@ -0,0 +1,172 @@
+/* Benchmark firmware, built instead of main.c with -DBENCHMARK
+ * (the "bench" PlatformIO environment). It runs the hot paths
+ * once each and marks them for the simavr harness in bench/:
+ *  GPIOR0 - the name of the next measurement, one char per write
+ *  GPIOR1 - start of the measurement, 1 counts all cycles and
+ *           2 only the cycles in which the CPU was awake
+ *  GPIOR2 - end of the measurement
+ * The harness counts the CPU cycles between the two markers.
+ */
+
+#ifdef BENCHMARK
+
+#include "hal.h"
+#include "pins.h"
+#include "rtos.h"
+#include "rtos_tasks.h"
+#include "oled.h"
+#include "i2c.h"
+#include "scan.h"
+#include "state.h"
+#include "channels.h"
+#include "video_rx.h"
+#include "watchdog.h"
+
+// Boot of main.c
+void _boot(void);
+
+// Internal functions of video_rx.c
+uint32_t _freq_to_data(uint16_t freq);
+void _spi_write(uint32_t data, uint8_t address);
+
+volatile uint32_t bench_sink;
+
+/* This function is used internally to send the name of
+ * a measurement and start it.
+ */
+void _bench_begin(const char *name) {
+    while (*name) GPIOR0 = *name++;
+    GPIOR1 = 1;
+}
+
+/* This function is used internally to start a measurement
+ * that leaves out the time the CPU was sleeping.
+ */
+void _bench_begin_awake(const char *name) {
+    while (*name) GPIOR0 = *name++;
+    GPIOR1 = 2;
+}
+
+/* This function is used internally to end a measurement.
+ */
+void _bench_end(void) {
+    GPIOR2 = 1;
+}
+
+int main(void) {
+    /* Everything the firmware does before the first slice: the
+     * power reduction, the init of every task with the OLED init
+     * and its waits, and the watchdog.
+     */
+    _bench_begin("boot");
+    _boot();
+    _bench_end();
+
+    // Let the ADC interrupt fill the RSSI buffer
+    _delay_ms(10);
+
+    // Interrupts would add noise to the measurements below
+    cli();
+
+    _bench_begin("_freq_to_data");
+    bench_sink = _freq_to_data(5732);
+    _bench_end();
+
+    _bench_begin("_spi_write");
+    _spi_write(bench_sink, 0x01);
+    _bench_end();
+
+    _bench_begin("video_rx_set_word");
+    video_rx_set_word(channel_word(CHANNEL_INDEX(4, 7)), 5917);
+    _bench_end();
+
+    _bench_begin("oled_tile_num_fixed");
+    oled_tile_num_fixed(5917, 4, 0, 0, 1);
+    _bench_end();
+
+    _bench_begin("oled_write_num_fixed");
+    oled_write_num_fixed(5917, 4, 1, 0, 1);
+    _bench_end();
+
+    _bench_begin("scan_start_channels");
+    scan_start_channels();
+    _bench_end();
+    scan_cancel();
+
+    /* The tasks, in the order of their priority. Together
+     * they are the slice in which every task is released. It
+     * is on the spectrum page, where the sweep and the bars
+     * are the most work of all the pages.
+     */
+    state_set_position(4, 7, 5917);
+    state_set_page(OLED_PAGE_SPECTRUM);
+    oled_tile_invalidate();
+
+    _bench_begin("slice_all");
+    _bench_begin("driver_buttons");
+    driver_buttons();
+    _bench_end();
+    _bench_begin("driver_rx_freq");
+    driver_rx_freq();
+    _bench_end();
+    _bench_begin("driver_rx_rssi");
+    driver_rx_rssi();
+    _bench_end();
+    _bench_begin("driver_scan");
+    driver_scan();
+    _bench_end();
+    _bench_begin("driver_spectrum");
+    driver_spectrum();
+    _bench_end();
+    _bench_begin("driver_pilots");
+    driver_pilots();
+    _bench_end();
+    _bench_begin("driver_oled");
+    driver_oled();
+    _bench_end();
+    _bench_begin("driver_settings");
+    driver_settings();
+    _bench_end();
+    _bench_begin("driver_telemetry");
+    driver_telemetry();
+    _bench_end();
+    _bench_end();
+
+    /* The pilots have nothing to do on the spectrum page. On
+     * their own page the first run plans the order and tunes
+     * the receiver to the first pilot, the longest they take.
+     */
+    state_set_page(OLED_PAGE_PILOTS);
+    _bench_begin("driver_pilots_start");
+    driver_pilots();
+    _bench_end();
+
+    // Let the I2C interrupt send what the OLED task queued
+    sei();
+    i2c_wait_idle();
+    state_set_page(OLED_PAGE_MAIN);
+
+    /* One second of normal operation, like main() runs it. The
+     * awake cycles are what the CPU draws active current for,
+     * the rest of the time it is in idle sleep.
+     */
+    _bench_begin_awake("awake_1s");
+    rtos_enable();
+    uint16_t start = rtos_get_ticks();
+    while ((uint16_t)(rtos_get_ticks() - start) < 1000000UL / RTOS_SLICE_US) {
+        watchdog_kick();
+        if (rtos_dispatch()) continue;
+        rtos_idle();
+    }
+    rtos_disable();
+    _bench_end();
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    cli();
+    sleep_cpu();    // Ends the simulation
+
+    while (1);
+}
+
+#endif
@@ -1,33 +1,221 @@
 #include "buttons.h"
-#include <avr/io.h>
+#include "hal.h"
+#include "rtos.h"
+#include "trace.h"
 
-/* This function initializes pins D4-D7 as
- * pulled-up inputs.
+#define BUTTON_COUNT 4
+
+// Queue lengths, must be powers of 2
+#define RAW_QUEUE_LEN   8
+#define EVENT_QUEUE_LEN 8
+
+/* Every edge on D4-D7 is captured by the pin change interrupt
+ * with the state of the pins and the time. The queue is single
+ * producer (interrupt), single consumer (buttons_update()).
+ */
+typedef struct raw_sample {
+    uint8_t pins;
+    uint16_t time;
+} raw_sample_t;
+
+raw_sample_t raw_queue[RAW_QUEUE_LEN];
+volatile uint8_t raw_head = 0;
+volatile uint8_t raw_tail = 0;
+volatile uint8_t raw_overrun = 0;
+
+// Called by the interrupt on every edge
+void (*buttons_wakeup)(void) = 0;
+
+// The last processed raw state and when it started
+uint8_t raw_pins = 0;
+uint16_t raw_time = 0;
+
+/* Debouncer state. The integrator of a button counts up while
+ * the button is down and down while it is up, in milliseconds.
+ */
+uint8_t integrator[BUTTON_COUNT];
+uint8_t debounced = 0;
+
+// Long press and auto-repeat state of the held buttons
+uint16_t press_time[BUTTON_COUNT];
+uint16_t repeat_interval[BUTTON_COUNT];
+uint8_t long_sent = 0;
+
+button_event_t event_queue[EVENT_QUEUE_LEN];
+uint8_t event_head = 0;
+uint8_t event_tail = 0;
+
+/* This function is used internally to read the pins,
+ * a set bit means the button is down.
  */
-void buttons_init(void) {
+uint8_t _buttons_pins(void) {
+    return ((~hal_buttons_pins()) >> 4) & 0x0F;
+}
+
+/* This function initializes pins D4-D7 as pulled-up
+ * inputs and enables their pin change interrupt. The
+ * wakeup function is called from the interrupt on every
+ * edge, so the caller can sleep while buttons_idle().
+ */
+void buttons_init(void (*wakeup)(void)) {
+    buttons_wakeup = wakeup;
+
     // Pins 4-7 as inputs
     DDRD &= 0x0f;
     // Enable pullups
     PORTD |= 0xf0;
+
+    raw_pins = _buttons_pins();
+    raw_time = rtos_get_time_ms();
+
+    // Pin change interrupt on PCINT20-23 (D4-D7)
+    PCMSK2 |= 0xf0;
+    PCIFR = (1 << PCIF2);
+    PCICR |= (1 << PCIE2);
 }
 
-/* This function returns the current
- * state of the buttons.
+/* This is the pin change interrupt handler. It only records
+ * the new state of the pins, the debouncing is done later.
+ */
+ISR(PCINT2_vect) {
+    uint8_t head = raw_head;
+    if ((uint8_t)(head - raw_tail) >= RAW_QUEUE_LEN) {
+        raw_overrun = 1;
+        return;
+    }
+    uint8_t pins = _buttons_pins();
+    raw_queue[head & (RAW_QUEUE_LEN - 1)].pins = pins;
+    raw_queue[head & (RAW_QUEUE_LEN - 1)].time = rtos_get_time_ms();
+    raw_head = head + 1;
+    trace_event(TRACE_BUTTON_EDGE, pins);
+    if (buttons_wakeup) buttons_wakeup();
+}
+
+/* This function returns the debounced state of the buttons.
  */
 uint8_t buttons_get_state(void) {
-    return ((~PIND) >> 4) & 0x0F;
+    return debounced;
 }
 
-/* This function returns a value indicating
- * whether a button has been pressed since it
- * was last called. (rising edge detection)
+/* This function is used internally to add an event to the
+ * queue. If the queue is full, the event is dropped.
  */
-uint8_t buttons_get_press(void) {
-    static uint8_t lt;
+void _buttons_event(uint8_t type, uint8_t button, uint16_t time) {
+    if ((uint8_t)(event_head - event_tail) >= EVENT_QUEUE_LEN) return;
+    button_event_t *event = &event_queue[event_head & (EVENT_QUEUE_LEN - 1)];
+    event->type = type;
+    event->button = button;
+    event->state = debounced;
+    event->time = time;
+    event_head++;
+}
 
-    uint8_t t = buttons_get_state();
-    uint8_t state = t & ~lt;
+/* This function is used internally to run the debouncer up to
+ * the given time, with the pins in the state they had since
+ * the last call.
+ */
+void _buttons_integrate(uint16_t time) {
+    uint16_t elapsed = time - raw_time;
+    uint8_t step = elapsed > BUTTONS_DEBOUNCE_MS ? BUTTONS_DEBOUNCE_MS : elapsed;
+    raw_time = time;
+    if (step == 0) return;
+
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        uint8_t mask = 1 << i;
+        if (raw_pins & mask) {
+            integrator[i] += step;
+            if (integrator[i] < BUTTONS_DEBOUNCE_MS) continue;
+            integrator[i] = BUTTONS_DEBOUNCE_MS;
+            if (debounced & mask) continue;
+
+            debounced |= mask;
+            press_time[i] = time;
+            repeat_interval[i] = BUTTONS_REPEAT_MS;
+            long_sent &= ~mask;
+            _buttons_event(BUTTON_EVENT_PRESS, mask, time);
+        } else {
+            integrator[i] = integrator[i] > step ? integrator[i] - step : 0;
+            if (integrator[i] > 0 || !(debounced & mask)) continue;
+
+            debounced &= ~mask;
+            _buttons_event(BUTTON_EVENT_RELEASE, mask, time);
+        }
+    }
+}
+
+/* This function is used internally to send the long press
+ * and repeat events of the buttons that are held down.
+ */
+void _buttons_repeat(uint16_t time) {
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        uint8_t mask = 1 << i;
+        if (!(debounced & mask)) continue;
+
+        uint16_t held = time - press_time[i];
+        if (!(long_sent & mask)) {
+            if (held < BUTTONS_LONG_MS) continue;
+            long_sent |= mask;
+            press_time[i] += BUTTONS_LONG_MS;
+            _buttons_event(BUTTON_EVENT_LONG, mask, time);
+            continue;
+        }
+
+        // press_time now holds the time of the last repeat.
+        if (held < repeat_interval[i]) continue;
+        press_time[i] += repeat_interval[i];
+        repeat_interval[i] -= repeat_interval[i] >> 2;
+        if (repeat_interval[i] < BUTTONS_REPEAT_MIN_MS) repeat_interval[i] = BUTTONS_REPEAT_MIN_MS;
+        _buttons_event(BUTTON_EVENT_REPEAT, mask, time);
+    }
+}
 
-    lt = t;
-    return state;
+/* This function processes the captured edges and creates
+ * the events. It must be called regularly, every few ms,
+ * because the buttons are only debounced in here.
+ */
+void buttons_update(void) {
+    uint8_t tail = raw_tail;
+    while (tail != raw_head) {
+        raw_sample_t *sample = &raw_queue[tail & (RAW_QUEUE_LEN - 1)];
+        _buttons_integrate(sample->time);
+        raw_pins = sample->pins;
+        tail++;
+    }
+    raw_tail = tail;
+
+    uint16_t now = rtos_get_time_ms();
+
+    // Edges were lost, continue from the current state.
+    if (raw_overrun) {
+        raw_overrun = 0;
+        _buttons_integrate(now);
+        raw_pins = _buttons_pins();
+    }
+
+    _buttons_integrate(now);
+    _buttons_repeat(now);
+}
+
+/* This function returns 1 if buttons_update() has nothing
+ * to do until the next edge: all buttons are up and settled,
+ * and no edges or events are waiting. It should be called
+ * with interrupts disabled, so an edge can't slip in between.
+ */
+uint8_t buttons_idle(void) {
+    if (raw_tail != raw_head || raw_overrun || raw_pins || debounced) return 0;
+    if (event_tail != event_head) return 0;
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        if (integrator[i]) return 0;
+    }
+    return 1;
+}
+
+/* This function takes the oldest event from the queue. It
+ * returns 1 if there was one, otherwise 0.
+ */
+uint8_t buttons_get_event(button_event_t *event) {
+    if (event_tail == event_head) return 0;
+    *event = event_queue[event_tail & (EVENT_QUEUE_LEN - 1)];
+    event_tail++;
+    return 1;
 }
@@ -0,0 +1,90 @@
+/* Generated by scripts/channels_gen.py, do not edit.
+ * The channels in band order, with the SYN_REG_B write that
+ * tunes the RX to them, and their indices sorted by frequency.
+ */
+
+#include "channels.h"
+
+#if CHANNEL_BANDS != 8 || CHANNEL_PER_BAND != 8
+#error "CHANNEL_BANDS or CHANNEL_PER_BAND don't match the table"
+#endif
+
+const char channel_band_letters[] PROGMEM = "ABEFRLXU";
+
+const channel_t channels[CHANNEL_COUNT] PROGMEM = {
+    {5865, 0x000A8151UL}, // A1
+    {5845, 0x000A72D1UL}, // A2
+    {5825, 0x000A7051UL}, // A3
+    {5805, 0x000A61D1UL}, // A4
+    {5785, 0x000A5351UL}, // A5
+    {5765, 0x000A50D1UL}, // A6
+    {5745, 0x000A4251UL}, // A7
+    {5725, 0x000A33D1UL}, // A8
+    {5733, 0x000A40D1UL}, // B1
+    {5752, 0x00052191UL}, // B2
+    {5771, 0x000A5191UL}, // B3
+    {5790, 0x000523F1UL}, // B4
+    {5809, 0x000A6251UL}, // B5
+    {5828, 0x00053251UL}, // B6
+    {5847, 0x000A7311UL}, // B7
+    {5866, 0x000540B1UL}, // B8
+    {5705, 0x000A3151UL}, // E1
+    {5685, 0x000A22D1UL}, // E2
+    {5665, 0x000A2051UL}, // E3
+    {5645, 0x000A11D1UL}, // E4
+    {5885, 0x000A83D1UL}, // E5
+    {5905, 0x000A9251UL}, // E6
+    {5925, 0x000AA0D1UL}, // E7
+    {5945, 0x000AA351UL}, // E8
+    {5740, 0x000520D1UL}, // F1
+    {5760, 0x00052211UL}, // F2
+    {5780, 0x00052351UL}, // F3
+    {5800, 0x00053091UL}, // F4
+    {5820, 0x000531D1UL}, // F5
+    {5840, 0x00053311UL}, // F6
+    {5860, 0x00054051UL}, // F7
+    {5880, 0x00054191UL}, // F8
+    {5658, 0x000503B1UL}, // R1
+    {5695, 0x000A3011UL}, // R2
+    {5732, 0x00052051UL}, // R3
+    {5769, 0x000A5151UL}, // R4
+    {5806, 0x000530F1UL}, // R5
+    {5843, 0x000A7291UL}, // R6
+    {5880, 0x00054191UL}, // R7
+    {5917, 0x000A93D1UL}, // R8
+    {5362, 0x0004C131UL}, // L1
+    {5399, 0x00099311UL}, // L2
+    {5436, 0x0004D1D1UL}, // L3
+    {5473, 0x0009C051UL}, // L4
+    {5510, 0x0004E271UL}, // L5
+    {5547, 0x0009E191UL}, // L6
+    {5584, 0x0004F311UL}, // L7
+    {5621, 0x000A02D1UL}, // L8
+    {4990, 0x000461F1UL}, // X1
+    {5020, 0x000463D1UL}, // X2
+    {5050, 0x000471B1UL}, // X3
+    {5080, 0x00047391UL}, // X4
+    {5110, 0x00048171UL}, // X5
+    {5140, 0x00048351UL}, // X6
+    {5170, 0x00049131UL}, // X7
+    {5200, 0x00049311UL}, // X8
+    {5333, 0x000972D1UL}, // U1
+    {5373, 0x000983D1UL}, // U2
+    {5413, 0x0009A0D1UL}, // U3
+    {5453, 0x0009B1D1UL}, // U4
+    {5493, 0x0009C2D1UL}, // U5
+    {5533, 0x0009D3D1UL}, // U6
+    {5573, 0x0009F0D1UL}, // U7
+    {5613, 0x000A01D1UL}, // U8
+};
+
+const uint8_t channels_by_freq[CHANNEL_COUNT] PROGMEM = {
+    48, 49, 50, 51, 52, 53, 54, 55,
+    56, 40, 57, 41, 58, 42, 59, 43,
+    60, 44, 61, 45, 62, 46, 63, 47,
+    19, 32, 18, 17, 33, 16,  7, 34,
+     8, 24,  6,  9, 25,  5, 35, 10,
+    26,  4, 11, 27,  3, 36, 12, 28,
+     2, 13, 29, 37,  1, 14, 30,  0,
+    15, 31, 38, 20, 21, 39, 22, 23,
+};
@@ -0,0 +1,66 @@
+#include "channels.h"
+
+/* The lookups in the channel database. The table itself is
+ * generated, see channel_table.c.
+ */
+
+/* These functions return the frequency and the SYN_REG_B
+ * write of a channel.
+ */
+uint16_t channel_freq(uint8_t index) {
+    return pgm_read_word(&channels[index].freq);
+}
+
+uint32_t channel_word(uint8_t index) {
+    return pgm_read_dword(&channels[index].word);
+}
+
+/* This function returns the index of the n-th channel in
+ * frequency order, from the lowest up.
+ */
+uint8_t channel_nth(uint8_t n) {
+    return pgm_read_byte(&channels_by_freq[n]);
+}
+
+/* This function is used internally to find the position in
+ * frequency order of the first channel at freq or above,
+ * CHANNEL_COUNT if there is none.
+ */
+uint8_t _channel_lower_bound(uint16_t freq) {
+    uint8_t low = 0;
+    uint8_t high = CHANNEL_COUNT;
+    while (low < high) {
+        uint8_t middle = (low + high) / 2;
+        if (channel_freq(channel_nth(middle)) < freq) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+/* This function returns the index of the channel closest
+ * to freq. Of two equally close ones it returns the lower.
+ */
+uint8_t channel_nearest(uint16_t freq) {
+    uint8_t n = _channel_lower_bound(freq);
+    if (n == CHANNEL_COUNT) return channel_nth(n - 1);
+    if (n == 0) return channel_nth(0);
+
+    uint16_t above = channel_freq(channel_nth(n)) - freq;
+    uint16_t below = freq - channel_freq(channel_nth(n - 1));
+    return channel_nth(below <= above ? n - 1 : n);
+}
+
+/* This function returns the index of the channel with the
+ * next higher frequency than freq, or the next lower one if
+ * direction is negative. Channels on the same frequency are
+ * skipped, and the search wraps around at the ends of the band.
+ */
+uint8_t channel_next(uint16_t freq, int8_t direction) {
+    if (direction < 0) {
+        uint8_t n = _channel_lower_bound(freq);
+        return channel_nth(n > 0 ? n - 1 : CHANNEL_COUNT - 1);
+    }
+
+    uint8_t n = _channel_lower_bound(freq + 1);
+    return channel_nth(n < CHANNEL_COUNT ? n : 0);
+}
@@ -0,0 +1,232 @@
+#ifdef HAL_NATIVE
+
+#include "hal.h"
+
+/* Simulated hardware for the native build, see hal_native.h.
+ * This file is empty in the AVR build.
+ */
+
+volatile uint8_t PORTB, DDRB, PINB, PORTC, DDRC, PINC, PORTD, DDRD,
+    PIND, TWCR, TWDR, TWSR, TWBR, TWAR, TWAMR, SPCR, SPSR, SPDR,
+    ADCSRA, ADCSRB, ADMUX, ADCL, ADCH, DIDR0, TCCR1A, TCCR1B, TCCR1C,
+    TIMSK1, TIFR1, TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0,
+    TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, TIFR2, ASSR, PCICR,
+    PCMSK0, PCMSK1, PCMSK2, PCIFR, EICRA, EIMSK, EECR, EEDR, SMCR,
+    MCUCR, MCUSR, PRR, WDTCSR, UCSR0A, UCSR0B, UCSR0C, UDR0, GPIOR0,
+    GPIOR1, GPIOR2, SREG, ACSR;
+volatile uint16_t ADC, TCNT1, ICR1, OCR1A, OCR1B, EEAR, UBRR0, SP;
+
+uint32_t hal_native_time_us = 0;
+
+uint8_t hal_native_twi_address = 0x3C;
+uint16_t hal_native_adc = 0;
+uint8_t hal_native_pind = 0xFF;
+
+uint8_t hal_native_eeprom[HAL_NATIVE_EEPROM_LEN] = {[0 ... HAL_NATIVE_EEPROM_LEN - 1] = 0xFF};
+
+uint8_t hal_native_twi_log[HAL_NATIVE_LOG_LEN];
+uint16_t hal_native_twi_log_len = 0;
+uint8_t hal_native_spi_log[HAL_NATIVE_LOG_LEN];
+uint16_t hal_native_spi_log_len = 0;
+uint8_t hal_native_uart_log[HAL_NATIVE_LOG_LEN];
+uint16_t hal_native_uart_log_len = 0;
+
+// State of the simulated TWI bus
+uint8_t twi_in_transaction = 0;
+uint8_t twi_expect_address = 0;
+uint8_t twi_acked = 0;
+
+
+/* This function advances the simulated time instead
+ * of waiting.
+ */
+void hal_native_delay_us(uint32_t us) {
+    hal_native_time_us += us;
+}
+
+/* This function simulates the TWI in master transmitter mode.
+ * Every operation completes immediately: the TWINT flag is set
+ * again and TWSR holds the status the hardware would report.
+ */
+void hal_twi_set_control(uint8_t value) {
+    TWCR = value;
+    if (!(value & (1 << TWEN))) {
+        twi_in_transaction = 0;
+        return;
+    }
+
+    if (value & (1 << TWSTO)) {
+        twi_in_transaction = 0;
+        TWSR = 0xF8;
+        TWCR &= ~(1 << TWSTO);
+        if (!(value & (1 << TWSTA))) return;
+    }
+
+    if (value & (1 << TWSTA)) {
+        TWSR = twi_in_transaction ? 0x10 : 0x08;
+        twi_in_transaction = 1;
+        twi_expect_address = 1;
+        TWCR |= (1 << TWINT);
+        return;
+    }
+
+    if ((value & (1 << TWINT)) && twi_in_transaction) {
+        if (twi_expect_address) {
+            twi_expect_address = 0;
+            twi_acked = hal_native_twi_address && (TWDR >> 1) == hal_native_twi_address;
+            TWSR = twi_acked ? 0x18 : 0x20;
+        } else if (twi_acked) {
+            if (hal_native_twi_log_len < HAL_NATIVE_LOG_LEN) {
+                hal_native_twi_log[hal_native_twi_log_len++] = TWDR;
+            }
+            TWSR = 0x28;
+        } else {
+            TWSR = 0x30;
+        }
+        TWCR |= (1 << TWINT);
+    }
+}
+
+uint8_t hal_twi_control(void) {
+    return TWCR;
+}
+
+uint8_t hal_twi_status(void) {
+    return TWSR & 0xF8;
+}
+
+void hal_twi_set_data(uint8_t value) {
+    TWDR = value;
+}
+
+/* The SPI records every byte and finishes at once.
+ */
+void hal_spi_set_data(uint8_t value) {
+    SPDR = value;
+    if (hal_native_spi_log_len < HAL_NATIVE_LOG_LEN) {
+        hal_native_spi_log[hal_native_spi_log_len++] = value;
+    }
+}
+
+uint8_t hal_spi_done(void) {
+    return 1;
+}
+
+/* The ADC returns whatever the test set, and every
+ * conversion is finished.
+ */
+uint16_t hal_adc_result(void) {
+    ADC = hal_native_adc;
+    return ADC;
+}
+
+uint8_t hal_adc_busy(void) {
+    return 0;
+}
+
+uint8_t hal_buttons_pins(void) {
+    PIND = hal_native_pind;
+    return PIND;
+}
+
+/* The EEPROM is an array, writes finish at once.
+ */
+uint8_t hal_eeprom_busy(void) {
+    return 0;
+}
+
+uint8_t hal_eeprom_read(uint16_t address) {
+    EEDR = hal_native_eeprom[address & (HAL_NATIVE_EEPROM_LEN - 1)];
+    return EEDR;
+}
+
+void hal_eeprom_write(uint16_t address, uint8_t value) {
+    hal_native_eeprom[address & (HAL_NATIVE_EEPROM_LEN - 1)] = value;
+}
+
+/* The UART records every byte that is sent.
+ */
+void hal_uart_set_data(uint8_t value) {
+    UDR0 = value;
+    if (hal_native_uart_log_len < HAL_NATIVE_LOG_LEN) {
+        hal_native_uart_log[hal_native_uart_log_len++] = value;
+    }
+}
+
+uint8_t hal_uart_data(void) {
+    return UDR0;
+}
+
+/* The stack of the PC isn't in the simulated RAM, so the
+ * simulated stack is always empty.
+ */
+uint16_t hal_stack_pointer(void) {
+    return RAMEND;
+}
+
+/* The reset flags are whatever the test put into MCUSR.
+ */
+uint8_t hal_reset_flags(void) {
+    return MCUSR;
+}
+
+uint16_t hal_timer1_count(void) {
+    return TCNT1;
+}
+
+uint8_t hal_timer1_pending(void) {
+    return TIFR1 & (1 << ICF1);
+}
+
+/* This function calls the TWI interrupt handler for as long
+ * as the I2C engine has the interrupt enabled and the flag is
+ * set, like the hardware would while the CPU is running.
+ */
+void hal_native_run_twi(void) {
+    while ((SREG & 0x80) && (TWCR & (1 << TWIE)) && (TWCR & (1 << TWINT))) {
+        TWI_vect();
+    }
+}
+
+/* This function calls the EEPROM ready interrupt handler
+ * for as long as it is enabled. The simulated EEPROM is
+ * always ready.
+ */
+void hal_native_run_eeprom(void) {
+    while ((SREG & 0x80) && (EECR & (1 << EERIE))) {
+        EE_READY_vect();
+    }
+}
+
+/* This function calls the UART data register empty handler
+ * for as long as it is enabled, the simulated UART sends
+ * every byte at once.
+ */
+void hal_native_run_uart(void) {
+    while ((SREG & 0x80) && (UCSR0B & (1 << UDRIE0))) {
+        USART_UDRE_vect();
+    }
+}
+
+/* This function lets the UART receive a byte from the host.
+ */
+void hal_native_uart_receive(uint8_t byte) {
+    UDR0 = byte;
+    if ((SREG & 0x80) && (UCSR0B & (1 << RXCIE0))) USART_RX_vect();
+}
+
+/* This function clears the recorded traffic and the
+ * state of the simulated peripherals.
+ */
+void hal_native_reset(void) {
+    hal_native_time_us = 0;
+    hal_native_twi_log_len = 0;
+    hal_native_spi_log_len = 0;
+    hal_native_uart_log_len = 0;
+    twi_in_transaction = 0;
+    twi_expect_address = 0;
+    twi_acked = 0;
+    for (uint16_t i = 0; i < HAL_NATIVE_EEPROM_LEN; i++) hal_native_eeprom[i] = 0xFF;
+}
+
+#endif
@@ -0,0 +1,381 @@
+#include "i2c.h"
+#include "hal.h"
+#include "pins.h"
+#include "rtos.h"
+
+/* (7) Clear TWI Interrupt Flag, (6) Enable Acknowledge bit,
+ * (5) START, (4) STOP, (3) Write Collision Flag is RO, (2) Enable TWI
+ * Bit 1 is reserved, (0) disable TWI Interrupt
+ */
+#define TWCR_CONFIG 0b11000100
+
+// Same as above, but with the TWI Interrupt enabled
+#define TWCR_ASYNC  0b11000101
+
+/* A queued transaction. The data bytes are stored in order
+ * in the shared byte buffer, so only the length is kept here.
+ */
+typedef struct i2c_transaction {
+    uint8_t address;
+    uint8_t length;
+    i2c_callback callback;
+} i2c_transaction_t;
+
+/* The queue and the byte buffer are single producer, single
+ * consumer rings. The heads are only written by the producer
+ * and the tails only by the engine. The indices run freely
+ * and are masked on access, so both sizes must be powers of 2.
+ */
+i2c_transaction_t i2c_queue[I2C_QUEUE_LEN];
+volatile uint8_t i2c_queue_head = 0;
+volatile uint8_t i2c_queue_tail = 0;
+
+uint8_t i2c_buffer[I2C_BUFFER_LEN];
+volatile uint8_t i2c_buffer_head = 0;
+volatile uint8_t i2c_buffer_tail = 0;
+
+// The transaction that is currently being built
+uint8_t i2c_new_head;
+uint8_t i2c_new_length;
+uint8_t i2c_new_state = 0;  // 0 - none, 1 - building, 2 - overflowed
+
+// The state of the engine
+volatile uint8_t i2c_active = 0;
+uint8_t i2c_remaining;
+uint16_t i2c_started;
+
+
+/* The blocking waits poll the TWI every I2C_WAIT_STEP_US and
+ * add up the steps, so their timeout is a time no matter how
+ * fast the loop runs. The RTOS clock can't be used here, the
+ * OLED is set up from the init of its task, before
+ * rtos_enable(), and i2c_wait_idle() may be called with
+ * interrupts disabled, when the slices aren't counted.
+ */
+#define I2C_WAIT_STEP_US 1
+
+/* This function is used internaly to wait for the I2C interface
+ * to stop transmitting, and check whether it was successful.
+ * To prevent blocking for too long, it gives up after
+ * I2C_WAIT_TIMEOUT_US. A return value of 0 means success,
+ * other values indicate an error.
+ */
+uint8_t _wait_TWCR(uint8_t cr_bit, uint8_t sr_value, uint8_t negate) {
+    uint16_t waited = 0;
+    while ((hal_twi_control() & (1 << cr_bit)) ? !negate : negate) {
+        if (waited >= I2C_WAIT_TIMEOUT_US) return 1;
+        _delay_us(I2C_WAIT_STEP_US);
+        waited += I2C_WAIT_STEP_US;
+    }
+    if (!(hal_twi_status() == sr_value)) return 2;
+    return 0;
+}
+
+/* This function is used internally to start the next queued
+ * transaction, or to put the engine to rest if the queue is
+ * empty. If stop is set, a STOP condition is sent first.
+ * Must be called with interrupts disabled.
+ */
+void _i2c_start_next(uint8_t stop) {
+    uint8_t stop_bits = stop ? (1 << TWSTO) : 0;
+
+    if (i2c_queue_head == i2c_queue_tail) {
+        i2c_active = 0;
+        hal_twi_set_control(TWCR_CONFIG | stop_bits);
+        return;
+    }
+
+    /* A STOP sent while the engine was idle may still be
+     * in progress, it only takes a few microseconds.
+     */
+    if (!stop) while (hal_twi_control() & (1 << TWSTO));
+
+    i2c_active = 1;
+    i2c_remaining = i2c_queue[i2c_queue_tail & (I2C_QUEUE_LEN - 1)].length;
+    i2c_started = rtos_get_ticks();
+    // If both are set, the TWI sends a STOP followed by a START.
+    hal_twi_set_control(TWCR_ASYNC | stop_bits | (1 << TWSTA));
+}
+
+/* This function is used internally to remove the current
+ * transaction from the queue, skipping any bytes that were
+ * not sent. It returns the transaction's callback.
+ */
+i2c_callback _i2c_pop(void) {
+    i2c_callback callback = i2c_queue[i2c_queue_tail & (I2C_QUEUE_LEN - 1)].callback;
+    i2c_buffer_tail += i2c_remaining;
+    i2c_remaining = 0;
+    i2c_queue_tail++;
+    return callback;
+}
+
+/* This function is used internally to finish the current
+ * transaction with a STOP condition and start the next one.
+ */
+void _i2c_finish(uint8_t status) {
+    i2c_callback callback = _i2c_pop();
+    _i2c_start_next(1);
+    if (callback) callback(status);
+}
+
+/* This function is used internally to abort the current
+ * transaction, free the bus and start the next one.
+ * Must be called with interrupts disabled.
+ */
+void _i2c_abort(uint8_t status) {
+    i2c_callback callback = _i2c_pop();
+    i2c_recover_bus();
+    _i2c_start_next(0);
+    if (callback) callback(status);
+}
+
+/* This is the state machine of the engine. It is called from
+ * the TWI interrupt, or polled by i2c_wait_idle() when
+ * interrupts are disabled.
+ */
+void _i2c_step(void) {
+    switch (hal_twi_status()) {
+    case 0x08:  // START sent
+    case 0x10:  // Repeated START sent
+        hal_twi_set_data(i2c_queue[i2c_queue_tail & (I2C_QUEUE_LEN - 1)].address << 1);
+        hal_twi_set_control(TWCR_ASYNC);
+        break;
+    case 0x18:  // Address sent, ACK received
+    case 0x28:  // Data sent, ACK received
+        if (i2c_remaining) {
+            hal_twi_set_data(i2c_buffer[i2c_buffer_tail & (I2C_BUFFER_LEN - 1)]);
+            i2c_buffer_tail++;
+            i2c_remaining--;
+            hal_twi_set_control(TWCR_ASYNC);
+        } else {
+            _i2c_finish(I2C_OK);
+        }
+        break;
+    case 0x20:  // Address sent, NACK received
+    case 0x30:  // Data sent, NACK received
+        _i2c_finish(I2C_NACK);
+        break;
+    default:    // Bus error or lost arbitration
+        _i2c_finish(I2C_BUS_ERROR);
+        break;
+    }
+}
+
+ISR(TWI_vect) {
+    _i2c_step();
+}
+
+/* This function initializes the I2C (2-wire) interface. If a
+ * slave is holding SDA low (for example after a reset in the
+ * middle of a transfer), the bus is recovered first.
+ */
+void i2c_init(void) {
+    // SCL = F_CPU / (16 + 2 * TWBR * prescaler)
+    TWBR = (F_CPU / I2C_SCL_HZ - 16) / 2;
+    TWSR = 0;           // Set prescaler to 1
+
+    setGpioInputPullup(I2C_SDA);
+    setGpioInputPullup(I2C_SCL);
+    if (!readGpio(I2C_SDA)) i2c_recover_bus();
+
+    hal_twi_set_control(TWCR_CONFIG);
+}
+
+/* This function frees a stuck bus. The TWI is disabled and SCL
+ * is clocked manually until the slave releases SDA, after which
+ * a STOP condition is generated and the TWI is enabled again.
+ * The pins are driven as open drain by switching the direction.
+ */
+void i2c_recover_bus(void) {
+    hal_twi_set_control(0);
+
+    setGpioLow(I2C_SCL);
+    setGpioLow(I2C_SDA);
+    for (uint8_t i = 0; i < 9 && !readGpio(I2C_SDA); i++) {
+        setGpioOutput(I2C_SCL);     // SCL low
+        _delay_us(5);
+        setGpioInput(I2C_SCL);      // SCL released
+        _delay_us(5);
+    }
+
+    // STOP: SDA goes high while SCL is high
+    setGpioOutput(I2C_SCL);
+    _delay_us(5);
+    setGpioOutput(I2C_SDA);
+    _delay_us(5);
+    setGpioInput(I2C_SCL);
+    _delay_us(5);
+    setGpioInput(I2C_SDA);
+
+    setGpioInputPullup(I2C_SDA);
+    setGpioInputPullup(I2C_SCL);
+    hal_twi_set_control(TWCR_CONFIG);
+}
+
+/* This function is used to begin a blocking I2C transaction.
+ * It waits for any queued transactions to finish, sends a START
+ * condition, waits for an ACK, then it sends the device address
+ * and waits for another ACK. A return value of 0 means success,
+ * other values indicate an error.
+ */
+uint8_t i2c_start(uint8_t address) {
+    if (i2c_wait_idle()) return 3;
+
+    hal_twi_set_control(TWCR_CONFIG | (1 << TWSTA));  // Send START
+
+    if(_wait_TWCR(TWINT, 0x08, 1)) return 1;
+
+    hal_twi_set_data(address << 1);  // Send address
+    hal_twi_set_control(TWCR_CONFIG);
+
+    if(_wait_TWCR(TWINT, 0x18, 1)) return 2;
+
+    return 0;
+}
+
+/* This function sends a single byte in a blocking transaction
+ * and waits for an ACK. A return value of 0 means success.
+ */
+uint8_t i2c_write(uint8_t data) {
+    hal_twi_set_data(data);
+    hal_twi_set_control(TWCR_CONFIG); // Clears the interrupt flag and starts the transmission
+
+    return _wait_TWCR(TWINT, 0x28, 1);
+}
+
+/* This function is used to end a blocking I2C transaction.
+ * It sends a STOP condition. There is no ACK for the STOP
+ * condition, so the function simply waits for the interface
+ * to finish transmitting and then it returns.
+ */
+void i2c_stop(void) {
+    hal_twi_set_control(TWCR_CONFIG | (1 << TWSTO));  // Send STOP
+
+    _wait_TWCR(TWSTO, 0, 0);    // We don't care about the return value
+}
+
+/* This function starts building a new queued transaction.
+ * A return value of 0 means success, 1 means the queue is full.
+ */
+uint8_t i2c_queue_begin(uint8_t address, i2c_callback callback) {
+    if ((uint8_t)(i2c_queue_head - i2c_queue_tail) >= I2C_QUEUE_LEN) return 1;
+
+    i2c_transaction_t *transaction = &i2c_queue[i2c_queue_head & (I2C_QUEUE_LEN - 1)];
+    transaction->address = address;
+    transaction->callback = callback;
+
+    i2c_new_head = i2c_buffer_head;
+    i2c_new_length = 0;
+    i2c_new_state = 1;
+    return 0;
+}
+
+/* This function adds a byte to the transaction that is being
+ * built. If the buffer is full, 1 is returned and the whole
+ * transaction will be dropped by i2c_queue_commit().
+ */
+uint8_t i2c_queue_put(uint8_t data) {
+    if (i2c_new_state != 1) return 1;
+
+    if ((uint8_t)(i2c_new_head - i2c_buffer_tail) >= I2C_BUFFER_LEN || i2c_new_length == 0xFF) {
+        i2c_new_state = 2;
+        return 1;
+    }
+
+    i2c_buffer[i2c_new_head & (I2C_BUFFER_LEN - 1)] = data;
+    i2c_new_head++;
+    i2c_new_length++;
+    return 0;
+}
+
+/* This function hands the transaction over to the engine and
+ * starts it if the bus is idle. A return value of 0 means
+ * success, 1 means the transaction didn't fit and was dropped.
+ */
+uint8_t i2c_queue_commit(void) {
+    uint8_t state = i2c_new_state;
+    i2c_new_state = 0;
+    if (state != 1) return 1;
+
+    i2c_queue[i2c_queue_head & (I2C_QUEUE_LEN - 1)].length = i2c_new_length;
+    // Publish the bytes before the transaction itself.
+    i2c_buffer_head = i2c_new_head;
+    i2c_queue_head++;
+
+    uint8_t sreg = SREG;
+    cli();
+    if (!i2c_active) _i2c_start_next(0);
+    SREG = sreg;
+
+    return 0;
+}
+
+/* This function returns the number of free bytes in the buffer.
+ * It returns 0 if there is no free slot in the queue, so it can
+ * be used to check whether a transaction of a given size fits.
+ */
+uint8_t i2c_queue_free(void) {
+    if ((uint8_t)(i2c_queue_head - i2c_queue_tail) >= I2C_QUEUE_LEN) return 0;
+    return I2C_BUFFER_LEN - (uint8_t)(i2c_buffer_head - i2c_buffer_tail);
+}
+
+/* This function returns 1 while there are queued transactions.
+ */
+uint8_t i2c_busy(void) {
+    return i2c_active;
+}
+
+/* This function blocks until all queued transactions are sent.
+ * If interrupts are disabled, the engine is polled directly. If
+ * the engine makes no progress for I2C_WAIT_TIMEOUT_US, the
+ * current transaction is aborted and 1 is returned once the
+ * queue is empty.
+ */
+uint8_t i2c_wait_idle(void) {
+    uint8_t error = 0;
+    uint16_t waited = 0;
+    // Bytes sent by the interrupt count as progress as well.
+    uint8_t sent = i2c_buffer_tail;
+    uint8_t finished = i2c_queue_tail;
+    while (i2c_active) {
+        uint8_t progress = 1;
+        uint8_t sreg = SREG;
+        cli();
+        if (i2c_active && (hal_twi_control() & (1 << TWINT))) {
+            _i2c_step();
+        } else if (sent != i2c_buffer_tail || finished != i2c_queue_tail) {
+            sent = i2c_buffer_tail;
+            finished = i2c_queue_tail;
+        } else if (i2c_active && waited >= I2C_WAIT_TIMEOUT_US) {
+            _i2c_abort(I2C_TIMEOUT);
+            error = 1;
+        } else {
+            progress = 0;
+        }
+        SREG = sreg;
+
+        if (progress) {
+            waited = 0;
+        } else {
+            _delay_us(I2C_WAIT_STEP_US);
+            waited += I2C_WAIT_STEP_US;
+        }
+    }
+
+    // Wait for the last STOP condition to go out
+    if (_wait_TWCR(TWSTO, 0, 0) == 1) error = 1;
+    return error;
+}
+
+/* This function checks the current transaction against the
+ * time limit and aborts it if the engine is stuck. It should
+ * be called periodically from a task.
+ */
+void i2c_poll(void) {
+    uint8_t sreg = SREG;
+    cli();
+    if (i2c_active && (uint16_t)(rtos_get_ticks() - i2c_started) > I2C_TIMEOUT_TICKS) {
+        _i2c_abort(I2C_TIMEOUT);
+    }
+    SREG = sreg;
+}
@@ -0,0 +1,234 @@
+#include "laps.h"
+#include "video_rx.h"
+#include "hal.h"
+
+// States of the pass detector
+#define LAPS_OUTSIDE    0
+#define LAPS_INSIDE     1
+
+laps_config_t laps_config = {
+    .enter = LAPS_ENTER_RSSI,
+    .exit = LAPS_EXIT_RSSI,
+    .filter = LAPS_FILTER_SHIFT,
+    .min_lap_ms = LAPS_MIN_LAP_MS
+};
+
+// The thresholds in sample units
+uint16_t laps_enter_sample;
+uint16_t laps_exit_sample;
+
+uint8_t laps_active = 0;
+uint16_t laps_current_freq = 0;
+
+/* The detector. laps_sample counts the samples since
+ * laps_start(), it is the clock. The filter keeps n more
+ * bits than the samples in laps_filter_sum.
+ */
+uint32_t laps_sample;
+uint32_t laps_filter_sum;
+uint16_t laps_filtered;
+uint8_t laps_state;
+
+/* The peak of the current pass, as a filter sum, which has
+ * more bits than the samples, and the first and the last
+ * sample that reached it. A peak is often flat, its time is
+ * the middle of it.
+ */
+uint32_t laps_peak;
+uint32_t laps_peak_first;
+uint32_t laps_peak_last;
+
+// 1 once a pass started the clock, and the time of the last pass
+uint8_t laps_clock_started;
+uint32_t laps_last_pass_us;
+
+// The newest lap times and the best one
+uint32_t laps_times[LAPS_LEN];
+uint16_t laps_total = 0;
+uint32_t laps_best_us = 0;
+uint16_t laps_pass_count = 0;
+laps_pass_t laps_newest;
+
+
+/* This function is used internally to convert an RSSI value
+ * to the raw sample it is scaled from (video_rx_rssi_scale()).
+ */
+uint16_t _laps_to_sample(uint8_t rssi) {
+    return (uint16_t)(rssi + 130) << VIDEO_RX_OVERSAMPLE_BITS;
+}
+
+/* This function sets the thresholds, the filter and the
+ * shortest lap. It returns 1 and changes nothing if the
+ * exit threshold isn't below the enter threshold, or if the
+ * enter threshold or the filter are out of range.
+ */
+uint8_t laps_configure(const laps_config_t *config) {
+    if (config->enter > 99 || config->exit >= config->enter || config->filter > LAPS_FILTER_MAX) return 1;
+    laps_config = *config;
+    laps_enter_sample = _laps_to_sample(config->enter);
+    laps_exit_sample = _laps_to_sample(config->exit);
+    // The filter starts over from the next sample.
+    laps_filter_sum = (uint32_t)laps_filtered << config->filter;
+    return 0;
+}
+
+/* This function copies the configuration into config.
+ */
+void laps_get_config(laps_config_t *config) {
+    *config = laps_config;
+}
+
+/* This function starts the lap timer on freq. The laps that
+ * were timed on another frequency are cleared. The detector
+ * starts outside of the gate, and the next pass starts the
+ * clock again.
+ */
+void laps_start(uint16_t freq) {
+    if (freq != laps_current_freq) {
+        laps_current_freq = freq;
+        laps_total = 0;
+        laps_best_us = 0;
+        for (uint8_t i = 0; i < LAPS_LEN; i++) laps_times[i] = 0;
+    }
+
+    laps_enter_sample = _laps_to_sample(laps_config.enter);
+    laps_exit_sample = _laps_to_sample(laps_config.exit);
+    laps_sample = 0;
+    laps_filtered = 0;
+    laps_filter_sum = 0;
+    laps_state = LAPS_OUTSIDE;
+    laps_clock_started = 0;
+    laps_active = 1;
+}
+
+/* This function stops the lap timer, the laps are kept.
+ */
+void laps_stop(void) {
+    laps_active = 0;
+}
+
+/* This function returns 1 while the lap timer runs.
+ */
+uint8_t laps_running(void) {
+    return laps_active;
+}
+
+/* This function returns the frequency the laps were timed on.
+ */
+uint16_t laps_freq(void) {
+    return laps_current_freq;
+}
+
+/* This function is used internally to record the pass that
+ * just ended. It returns 1 if it counted.
+ */
+uint8_t _laps_pass(void) {
+    // Half a sample is the resolution.
+    uint32_t time = (laps_peak_first + laps_peak_last) * (VIDEO_RX_SAMPLE_US / 2);
+
+    uint32_t lap = time - laps_last_pass_us;
+    if (laps_clock_started && lap < laps_config.min_lap_ms * 1000UL) return 0;
+
+    laps_newest.time_us = time;
+    laps_newest.peak = video_rx_rssi_scale(laps_peak >> laps_config.filter);
+    if (laps_clock_started) {
+        laps_times[laps_total & (LAPS_LEN - 1)] = lap;
+        laps_total++;
+        if (laps_best_us == 0 || lap < laps_best_us) laps_best_us = lap;
+        laps_newest.lap = laps_total;
+        laps_newest.lap_us = lap;
+    } else {
+        laps_newest.lap = 0;
+        laps_newest.lap_us = 0;
+    }
+    laps_clock_started = 1;
+    laps_last_pass_us = time;
+    laps_pass_count++;
+    return 1;
+}
+
+/* This function runs the detector over count consecutive
+ * RSSI samples, as they come from video_rx_rssi_read(). It
+ * returns 1 if one of them ended a pass that counted.
+ */
+uint8_t laps_process(const uint16_t *samples, uint8_t count) {
+    if (!laps_active) return 0;
+
+    uint8_t passed = 0;
+    uint8_t shift = laps_config.filter;
+    for (uint8_t i = 0; i < count; i++, laps_sample++) {
+
+        // The first sample fills the filter.
+        if (laps_filter_sum == 0) laps_filter_sum = (uint32_t)samples[i] << shift;
+        else laps_filter_sum += samples[i] - (laps_filter_sum >> shift);
+        laps_filtered = laps_filter_sum >> shift;
+
+        if (laps_state == LAPS_OUTSIDE) {
+            if (laps_filtered < laps_enter_sample) continue;
+            laps_state = LAPS_INSIDE;
+            laps_peak = 0;
+        }
+
+        if (laps_filter_sum > laps_peak) {
+            laps_peak = laps_filter_sum;
+            laps_peak_first = laps_sample;
+        }
+        if (laps_filter_sum == laps_peak) laps_peak_last = laps_sample;
+
+        if (laps_filtered >= laps_exit_sample) continue;
+        laps_state = LAPS_OUTSIDE;
+        passed |= _laps_pass();
+    }
+    return passed;
+}
+
+/* This function advances the clock over count samples that
+ * were lost (video_rx_rssi_overruns()).
+ */
+void laps_skip(uint8_t count) {
+    laps_sample += count;
+}
+
+/* This function returns the number of laps since the
+ * timer was started on the frequency.
+ */
+uint16_t laps_count(void) {
+    return laps_total;
+}
+
+/* This function returns the time of a lap in us, back laps
+ * before the last one, or 0 if it isn't kept.
+ */
+uint32_t laps_time(uint8_t back) {
+    if (back >= LAPS_LEN || back >= laps_total) return 0;
+    return laps_times[(laps_total - 1 - back) & (LAPS_LEN - 1)];
+}
+
+/* This function returns the time of the fastest lap in
+ * us, 0 if there was none.
+ */
+uint32_t laps_best(void) {
+    return laps_best_us;
+}
+
+/* This function returns the number of passes that counted
+ * since power on, including the ones that started the clock.
+ * It changes with every new pass, laps_last_pass() returns
+ * the newest.
+ */
+uint16_t laps_passes(void) {
+    return laps_pass_count;
+}
+
+/* This function copies the newest pass into pass.
+ */
+void laps_last_pass(laps_pass_t *pass) {
+    *pass = laps_newest;
+}
+
+/* This function returns the filtered RSSI, for setting
+ * the thresholds.
+ */
+uint8_t laps_rssi(void) {
+    return video_rx_rssi_scale(laps_filtered);
+}
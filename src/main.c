@@ -7,26 +7,72 @@
  *              CH2 (CS)   - D10
  *              CH3 (CLK)  - D13
  *              RSSI        - A0
+ *  Diversity:  second RTC6715 CS - D9, RSSI - A1
+ *              video switch      - D2
  *  BUTTONS:    T1-T4 - D4-D7
  *              (buttons pull to GND)
+ *  UART:       D0/D1 through the USB serial, 500000 baud 8N1,
+ *              telemetry protocol in telemetry.h
+ *  Trace:      D3 toggles on every traced event (TRACE_GPIO)
  */
 
 #include "pins.h"
 #include "rtos.h"
+#include "watchdog.h"
+#include "trace.h"
 
-int main(void) {
-    /*************** INIT ***************/
-    // GPIO
-    setGpioOutput(LED_BUILTIN);
-    setGpioLow(LED_BUILTIN);
+/* This function is used internally to bring the receiver up,
+ * from the pins to the init of every task, which sets up the
+ * OLED and the RX. The benchmark build (bench.c) measures it.
+ */
+void _boot(void) {
+    /* GPIO. D0/D1 belong to the telemetry UART and the LED
+     * of the Nano (D13) is the SPI clock of the RX, so there is
+     * no LED to drive.
+     */
+#if TRACE_GPIO
+    setGpioOutput(TRACE_PIN);
+#endif
+
+    /* Power down what isn't used: Timer2, the USART and the
+     * analog comparator. The ADC driver powers down Timer0 when
+     * it doesn't trigger the conversions, and the UART driver
+     * powers the USART up again for the telemetry.
+     */
+    PRR = (1 << PRTIM2) | (1 << PRUSART0);
+    ACSR = (1 << ACD);
 
     // RTOS
-    rtos_init(5000);
+    rtos_init(RTOS_SLICE_US);
+
+    /* The watchdog resets the receiver if the main loop stops
+     * coming back, it is restored onto the channel it was on
+     * (see init_rx_freq()). It starts only now, the init above
+     * blocks on the OLED, for longer than the timeout when the
+     * display is missing.
+     */
+    watchdog_init();
+}
+
+/* The benchmark build has its own main() in bench.c, the
+ * unit tests (test/) have theirs.
+ */
+#if !defined(BENCHMARK) && !defined(PIO_UNIT_TESTING)
+
+int main(void) {
+    /*************** INIT ***************/
+    _boot();
     rtos_enable();
 
     for (;;) {
-        // Not much to do here
+        watchdog_kick();
+        // Run the tasks that were released by the RTOS
+        if (rtos_dispatch()) continue;
+        // and sleep when there are none.
+        rtos_idle();
     }
 
     while (1); // Safety net
-}
\ No newline at end of file
+}
+
+#endif
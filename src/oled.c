@@ -1,152 +1,221 @@
 #include "oled.h"
-#include <avr/io.h>
-
-#define OLED_ADDRESS 0x3C
-
-/* (7) Clear TWI Interrupt Flag, (6) Enable Acknowledge bit,
- * (5) START, (4) STOP, (3) Write Collision Flag is RO, (2) Enable TWI
- * Bit 1 is reserved, (0) disable TWI Interrupt
- */
-#define TWCR_CONFIG 0b11000100
-
-// Mask for reading the TWI Status Register
-#define TWSR_TWS_MASK 0xF8
-
-/* These are the lookup tables for writing characters to the screen.
- * Each character is 6x8 pixels. The bit order is from the bottom to
- * the top and left to right. The digits are represented directly by
- * their table index. Only the necessary letters are included so their
- * position is not related to their ASCII value.
- */
-const uint8_t numbers_lookup[][6] = {
-    {0b00111100, 0b01010010, 0b01001010, 0b01000110, 0b00111100, 0},
-    {0b00000000, 0b01000100, 0b01111110, 0b01000000, 0b00000000, 0},
-    {0b01000100, 0b01100010, 0b01010010, 0b01001010, 0b01000100, 0},
-    {0b00100100, 0b01000010, 0b01001010, 0b01001010, 0b00110100, 0},
-    {0b00110000, 0b00101000, 0b00100100, 0b01111110, 0b00100000, 0},
-    {0b00101110, 0b01001010, 0b01001010, 0b01001010, 0b00110010, 0},
-    {0b00111100, 0b01001010, 0b01001010, 0b01001010, 0b00110010, 0},
-    {0b00000010, 0b00000010, 0b01110010, 0b00001010, 0b00000110, 0},
-    {0b00110100, 0b01001010, 0b01001010, 0b01001010, 0b00110100, 0},
-    {0b00100100, 0b01001010, 0b01001010, 0b01001010, 0b00111100, 0}
-};
+#include "i2c.h"
+#include "font.h"
+#include "trace.h"
 
-const uint8_t letters_lookup[][6] = {
-    {0b01111100, 0b00001010, 0b00001010, 0b00001010, 0b01111100, 0}, // A - 0
-    {0b01111110, 0b01001010, 0b01001010, 0b01001010, 0b00110100, 0}, // B - 1
-    {0b01111110, 0b01001010, 0b01001010, 0b01001010, 0b01000010, 0}, // E - 2
-    {0b01111110, 0b00001010, 0b00001010, 0b00001010, 0b00000010, 0}, // F - 3
-    {0b01111110, 0b00001000, 0b00001000, 0b00001000, 0b01111110, 0}, // H - 4
-    {0b00000000, 0b01000010, 0b01111110, 0b01000010, 0b00000000, 0}, // I - 5
-    {0b01111110, 0b00000100, 0b00001000, 0b00000100, 0b01111110, 0}, // M - 6
-    {0b01111110, 0b00001010, 0b00001010, 0b00001010, 0b01110100, 0}, // R - 7
-    {0b01000100, 0b01001010, 0b01001010, 0b01001010, 0b00110010, 0}, // S - 8
-    {0b01000100, 0b01100100, 0b01010100, 0b01001100, 0b01000100, 0}  // z - 9
-};
+/* The glyphs come from the font in program memory, see font.h.
+ * The glyph index of a character is its code minus FONT_FIRST,
+ * so strings are plain ASCII with the symbols above 0x7F.
+ */
 
-const uint8_t symbols_lookup[][6] = {
-    {0b00000000, 0b00000000, 0b00011000, 0b00011000, 0b00000000, 0}, // small dot   - 0
-    {0b00000000, 0b00111100, 0b00111100, 0b00111100, 0b00111100, 0}, // large dot   - 1
-    {0b00001000, 0b00011100, 0b00101010, 0b00001000, 0b00001000, 8}, // left arrow  - 2
-    {0b00001000, 0b00001000, 0b00001000, 0b00101010, 0b00011100, 8}, // right arrow - 3
-    {0b00001000, 0b00000100, 0b01111110, 0b00000100, 0b00001000, 0}, // up arrow    - 4
-    {0b00010000, 0b00100000, 0b01111110, 0b00100000, 0b00010000, 0}  // down arrow  - 5
-};
+/* This is the shadow copy of the screen contents. Instead of
+ * keeping a full framebuffer, only the glyph index of every
+ * tile is stored, along with one bit per tile for inversion and
+ * one bit per tile that marks it as changed since the last flush.
+ */
+uint8_t oled_tiles[OLED_TILE_ROWS][OLED_TILE_COLS];
+uint8_t oled_tiles_invert[OLED_TILE_ROWS][(OLED_TILE_COLS + 7) / 8];
+uint8_t oled_tiles_dirty[OLED_TILE_ROWS][(OLED_TILE_COLS + 7) / 8];
 
+// Rows that are drawn without the tile map, one bit per row
+uint8_t oled_tiles_reserved = 0;
 
-/* This function is used internaly to wait for the I2C interface
- * to stop transmitting, and check whether it was successful.
- * To prevent blocking for too long a timeout is added. A return
- * value of 0 means success, other values indicate an error.
+/* Starting a new addressed run costs more bytes on the bus than
+ * resending a couple of unchanged tiles, so runs of dirty tiles
+ * separated by at most this many clean tiles are merged.
  */
-uint8_t _wait_TWCR(uint8_t cr_bit, uint8_t sr_value, uint8_t negate) {
-    int timeout = 4000;
-    while ((TWCR & (1 << cr_bit)) ? !negate : negate) {
-        if (!(timeout--)) return 1; 
-    }
-    if (!((TWSR & TWSR_TWS_MASK) == sr_value)) return 2;
-    return 0;
-}
+#define OLED_FLUSH_MAX_GAP 2
+
+/* The longest run that is sent at once. A queued run has to fit
+ * into the I2C buffer together with the 13 bytes of addressing.
+ */
+#define OLED_FLUSH_MAX_RUN ((I2C_BUFFER_LEN - 13) / OLED_TILE_WIDTH)
+
+// Status of the first queued write that failed, 0 if none
+volatile uint8_t oled_async_status = 0;
 
 /* This function is used internally to send a single command to
  * the OLED controller. A return value of 0 means success, other
  * values indicate an error.
  */
 uint8_t _send_command(uint8_t command) {
-    TWDR = 0b10000000;     // Indicate next byte will be a command
-    TWCR = TWCR_CONFIG; // Clears the interrupt flag and starts the transmission
+    if(i2c_write(0b10000000)) return 1; // Indicate next byte will be a command
+    if(i2c_write(command)) return 2;    // Send the command
 
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 1;
+    return 0;
+}
+
+/* This function is used internally to get the glyph index
+ * of a character. Characters outside of the font are shown
+ * as a question mark.
+ */
+uint8_t _glyph_of(char c) {
+    uint8_t index = (uint8_t)c - FONT_FIRST;
+    if (index >= FONT_GLYPHS) return OLED_GLYPH('?');
+    return index;
+}
 
-    TWDR = command;        // Load the command
-    TWCR = TWCR_CONFIG; // Clears the interrupt flag and starts the transmission
+/* This function is used internally to convert n to len decimal
+ * digits, most significant first, without dividing. It uses the
+ * shift and add 3 (double dabble) algorithm on packed BCD: before
+ * every shift, each BCD digit of 5 or more gets 3 added, so it
+ * carries into the next digit when it is doubled. Only the BCD
+ * bytes for len digits are kept, which gives n modulo 10^len.
+ * AVR has no divider, so this is much cheaper than a 32-bit
+ * division per digit.
+ */
+void _num_to_digits(uint32_t n, uint8_t len, uint8_t *digits) {
+    uint8_t bcd[OLED_NUM_MAX_LEN / 2] = {0};
+    uint8_t bytes = (len + 1) >> 1;
+    uint8_t bits = 32;
+
+    // Skip the leading zeroes, whole bytes first
+    while (bits > 8 && !(n >> 24)) {
+        n <<= 8;
+        bits -= 8;
+    }
+    while (bits > 0 && !(n & 0x80000000UL)) {
+        n <<= 1;
+        bits--;
+    }
+
+    while (bits-- > 0) {
+        uint8_t carry = (n & 0x80000000UL) ? 1 : 0;
+        n <<= 1;
+        for (uint8_t i = 0; i < bytes; i++) {
+            uint8_t b = bcd[i];
+            if ((b & 0x0F) >= 0x05) b += 0x03;
+            if (b >= 0x50) b += 0x30;
+            bcd[i] = (b << 1) | carry;
+            carry = b >> 7;
+        }
+    }
 
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 2;
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t b = bcd[i >> 1];
+        digits[len - 1 - i] = (i & 1) ? b >> 4 : b & 0x0F;
+    }
+}
 
+/* This function is used internally to send the data of a
+ * single glyph. The transfer must already be in data mode.
+ */
+uint8_t _write_glyph(uint8_t index, uint8_t invert) {
+    const uint8_t *glyph = font_glyphs[index];
+    invert = invert ? 0xFF : 0;
+    for (uint8_t j = 0; j < FONT_WIDTH; j++) {
+        if(i2c_write(pgm_read_byte(&glyph[j]) ^ invert)) return 1;
+    }
     return 0;
 }
 
-/* This function is used to begin an I2C transaction.
- * It sends a START condition, waits for an ACK, then it sends
- * the device address and waits for another ACK. A return value
- * of 0 means success, other values indicate an error.
+/* The configuration sent to the display at startup,
+ * as a single stream of commands.
  */
-uint8_t i2c_start(void) {
-    TWCR = TWCR_CONFIG | (1 << TWSTA);  // Send START
-    
-    if(_wait_TWCR(TWINT, 0x08, 1)) return 1;
+const uint8_t oled_init_commands[] = {
+    0xAE,       // Display OFF while configuring
+    0xD9, 0xF1, // Set Pre-charge Period: Phase 2: 15 DCLK, Phase 1: 1 DCLK
+    0x8D, 0x14, // Set Charge Pump: Enabled
+    0xDB, 0x40, // Set VCOMH Deselect Level: 0.89*Vcc
+    0xA1,       // Flip horizontally
+    0xC8,       // Flip vertically
+    0xA4,       // Use data from RAM
+    0x20, 0x01  // Set Memory Addressing Mode: Vertical
+};
 
-    TWDR = (OLED_ADDRESS << 1);  // Send address
-    TWCR = TWCR_CONFIG;
+/* This function initializes the I2C (2-wire) interface and
+ * configures the OLED display. The display is left turned off,
+ * so the old contents of its RAM aren't shown. It is turned on
+ * with oled_display_on(), usually after clearing the screen.
+ */
+uint8_t oled_init() {
+    // I2C
+    i2c_init();
 
-    if(_wait_TWCR(TWINT, 0x18, 1)) return 2;
+    if (oled_command_begin()) return 1;
+    if (oled_stream(oled_init_commands, sizeof(oled_init_commands))) return 2;
+    oled_end();
 
     return 0;
 }
 
-/* This function is used to end an I2C transaction.
- * It sends a STOP condition. There is no ACK for the STOP
- * condition, so the function simply waits for the interface
- * to finish transmitting and then it returns.
+/* This function turns the display on.
  */
-void i2c_stop(void) {
-    TWCR = TWCR_CONFIG | (1 << TWSTO);  // Send STOP
+uint8_t oled_display_on(void) {
+    if (oled_command_begin()) return 1;
+    if (i2c_write(0xAF)) return 2;
+    oled_end();
 
-    _wait_TWCR(TWSTO, 0, 0);    // We don't care about the return value
+    return 0;
 }
 
-/* This function initializes the I2C (2-wire) interface and
- * configures the OLED display.
+/* These functions begin a streaming transaction. After a command
+ * stream is opened, every byte is interpreted as a command or a
+ * command parameter. After a data stream is opened, every byte is
+ * written to the display RAM at the current position. Any number
+ * of bytes can be sent with oled_stream() and oled_stream_fill(),
+ * and the transaction is closed with oled_end().
  */
-uint8_t oled_init() {
-    // I2C
-    TWBR = 16;          // Bit rate register, target is ~100 kHz
-    TWSR = 0;           // Set prescaler to 1
-    
-    if (i2c_start()) return 1;
+uint8_t oled_command_begin(void) {
+    if (i2c_start(OLED_ADDRESS)) return 1;
+    if (i2c_write(0b00000000)) return 2;    // Co = 0, D/C = 0
+    return 0;
+}
+
+uint8_t oled_data_begin(void) {
+    if (i2c_start(OLED_ADDRESS)) return 1;
+    if (i2c_write(0b01000000)) return 2;    // Co = 0, D/C = 1
+    return 0;
+}
+
+uint8_t oled_stream(const uint8_t *data, uint16_t len) {
+    while (len--) {
+        if (i2c_write(*data++)) return 1;
+    }
+    return 0;
+}
 
-    if(_send_command(0xD9)) return 2; // Set Pre-charge Period
-    if(_send_command(0xF1)) return 2; // -Phase 2: 15 DCLK, Phase 1: 1 DCLK
+uint8_t oled_stream_fill(uint8_t value, uint16_t len) {
+    while (len--) {
+        if (i2c_write(value)) return 1;
+    }
+    return 0;
+}
 
-    if(_send_command(0x8D)) return 2; // Set Charge Pump
-    if(_send_command(0x14)) return 2; // -Enabled
-    
-    if(_send_command(0xDB)) return 2; // Set VCOMH Deselect Level
-    if(_send_command(0x40)) return 2; // -0.89*Vcc
+void oled_end(void) {
+    i2c_stop();
+}
 
-    if(_send_command(0xA1)) return 2; // Flip horizontally
-    if(_send_command(0xC8)) return 2; // Flip vertically
+/* This function sets the column and page window. The display
+ * uses vertical addressing, so data written afterwards fills the
+ * window column by column, every column from the top page down.
+ * In a window of a single page that is simply left to right.
+ */
+uint8_t oled_set_window(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1) {
+    uint8_t commands[] = {0x21, x0, x1, 0x22, page0, page1};
 
-    if(_send_command(0xAF)) return 2; // Display ON
-    if(_send_command(0xA4)) return 2; // Use data from RAM
+    if (oled_command_begin()) return 1;
+    if (oled_stream(commands, sizeof(commands))) return 2;
+    oled_end();
 
-    if(_send_command(0x20)) return 2; // Set Memory Addressing Mode
-    if(_send_command(0x00)) return 2; // -Horizontal
+    return 0;
+}
 
-    i2c_stop();
+/* This function fills a rectangular region of the display with
+ * the same byte. The region is given as a column and page window.
+ */
+uint8_t oled_fill_region(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1, uint8_t value) {
+    if (oled_set_window(x0, x1, page0, page1)) return 1;
+
+    if (oled_data_begin()) return 2;
+    if (oled_stream_fill(value, (uint16_t)(x1 - x0 + 1) * (page1 - page0 + 1))) return 3;
+    oled_end();
 
     return 0;
+}
 
+uint8_t oled_clear_region(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1) {
+    return oled_fill_region(x0, x1, page0, page1, 0);
 }
 
 /* This function is used to send a singe byte of display data
@@ -156,23 +225,17 @@ uint8_t oled_init() {
  * START and STOP commands to be sent seperately.
  */
 uint8_t oled_raw_write(uint8_t data) {
-    TWDR = 0b11000000;
-    TWCR = TWCR_CONFIG;
-
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 1;
-
-    TWDR = data;
-    TWCR = TWCR_CONFIG;
-    
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 2;
+    if(i2c_write(0b11000000)) return 1;
+    if(i2c_write(data)) return 2;
 
     return 0;
 }
 
 /* This function sets the position at which new data will
  * be written. X can go up to 127 and y can go up to 7.
- * Both "oled_raw" functions require the START and STOP 
- * commands to be sent seperately.
+ * The window ends at the same page, so the data goes from
+ * left to right. Both "oled_raw" functions require the
+ * START and STOP commands to be sent seperately.
  */
 uint8_t oled_raw_set_position(uint8_t x, uint8_t y) {
     if(_send_command(0x21)) return 2; // Set column address
@@ -180,44 +243,49 @@ uint8_t oled_raw_set_position(uint8_t x, uint8_t y) {
     if(_send_command(0xff)) return 2; // End at 127
     if(_send_command(0x22)) return 2; // Set page address
     if(_send_command(y)) return 2; // Start at y
-    if(_send_command(0x07)) return 2; // End at 7
+    if(_send_command(y)) return 2; // End at y
     return 0;
 }
 
 /* This function writes a fixed length number to the display
  * at the specified coordinates. The number is converted to
- * decimal and padded with zeroes to fit the specified length.
+ * decimal and padded with zeroes to fit the specified length,
+ * which can be up to OLED_NUM_MAX_LEN. Digits that don't fit
+ * are cut off.
  */
 uint8_t oled_write_num_fixed(uint32_t n, uint8_t len, uint8_t x, uint8_t y, uint8_t invert) {
-    if (i2c_start()) return 1;
+    uint8_t digits[OLED_NUM_MAX_LEN];
+    if (len > OLED_NUM_MAX_LEN) len = OLED_NUM_MAX_LEN;
+    _num_to_digits(n, len, digits);
 
-    if (oled_raw_set_position(x, y)) return 2;
+    if (i2c_start(OLED_ADDRESS)) return 1;
 
-    TWDR = 0b01000000;
-    TWCR = TWCR_CONFIG;
+    if (oled_raw_set_position(x, y)) return 2;
 
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 3;
+    if(i2c_write(0b01000000)) return 3;
 
-    uint32_t dec = 1;
-    while (--len > 0) {
-        dec *= 10;
+    for (uint8_t i = 0; i < len; i++) {
+        if (_write_glyph(OLED_GLYPH_DIGIT + digits[i], invert)) return 4;
     }
 
-    int i = 0;
-    while (dec > 0) {
-        int digit = n / dec;
-        if (digit < 0) digit = 0;
-        if (digit > 9) digit = 9;
-        for (int j = 0; j < 6; j++) {
-            TWDR = invert ? ~numbers_lookup[digit][j] : numbers_lookup[digit][j];
-            TWCR = TWCR_CONFIG;
-            
-            if(_wait_TWCR(TWINT, 0x28, 1)) return 4;
-        }
+    i2c_stop();
 
-        n = n % dec;
-        dec /= 10;
-        i++;
+    return 0;
+}
+
+/* This function writes a string to the display at the
+ * specified coordinates. The string is ASCII, with the
+ * symbols (OLED_SMALL_DOT, ...) above 0x7F.
+ */
+uint8_t oled_write_text(const char *text, uint8_t x, uint8_t y, uint8_t invert) {
+    if (i2c_start(OLED_ADDRESS)) return 1;
+
+    if (oled_raw_set_position(x, y)) return 2;
+
+    if(i2c_write(0b01000000)) return 3;
+
+    for (uint8_t i = 0; text[i] != 0; i++) {
+        if (_write_glyph(_glyph_of(text[i]), invert)) return 4;
     }
 
     i2c_stop();
@@ -225,66 +293,373 @@ uint8_t oled_write_num_fixed(uint32_t n, uint8_t len, uint8_t x, uint8_t y, uint
     return 0;
 }
 
-/* This function writes a string of characters to the display
- * at the specified coordinates. The only valid characters in 
- * the input string are numeric and each digit represents 
- * a character in the lookup table.
+/* This function clears the whole display RAM and resets the
+ * tile map to blank tiles. Since the panel is cleared as well,
+ * no tiles are marked as dirty.
  */
-uint8_t oled_write_text(char *text, uint8_t x, uint8_t y, uint8_t invert) {
-    if (i2c_start()) return 1;
+uint8_t oled_clear(void) {
+    if (oled_clear_region(0, 127, 0, 7)) return 1;
 
-    if (oled_raw_set_position(x, y)) return 2;
+    for (uint8_t row = 0; row < OLED_TILE_ROWS; row++) {
+        for (uint8_t col = 0; col < OLED_TILE_COLS; col++) {
+            oled_tiles[row][col] = OLED_GLYPH_BLANK;
+        }
+        for (uint8_t i = 0; i < (OLED_TILE_COLS + 7) / 8; i++) {
+            oled_tiles_invert[row][i] = 0;
+            oled_tiles_dirty[row][i] = 0;
+        }
+    }
+
+    return 0;
+}
+
+/* This function sets a single tile of the tile map. The tile is
+ * only marked as dirty if its contents actually change, so it is
+ * fine to call it with the same value over and over again.
+ */
+void oled_tile_set(uint8_t col, uint8_t row, uint8_t glyph, uint8_t invert) {
+    if (col >= OLED_TILE_COLS || row >= OLED_TILE_ROWS) return;
+
+    uint8_t mask = 1 << (col & 7);
+    uint8_t *inv = &oled_tiles_invert[row][col >> 3];
+    uint8_t old_invert = (*inv & mask) ? 1 : 0;
+    invert = invert ? 1 : 0;
 
-    TWDR = 0b01000000;
-    TWCR = TWCR_CONFIG;
+    if (oled_tiles[row][col] == glyph && old_invert == invert) return;
 
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 3;
+    oled_tiles[row][col] = glyph;
+    if (invert) *inv |= mask;
+    else *inv &= ~mask;
+    oled_tiles_dirty[row][col >> 3] |= mask;
+}
+
+/* This function marks every tile as dirty, so the next flush
+ * redraws the whole tile area of the screen.
+ */
+void oled_tile_invalidate(void) {
+    for (uint8_t row = 0; row < OLED_TILE_ROWS; row++) {
+        for (uint8_t i = 0; i < (OLED_TILE_COLS + 7) / 8; i++) {
+            oled_tiles_dirty[row][i] = 0xFF;
+        }
+    }
+}
 
-    for (int i = 0; text[i] != 0; i++) {
-        int letter = text[i] - '0';
-        if (letter < 0) letter = 0;
-        if (letter > 9) letter = 9;
-        for (int j = 0; j < 6; j++) {
-            TWDR = invert ? ~letters_lookup[letter][j] : letters_lookup[letter][j];
-            TWCR = TWCR_CONFIG;
-            
-            if(_wait_TWCR(TWINT, 0x28, 1)) return 4;
+/* This function selects the rows that are drawn without the
+ * tile map, one bit per row. The flush skips them, but the tile
+ * map still keeps track of their contents. The rows that are
+ * no longer reserved are marked as dirty, so the tile map is
+ * drawn over whatever was drawn there instead.
+ */
+void oled_tile_reserve(uint8_t rows) {
+    uint8_t released = oled_tiles_reserved & ~rows;
+    oled_tiles_reserved = rows;
+
+    for (uint8_t row = 0; row < OLED_TILE_ROWS; row++) {
+        if (!(released & (1 << row))) continue;
+        for (uint8_t i = 0; i < (OLED_TILE_COLS + 7) / 8; i++) {
+            oled_tiles_dirty[row][i] = 0xFF;
         }
     }
+}
+
+/* This function writes a fixed length number into the tile map,
+ * the same way oled_write_num_fixed() writes it to the display.
+ */
+void oled_tile_num_fixed(uint32_t n, uint8_t len, uint8_t col, uint8_t row, uint8_t invert) {
+    uint8_t digits[OLED_NUM_MAX_LEN];
+    if (len > OLED_NUM_MAX_LEN) len = OLED_NUM_MAX_LEN;
+    _num_to_digits(n, len, digits);
+
+    for (uint8_t i = 0; i < len; i++) {
+        oled_tile_set(col + i, row, OLED_GLYPH_DIGIT + digits[i], invert);
+    }
+}
+
+/* This function writes a string into the tile map. The
+ * string uses the same encoding as oled_write_text().
+ */
+void oled_tile_text(const char *text, uint8_t col, uint8_t row, uint8_t invert) {
+    for (uint8_t i = 0; text[i] != 0; i++) {
+        oled_tile_set(col + i, row, _glyph_of(text[i]), invert);
+    }
+}
+
+/* This function is the same as oled_tile_text(), but the
+ * string is in program memory, for example PSTR("MHz").
+ */
+void oled_tile_text_P(PGM_P text, uint8_t col, uint8_t row, uint8_t invert) {
+    char c;
+    for (uint8_t i = 0; (c = pgm_read_byte(&text[i])) != 0; i++) {
+        oled_tile_set(col + i, row, _glyph_of(c), invert);
+    }
+}
+
+/* This function fills len tiles starting at the given tile
+ * with the same glyph.
+ */
+void oled_tile_fill(uint8_t glyph, uint8_t len, uint8_t col, uint8_t row, uint8_t invert) {
+    while (len-- > 0) {
+        oled_tile_set(col++, row, glyph, invert);
+    }
+}
+
+/* This function is used internally to check the dirty bit of a tile.
+ */
+uint8_t _tile_dirty(uint8_t col, uint8_t row) {
+    return oled_tiles_dirty[row][col >> 3] & (1 << (col & 7));
+}
+
+/* This function is used internally to send one run of tiles on a
+ * single page. The column and page window is set to exactly the run,
+ * so the data can be streamed without any further addressing.
+ */
+uint8_t _flush_run(uint8_t first, uint8_t last, uint8_t row) {
+    uint8_t x = OLED_TILE_X0 + first * OLED_TILE_WIDTH;
+
+    if (i2c_start(OLED_ADDRESS)) return 1;
+
+    if(_send_command(0x21)) return 2; // Set column address
+    if(_send_command(x)) return 2; // Start of the run
+    if(_send_command(x + (last - first + 1) * OLED_TILE_WIDTH - 1)) return 2; // End of the run
+    if(_send_command(0x22)) return 2; // Set page address
+    if(_send_command(row)) return 2; // Start at the row
+    if(_send_command(row)) return 2; // End at the row
+
+    if(i2c_write(0b01000000)) return 3;
+
+    for (uint8_t col = first; col <= last; col++) {
+        if (_write_glyph(oled_tiles[row][col], oled_tiles_invert[row][col >> 3] & (1 << (col & 7)))) return 4;
+    }
 
     i2c_stop();
 
+    // Only clear the dirty bits once the run was sent successfully.
+    for (uint8_t col = first; col <= last; col++) {
+        oled_tiles_dirty[row][col >> 3] &= ~(1 << (col & 7));
+    }
+
     return 0;
 }
 
-/* This function writes a string of symbols to the display
- * at the specified coordinates. The only valid characters in 
- * the input string are numeric 0-5 and each digit represents 
- * a symbol in the lookup table.
+/* This function is used internally to find the end of the run
+ * starting at the dirty tile col. Short gaps of clean tiles are
+ * included, and the run is limited so it fits the I2C buffer.
  */
-uint8_t oled_write_symbol(char *symbols, uint8_t x, uint8_t y, uint8_t invert) {
-    if (i2c_start()) return 1;
+uint8_t _find_run(uint8_t col, uint8_t row) {
+    uint8_t last = col;
+    for (uint8_t c = col + 1; c < OLED_TILE_COLS && c - last <= OLED_FLUSH_MAX_GAP + 1; c++) {
+        if (c - col >= OLED_FLUSH_MAX_RUN) break;
+        if (_tile_dirty(c, row)) last = c;
+    }
+    return last;
+}
 
-    if (oled_raw_set_position(x, y)) return 2;
+/* This function sends all tiles that changed since the last flush
+ * to the display. Neighbouring dirty tiles on a page are combined
+ * into a single addressed run. A return value of 0 means success,
+ * other values indicate an error, in which case the tiles that
+ * were not sent stay dirty.
+ */
+uint8_t oled_flush(void) {
+    for (uint8_t row = 0; row < OLED_TILE_ROWS; row++) {
+        if (oled_tiles_reserved & (1 << row)) continue;
+        uint8_t col = 0;
+        while (col < OLED_TILE_COLS) {
+            if (!_tile_dirty(col, row)) {
+                col++;
+                continue;
+            }
+
+            uint8_t last = _find_run(col, row);
+            uint8_t error = _flush_run(col, last, row);
+            if (error) return error;
+
+            col = last + 1;
+        }
+    }
+    return 0;
+}
 
-    TWDR = 0b01000000;
-    TWCR = TWCR_CONFIG;
+/* This is the completion callback for all queued display
+ * writes. It runs in interrupt context and only remembers
+ * the error, which is picked up by oled_async_error(). Once
+ * the queue is empty, the screen shows what was drawn.
+ */
+void _async_done(uint8_t status) {
+    if (status != I2C_OK) oled_async_status = status;
+    if (!i2c_busy()) trace_event(TRACE_OLED_DONE, status);
+}
 
-    if(_wait_TWCR(TWINT, 0x28, 1)) return 3;
+/* This function returns the status of the first queued write
+ * that failed since it was last called, or 0 if there were none.
+ */
+uint8_t oled_async_error(void) {
+    uint8_t status = oled_async_status;
+    oled_async_status = 0;
+    return status;
+}
 
-    for (int i = 0; symbols[i] != 0; i++) {
-        int symbol = symbols[i] - '0';
-        if (symbol < 0) symbol = 0;
-        if (symbol > 9) symbol = 5;
-        for (int j = 0; j < 6; j++) {
-            TWDR = invert ? ~symbols_lookup[symbol][j] : symbols_lookup[symbol][j];
-            TWCR = TWCR_CONFIG;
-            
-            if(_wait_TWCR(TWINT, 0x28, 1)) return 4;
-        }
+/* This function is used internally to queue the commands that
+ * set the column and page window, followed by the control byte
+ * that starts the display data.
+ */
+void _queue_window(uint8_t x0, uint8_t x1, uint8_t y0, uint8_t y1) {
+    uint8_t commands[] = {0x21, x0, x1, 0x22, y0, y1};
+    for (uint8_t i = 0; i < sizeof(commands); i++) {
+        i2c_queue_put(0b10000000);
+        i2c_queue_put(commands[i]);
     }
+    i2c_queue_put(0b01000000);
+}
 
-    i2c_stop();
+/* This function is used internally to queue the data
+ * of a single glyph.
+ */
+void _queue_glyph(uint8_t index, uint8_t invert) {
+    const uint8_t *glyph = font_glyphs[index];
+    invert = invert ? 0xFF : 0;
+    for (uint8_t j = 0; j < FONT_WIDTH; j++) {
+        i2c_queue_put(pgm_read_byte(&glyph[j]) ^ invert);
+    }
+}
+
+/* This function queues the same configuration as oled_init()
+ * and turns the display on.
+ * The I2C interface must already be initialized. A return value
+ * of 0 means success, 1 means the queue was full.
+ */
+uint8_t oled_init_async(void) {
+    if (i2c_queue_begin(OLED_ADDRESS, _async_done)) return 1;
+    i2c_queue_put(0b00000000);
+    for (uint8_t i = 0; i < sizeof(oled_init_commands); i++) {
+        i2c_queue_put(oled_init_commands[i]);
+    }
+    i2c_queue_put(0xAF);    // Display ON
+    return i2c_queue_commit();
+}
+
+/* These functions are the queued versions of the oled_write
+ * functions. They return immediately, the data is sent by the
+ * I2C engine in the background. A return value of 0 means
+ * success, 1 means the queue was full and nothing was written.
+ */
+uint8_t oled_write_num_fixed_async(uint32_t n, uint8_t len, uint8_t x, uint8_t y, uint8_t invert) {
+    uint8_t digits[OLED_NUM_MAX_LEN];
+    if (len > OLED_NUM_MAX_LEN) len = OLED_NUM_MAX_LEN;
+    _num_to_digits(n, len, digits);
+
+    if (i2c_queue_begin(OLED_ADDRESS, _async_done)) return 1;
+    _queue_window(x, x + 6*len - 1, y, y);
+    for (uint8_t i = 0; i < len; i++) {
+        _queue_glyph(OLED_GLYPH_DIGIT + digits[i], invert);
+    }
+    return i2c_queue_commit();
+}
 
+uint8_t oled_write_text_async(const char *text, uint8_t x, uint8_t y, uint8_t invert) {
+    uint8_t len = 0;
+    while (text[len] != 0) len++;
+
+    if (i2c_queue_begin(OLED_ADDRESS, _async_done)) return 1;
+    _queue_window(x, x + 6*len - 1, y, y);
+    for (uint8_t i = 0; i < len; i++) {
+        _queue_glyph(_glyph_of(text[i]), invert);
+    }
+    return i2c_queue_commit();
+}
+
+/* This function is the queued version of oled_fill_region().
+ * The region must fit into the I2C buffer together with the
+ * 13 bytes of addressing. A return value of 0 means success,
+ * 1 means the queue was full and nothing was written.
+ */
+uint8_t oled_fill_region_async(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1, uint8_t value) {
+    uint8_t len = (x1 - x0 + 1) * (page1 - page0 + 1);
+    if (i2c_queue_free() < 13 + len) return 1;
+
+    if (i2c_queue_begin(OLED_ADDRESS, _async_done)) return 1;
+    _queue_window(x0, x1, page0, page1);
+    for (uint8_t i = 0; i < len; i++) i2c_queue_put(value);
+    return i2c_queue_commit();
+}
+
+/* This function is used internally to get the byte of a bar
+ * that is height pixels high and stands on the bottom of a
+ * column of pages pages, on the page-th page from the top.
+ */
+uint8_t _bar_byte(uint8_t height, uint8_t page, uint8_t pages) {
+    int8_t empty = pages * 8 - height - page * 8;
+    if (empty <= 0) return 0xFF;
+    if (empty >= 8) return 0;
+    return 0xFF << empty;
+}
+
+/* This function queues a vertical bar that fills the columns
+ * x0 to x1 from the bottom of page1 up to height pixels, up to
+ * the top of page0 at most. It is drawn over a bar that was
+ * old_height high, and only the pages that differ between the
+ * two are sent, 0xFF as old_height sends them all. The display
+ * uses vertical addressing, so the data is queued column by
+ * column, without any glyphs or further addressing. A return
+ * value of 0 means success (or nothing to send), 1 means the
+ * queue was full and nothing was written.
+ */
+uint8_t oled_bar_async(uint8_t x0, uint8_t x1, uint8_t page0, uint8_t page1, uint8_t height, uint8_t old_height) {
+    uint8_t pages = page1 - page0 + 1;
+    uint8_t first = 0;
+    uint8_t last = pages - 1;
+    if (old_height != 0xFF) {
+        while (first < pages && _bar_byte(height, first, pages) == _bar_byte(old_height, first, pages)) first++;
+        if (first == pages) return 0;
+        while (_bar_byte(height, last, pages) == _bar_byte(old_height, last, pages)) last--;
+    }
+
+    uint8_t len = (x1 - x0 + 1) * (last - first + 1);
+    if (i2c_queue_free() < 13 + len) return 1;
+
+    if (i2c_queue_begin(OLED_ADDRESS, _async_done)) return 1;
+    _queue_window(x0, x1, page0 + first, page0 + last);
+    for (uint8_t x = x0; x <= x1; x++) {
+        for (uint8_t page = first; page <= last; page++) {
+            i2c_queue_put(_bar_byte(height, page, pages));
+        }
+    }
+    return i2c_queue_commit();
+}
+
+/* This function is the queued version of oled_flush(). Runs are
+ * only queued while they fit into the I2C buffer, the remaining
+ * tiles stay dirty for the next call. A run's dirty bits are
+ * cleared when it is queued. A return value of 0 means all dirty
+ * tiles were queued, 1 means some are left for later.
+ */
+uint8_t oled_flush_async(void) {
+    for (uint8_t row = 0; row < OLED_TILE_ROWS; row++) {
+        if (oled_tiles_reserved & (1 << row)) continue;
+        uint8_t col = 0;
+        while (col < OLED_TILE_COLS) {
+            if (!_tile_dirty(col, row)) {
+                col++;
+                continue;
+            }
+
+            uint8_t last = _find_run(col, row);
+            uint8_t count = last - col + 1;
+
+            // Window commands, data control byte and the tiles
+            if (i2c_queue_free() < 13 + count * OLED_TILE_WIDTH) return 1;
+
+            uint8_t x = OLED_TILE_X0 + col * OLED_TILE_WIDTH;
+            if (i2c_queue_begin(OLED_ADDRESS, _async_done)) return 1;
+            _queue_window(x, x + count * OLED_TILE_WIDTH - 1, row, row);
+            for (uint8_t c = col; c <= last; c++) {
+                _queue_glyph(oled_tiles[row][c], oled_tiles_invert[row][c >> 3] & (1 << (c & 7)));
+                oled_tiles_dirty[row][c >> 3] &= ~(1 << (c & 7));
+            }
+            if (i2c_queue_commit()) return 1;
+
+            col = last + 1;
+        }
+    }
     return 0;
 }
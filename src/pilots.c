@@ -0,0 +1,212 @@
+#include "pilots.h"
+#include "channels.h"
+#include "scan.h"
+#include "video_rx.h"
+#include "rtos.h"
+
+// The pilots start on Raceband (band R of channels.h)
+#define PILOTS_DEFAULT_BAND 4
+
+/* The channel of every slot, in the order they are shown,
+ * and the slots that have one in the order they are visited.
+ */
+uint8_t pilots_channels[PILOTS_MAX] = {
+    CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 0), CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 1),
+    CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 2), CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 3),
+    CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 4), CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 5),
+    CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 6), CHANNEL_INDEX(PILOTS_DEFAULT_BAND, 7)
+};
+uint8_t pilots_order[PILOTS_MAX];
+uint8_t pilots_count = 0;
+
+uint8_t pilots_active = 0;
+
+uint8_t pilots_position;        // Position in the order that is settling
+uint16_t pilots_tuned_freq;     // Where the receiver is, 0 if not known
+uint32_t pilots_hop_us;         // When it was tuned
+uint16_t pilots_settle_us;      // How long it needs to settle
+
+/* The filtered RSSI of every slot, with n more bits, and one
+ * bit per slot that was measured and that is lost.
+ */
+uint16_t pilots_filtered[PILOTS_MAX];
+uint8_t pilots_measured = 0;
+uint8_t pilots_lost_slots = 0xFF;
+
+// When the current round through all pilots started, and how long the last one took
+uint16_t pilots_cycle_start;
+uint16_t pilots_cycle_time = 0;
+
+
+/* This function is used internally to put the slots with
+ * a channel into the order they are visited in.
+ */
+void _pilots_plan(void) {
+    uint8_t sorted[PILOTS_MAX];
+    uint8_t count = 0;
+
+    // Insertion sort by frequency
+    for (uint8_t slot = 0; slot < PILOTS_MAX; slot++) {
+        if (pilots_channels[slot] == PILOTS_NONE) continue;
+        uint16_t freq = channel_freq(pilots_channels[slot]);
+        uint8_t i = count++;
+        while (i > 0 && channel_freq(pilots_channels[sorted[i - 1]]) > freq) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+        sorted[i] = slot;
+    }
+
+    // Up through the even ones, down through the odd ones
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < count; i += 2) pilots_order[n++] = sorted[i];
+    for (uint8_t i = count - 1 - (count & 1); i < count; i -= 2) pilots_order[n++] = sorted[i];
+    pilots_count = count;
+}
+
+/* This function is used internally to tune the receiver to
+ * the channel of a slot and calculate its settle time.
+ */
+void _pilots_hop(uint8_t slot) {
+    uint8_t index = pilots_channels[slot];
+    uint16_t freq = channel_freq(index) & ~1;
+    uint16_t jump = freq > pilots_tuned_freq ? freq - pilots_tuned_freq : pilots_tuned_freq - freq;
+
+    pilots_hop_us = rtos_get_time_us();
+    // Pilots on the same frequency share the reading.
+    if (jump == 0) {
+        pilots_settle_us = 0;
+        return;
+    }
+
+    uint32_t settle_us = SCAN_SETTLE_BASE_US + (uint32_t)jump * SCAN_SETTLE_PER_MHZ_US;
+    if (settle_us > SCAN_SETTLE_MAX_US) settle_us = SCAN_SETTLE_MAX_US;
+
+    // The word of an odd channel is for 1 MHz steps, it needs the A write.
+    if (freq == channel_freq(index)) video_rx_set_word(channel_word(index), freq);
+    else video_rx_set_frequency(freq);
+    pilots_tuned_freq = freq;
+    pilots_settle_us = settle_us;
+}
+
+/* This function is used internally to add a reading to the
+ * filtered RSSI of a slot and update its lost flag.
+ */
+void _pilots_measure(uint8_t slot, uint8_t rssi) {
+    uint8_t mask = 1 << slot;
+    if (!(pilots_measured & mask)) {
+        pilots_filtered[slot] = (uint16_t)rssi << PILOTS_FILTER_SHIFT;
+        pilots_measured |= mask;
+    } else {
+        pilots_filtered[slot] += rssi - (pilots_filtered[slot] >> PILOTS_FILTER_SHIFT);
+    }
+
+    uint8_t level = pilots_filtered[slot] >> PILOTS_FILTER_SHIFT;
+    if (level < PILOTS_LOST_RSSI) pilots_lost_slots |= mask;
+    else if (level >= PILOTS_LOST_RSSI + PILOTS_LOST_HYSTERESIS) pilots_lost_slots &= ~mask;
+}
+
+/* This function is used internally to start a new round
+ * from the first pilot of the order.
+ */
+void _pilots_restart(void) {
+    pilots_position = 0;
+    pilots_cycle_start = rtos_get_time_ms();
+    if (pilots_count) _pilots_hop(pilots_order[0]);
+}
+
+/* This function sets the channel of a slot, PILOTS_NONE
+ * leaves it empty. The readings of the slot start over. It
+ * returns 1 if the slot or the channel doesn't exist.
+ */
+uint8_t pilots_set_channel(uint8_t slot, uint8_t index) {
+    if (slot >= PILOTS_MAX || (index >= CHANNEL_COUNT && index != PILOTS_NONE)) return 1;
+
+    pilots_channels[slot] = index;
+    pilots_measured &= ~(1 << slot);
+    pilots_lost_slots |= 1 << slot;
+    _pilots_plan();
+    if (pilots_active) _pilots_restart();
+    return 0;
+}
+
+/* This function returns the channel of a slot, or
+ * PILOTS_NONE if it is empty.
+ */
+uint8_t pilots_channel(uint8_t slot) {
+    if (slot >= PILOTS_MAX) return PILOTS_NONE;
+    return pilots_channels[slot];
+}
+
+/* This function starts hopping. The readings start over.
+ */
+void pilots_start(void) {
+    pilots_measured = 0;
+    pilots_lost_slots = 0xFF;
+    pilots_cycle_time = 0;
+    // The receiver can be anywhere, give it the longest settle time.
+    pilots_tuned_freq = 0;
+    _pilots_plan();
+    _pilots_restart();
+    pilots_active = 1;
+}
+
+/* This function stops hopping. The receiver stays on the
+ * last channel, so it must be retuned.
+ */
+void pilots_stop(void) {
+    pilots_active = 0;
+}
+
+/* This function returns 1 while hopping.
+ */
+uint8_t pilots_running(void) {
+    return pilots_active;
+}
+
+/* This function advances the hopping. It returns the slot
+ * that was measured, or PILOTS_NONE while the receiver
+ * settles or if it isn't hopping.
+ */
+uint8_t pilots_step(void) {
+    if (!pilots_active || pilots_count == 0) return PILOTS_NONE;
+    // Like the scan's, the settle time is measured in us, not in slices.
+    if (rtos_elapsed_us(pilots_hop_us) < pilots_settle_us) return PILOTS_NONE;
+
+    // The newest sample is already an average of several conversions.
+    uint8_t slot = pilots_order[pilots_position];
+    _pilots_measure(slot, video_rx_get_rssi());
+
+    if (++pilots_position >= pilots_count) {
+        uint16_t now = rtos_get_time_ms();
+        pilots_cycle_time = now - pilots_cycle_start;
+        pilots_cycle_start = now;
+        pilots_position = 0;
+    }
+    _pilots_hop(pilots_order[pilots_position]);
+    return slot;
+}
+
+/* This function returns the filtered RSSI of a slot, 0-99,
+ * or 0 if it wasn't measured.
+ */
+uint8_t pilots_rssi(uint8_t slot) {
+    if (slot >= PILOTS_MAX || !(pilots_measured & (1 << slot))) return 0;
+    return pilots_filtered[slot] >> PILOTS_FILTER_SHIFT;
+}
+
+/* This function returns 1 if the signal of a slot is
+ * lost, or it wasn't measured yet.
+ */
+uint8_t pilots_lost(uint8_t slot) {
+    if (slot >= PILOTS_MAX) return 1;
+    return (pilots_lost_slots >> slot) & 1;
+}
+
+/* This function returns how long the last round through
+ * all pilots took in ms, so every pilot is read 1000 / ms
+ * times per second. It is 0 until the first round is done.
+ */
+uint16_t pilots_cycle_ms(void) {
+    return pilots_cycle_time;
+}
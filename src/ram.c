@@ -0,0 +1,90 @@
+#include "ram.h"
+#include "hal.h"
+
+#ifndef HAL_NATIVE
+
+// Symbols of the linker script
+extern uint8_t __data_start;    // Start of .data, the first byte of RAM
+extern uint8_t _end;            // End of .bss
+extern uint8_t __stack;         // Top of the stack (RAMEND)
+
+#define RAM_DATA_START  (&__data_start)
+#define RAM_BSS_END     (&_end)
+#define RAM_STACK_TOP   (&__stack)
+
+#define _RAM_STRING(x)  #x
+#define RAM_STRING(x)   _RAM_STRING(x)
+
+/* This function paints the free RAM with the canary. It runs in
+ * .init1, before the stack pointer and the zero register are set
+ * up, so it is naked and written in assembly, and can't use the
+ * stack. It paints from _end up to and including __stack.
+ */
+void _ram_paint(void) __attribute__((naked, used, section(".init1")));
+void _ram_paint(void) {
+    __asm__ __volatile__ (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, " RAM_STRING(RAM_CANARY) "\n"
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:  st Z+, r24\n"
+        "2:  cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n");
+}
+
+/* This function is used internally to find the lowest byte
+ * the stack has written to.
+ */
+uint8_t *_ram_stack_low(void) {
+    uint8_t *p = RAM_BSS_END;
+    while (p <= RAM_STACK_TOP && *p == RAM_CANARY) p++;
+    return p;
+}
+
+#else
+
+/* The native build has no such memory layout, it reports
+ * no variables and a stack that was never used.
+ */
+uint8_t ram_native[RAMEND + 1];
+
+#define RAM_DATA_START  (&ram_native[0x100])
+#define RAM_BSS_END     (&ram_native[0x100])
+#define RAM_STACK_TOP   (&ram_native[RAMEND])
+
+uint8_t *_ram_stack_low(void) {
+    return RAM_STACK_TOP + 1;
+}
+
+#endif
+
+/* This function returns the size of .data and .bss, the
+ * RAM that is taken by the variables.
+ */
+uint16_t ram_static(void) {
+    return RAM_BSS_END - RAM_DATA_START;
+}
+
+/* This function returns the deepest the stack has been
+ * since reset, in bytes. It walks through the free RAM, so
+ * it takes ~6 cycles per byte that was never used.
+ */
+uint16_t ram_stack_peak(void) {
+    return RAM_STACK_TOP + 1 - _ram_stack_low();
+}
+
+/* This function returns the RAM that was never used, between
+ * the variables and the deepest point of the stack.
+ */
+uint16_t ram_stack_free(void) {
+    return _ram_stack_low() - RAM_BSS_END;
+}
+
+/* This function returns the current depth of the stack.
+ */
+uint16_t ram_stack_now(void) {
+    return RAMEND - hal_stack_pointer();
+}
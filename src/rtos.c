@@ -1,23 +1,70 @@
 #include <rtos.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
 #include <rtos_tasks.h>
-#include "pins.h"
+#include "hal.h"
+
+// Number of slices since the RTOS was started.
+volatile uint16_t rtos_ticks = 0;
+
+// Slice length, used for the statistics and the time
+uint16_t rtos_slice_us;
+uint8_t rtos_slice_ms;
+uint16_t rtos_window_start = 0;
+
+/* Timer1 TOP of one slice, and the number of slices the
+ * current timer period spans. It is more than 1 while the
+ * slice is stretched by rtos_idle().
+ */
+uint16_t rtos_slice_top;
+volatile uint8_t rtos_stretch = 1;
+uint8_t rtos_stretch_max;
+
+/* The slice is only stretched if the timer is at least this
+ * many counts away from its TOP, so it can't wrap while the
+ * new TOP is being written.
+ */
+#define RTOS_STRETCH_MARGIN 16
+
+/* The number of slices left in which the tasks with the
+ * RTOS_OVERRUN_SHED policy are not released.
+ */
+uint16_t rtos_shed = 0;
 
 /* This function calculates the slice duration in
  * timer ticks, call the init function of every task
- * and sets up the timer and its interrupt.
+ * and sets up the timer and its interrupt. It also
+ * checks that the declared worst case execution
+ * times of all tasks fit into the available time.
  */
 uint8_t rtos_init(uint16_t slice_us){
 
-    uint32_t slice_ticks = slice_us << 1;
+    uint32_t slice_ticks = (uint32_t)slice_us << 1;
 
     if (slice_ticks > 0x10000) return 1;
 
+    // Utilization of every task in 1/1000 of the CPU
+    uint16_t utilization = 0;
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_task_t *task = rtos_task_list[i];
+        if (task->period == 0) task->period = 1;
+        if (task->deadline == 0) task->deadline = task->period;
+        utilization += (uint32_t)task->wcet_us * 1000 / ((uint32_t)task->period * slice_us);
+    }
+    if (utilization > 1000) return 2;
+
+    rtos_slice_us = slice_us;
+    rtos_slice_ms = slice_us / 1000;
+    rtos_slice_top = slice_ticks - 1;
+    rtos_stretch_max = 0x10000UL / slice_ticks;
+    rtos_stats_reset();
+
     // Initialize all tasks
-    for (int i = 0; rtos_task_list[i] != 0; i++) {
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
         rtos_task_list[i]->init();
+        // Release every task on the first slice
+        rtos_task_list[i]->countdown = 1;
+        rtos_task_list[i]->state = RTOS_TASK_IDLE;
+        rtos_task_list[i]->suspended = 0;
+        rtos_task_list[i]->released = 0;
     }
 
     // Initialize Timer 1
@@ -25,7 +72,7 @@ uint8_t rtos_init(uint16_t slice_us){
     TCCR1A = 0;
     TCCR1B = (1 << WGM13) | (1 << WGM12);
     // Write TOP value into ICR1
-    ICR1 = slice_ticks - 1;
+    ICR1 = rtos_slice_top;
     // Enable interrupt
     TIMSK1 = (1 << ICIE1);
     TCNT1 = 0;
@@ -48,25 +95,337 @@ void rtos_disable(void) {
     TCCR1B &= ~(1 << CS11);
 }
 
-/* This is the interrupt handler routine which is called at
- * the beginning of every time slice. The scheduler cycles
- * through the task list and calls the driver functions.
- * If a task takes too long to execute the handler enters
- * an infinite loop and blinks the status LED.
+/* This function returns the number of time slices since
+ * the RTOS was started. The counter wraps around, so
+ * differences should be calculated as uint16_t.
  */
-ISR(TIMER1_CAPT_vect) {
-    static uint8_t i = 0;
-    rtos_task_list[i]->driver();
-    if (rtos_task_list[++i] == 0) {i = 0;}
-
-    if (TIFR1 & (1 << ICF1)) {
-        // Missed an interrupt, commit seppuku.
-        while(1) {
-            setGpioHigh(LED_BUILTIN);
-            _delay_ms(100);
-            setGpioLow(LED_BUILTIN);
-            _delay_ms(100);
+uint16_t rtos_get_ticks(void) {
+    uint16_t ticks;
+    uint8_t sreg = SREG;
+    cli();
+    ticks = rtos_ticks;
+    SREG = sreg;
+    return ticks;
+}
+
+/* This function is used internally to read the tick counter
+ * and Timer1 together, taking into account the ticks that are
+ * pending but not yet counted. It returns the timer count, which
+ * spans more than one slice while the slice is stretched.
+ */
+uint16_t _rtos_read_clock(uint16_t *ticks) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t count = hal_timer1_count();
+    uint16_t t = rtos_ticks;
+    if (hal_timer1_pending() && count < (ICR1 >> 1)) t += rtos_stretch;
+    SREG = sreg;
+    *ticks = t;
+    return count;
+}
+
+/* This function is used internally to read the time since
+ * the RTOS was started in Timer1 counts (0.5 us).
+ */
+uint32_t _rtos_timestamp(void) {
+    uint16_t ticks;
+    uint16_t count = _rtos_read_clock(&ticks);
+    return (uint32_t)ticks * ((uint32_t)rtos_slice_top + 1) + count;
+}
+
+/* This function returns the time since the RTOS was started
+ * in milliseconds. The slice must be a whole number of
+ * milliseconds. The time wraps around together with the tick
+ * counter, so differences can be calculated as uint16_t,
+ * just like with rtos_get_ticks().
+ */
+uint16_t rtos_get_time_ms(void) {
+    uint16_t ticks;
+    uint16_t count = _rtos_read_clock(&ticks);
+    uint16_t ms = (count >> 1) / 1000;
+    uint16_t max_ms = rtos_stretch * rtos_slice_ms - 1;
+    if (ms > max_ms) ms = max_ms;
+    return ticks * rtos_slice_ms + ms;
+}
+
+/* This function returns the time since the RTOS was started
+ * in microseconds. It wraps around together with the tick
+ * counter, every 65536 slices, not at 2^32.
+ */
+uint32_t rtos_get_time_us(void) {
+    return _rtos_timestamp() >> 1;
+}
+
+/* This function returns the microseconds that passed
+ * since a time returned by rtos_get_time_us(), also if
+ * the time wrapped around in between.
+ */
+uint32_t rtos_elapsed_us(uint32_t since) {
+    uint32_t now = rtos_get_time_us();
+    // The time wraps after 65536 slices.
+    if (now < since) now += ((uint32_t)rtos_slice_top + 1) << 15;
+    return now - since;
+}
+
+/* This function is used internally to add a run of a task
+ * to its statistics.
+ */
+void _rtos_account(rtos_task_t *task, uint32_t counts) {
+    rtos_stats_t *stats = &task->stats;
+    uint32_t us = counts >> 1;
+    uint16_t time = us > 0xFFFF ? 0xFFFF : us;
+
+    if (time < stats->min_us) stats->min_us = time;
+    if (time > stats->max_us) stats->max_us = time;
+    if (time > task->wcet_us && stats->overruns < 0xFFFF) stats->overruns++;
+    stats->window_us += time;
+    stats->window_runs++;
+}
+
+/* This function is used internally to close the statistics
+ * window once it has elapsed, calculating the averages and
+ * the load of every task.
+ */
+void _rtos_close_window(void) {
+    uint16_t now = rtos_get_ticks();
+    uint16_t window = now - rtos_window_start;
+    if (window < RTOS_STATS_WINDOW) return;
+    rtos_window_start = now;
+
+    uint32_t window_us = (uint32_t)window * rtos_slice_us;
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_stats_t *stats = &rtos_task_list[i]->stats;
+        stats->avg_us = stats->window_runs ? stats->window_us / stats->window_runs : 0;
+        stats->load = stats->window_us * 1000 / window_us;
+        stats->window_us = 0;
+        stats->window_runs = 0;
+    }
+}
+
+/* This function runs the ready task with the highest
+ * priority. Tasks with the same priority run in the order
+ * of the task list. Tasks are never preempted by other
+ * tasks, only by interrupts. The execution time of every
+ * run is measured for the statistics. It returns 1 if a
+ * task was run and 0 if there was nothing to do.
+ */
+uint8_t rtos_dispatch(void) {
+    rtos_task_t *next = 0;
+
+    cli();
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_task_t *task = rtos_task_list[i];
+        if (task->state != RTOS_TASK_READY) continue;
+        if (next == 0 || task->priority < next->priority) next = task;
+    }
+    if (next) next->state = RTOS_TASK_RUNNING;
+    sei();
+
+    if (next == 0) return 0;
+
+    uint32_t start = _rtos_timestamp();
+    next->driver();
+    uint32_t end = _rtos_timestamp();
+
+    cli();
+    next->state = RTOS_TASK_IDLE;
+    // A release that came during the run is run next, unless the task suspended itself.
+    if (next->released && !next->suspended) {
+        next->state = RTOS_TASK_READY;
+        next->release_tick = next->released_tick;
+    }
+    next->released = 0;
+    sei();
+
+    _rtos_account(next, end - start);
+    _rtos_close_window();
+    return 1;
+}
+
+/* This function is used internally to stretch the current
+ * slice up to the next release of a task, so the timer
+ * doesn't wake the CPU on slices where nothing happens.
+ * It must be called with interrupts disabled.
+ */
+void _rtos_stretch(void) {
+    if (rtos_stretch != 1 || hal_timer1_pending()) return;
+
+    uint8_t next = rtos_stretch_max;
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_task_t *task = rtos_task_list[i];
+        if (!task->suspended && task->countdown < next) next = task->countdown;
+    }
+    if (next <= 1) return;
+
+    // Too late in this slice, try again in the next one.
+    if (hal_timer1_count() > rtos_slice_top - RTOS_STRETCH_MARGIN) return;
+
+    ICR1 = (uint32_t)next * ((uint32_t)rtos_slice_top + 1) - 1;
+    rtos_stretch = next;
+}
+
+/* This function puts the CPU to sleep until the next
+ * interrupt, unless a task is ready. Timer1 runs from the
+ * I/O clock, and so do the TWI and the ADC, so the deepest
+ * sleep mode that keeps the RTOS running is the idle mode.
+ */
+void rtos_idle(void) {
+    cli();
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        if (rtos_task_list[i]->state != RTOS_TASK_IDLE) {
+            sei();
+            return;
         }
     }
+
+#if RTOS_TICKLESS
+    _rtos_stretch();
+#endif
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    // The instruction after sei() is always executed, so no interrupt is missed.
+    sei();
+    sleep_cpu();
+    sleep_disable();
 }
 
+/* This function stops the periodic releases of a task.
+ */
+void rtos_suspend(rtos_task_t *task) {
+    task->suspended = 1;
+}
+
+/* This function resumes a suspended task and releases it
+ * at once if it isn't running. Its deadline counts from the
+ * next tick, as it may be released late in a slice. The
+ * periodic releases continue from there.
+ */
+void rtos_resume(rtos_task_t *task) {
+    uint8_t sreg = SREG;
+    cli();
+    if (task->suspended) {
+        task->suspended = 0;
+        task->countdown = task->period;
+        if (task->state == RTOS_TASK_IDLE) {
+            task->state = RTOS_TASK_READY;
+            task->release_tick = rtos_ticks + rtos_stretch;
+        } else {
+            task->countdown = 1;
+        }
+    }
+    SREG = sreg;
+}
+
+/* This function returns the statistics of the i-th task
+ * in the task list, or 0 if there is no such task.
+ */
+const rtos_stats_t *rtos_get_stats(uint8_t i) {
+    for (uint8_t j = 0; j < i; j++) {
+        if (rtos_task_list[j] == 0) return 0;
+    }
+    if (rtos_task_list[i] == 0) return 0;
+    return &rtos_task_list[i]->stats;
+}
+
+/* This function returns the share of the CPU used by all
+ * tasks in the last statistics window, in 1/1000.
+ */
+uint16_t rtos_get_load(void) {
+    uint16_t load = 0;
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        load += rtos_task_list[i]->stats.load;
+    }
+    return load;
+}
+
+/* This function resets the minimum and maximum execution
+ * times, the overrun counters and the stack samples of all
+ * tasks.
+ */
+void rtos_stats_reset(void) {
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_stats_t *stats = &rtos_task_list[i]->stats;
+        stats->min_us = 0xFFFF;
+        stats->max_us = 0;
+        stats->overruns = 0;
+        stats->misses = 0;
+        stats->stack = 0;
+    }
+}
+
+/* This function is used internally to handle a task that
+ * is still ready or running when its deadline passes. The
+ * running task can't be stopped, so the miss is counted and
+ * the deadline starts again. A release that hasn't run yet
+ * is kept or dropped, depending on the policy of the task.
+ * Every miss also sheds the tasks that allow it for a while,
+ * to leave the CPU to the others.
+ */
+void _rtos_miss(rtos_task_t *task, uint16_t ticks) {
+    if (task->stats.misses < 0xFFFF) task->stats.misses++;
+    task->release_tick = ticks;
+    if (task->state == RTOS_TASK_READY && task->overrun != RTOS_OVERRUN_DEFER) {
+        task->state = RTOS_TASK_IDLE;
+    }
+    rtos_shed = RTOS_SHED_SLICES;
+}
+
+/* This is the interrupt handler routine which is called at
+ * the beginning of every time slice. It only releases the
+ * tasks whose period has elapsed, they are run later by
+ * rtos_dispatch(). Missed deadlines are handled by
+ * _rtos_miss(). After a stretched slice it counts all the
+ * slices that passed and restores the timer. The depth of
+ * the stack is sampled for the task that was interrupted,
+ * including this handler.
+ */
+ISR(TIMER1_CAPT_vect) {
+    uint16_t depth = RAMEND - hal_stack_pointer();
+
+    uint8_t elapsed = rtos_stretch;
+    if (elapsed != 1) {
+        ICR1 = rtos_slice_top;
+        rtos_stretch = 1;
+    }
+    uint16_t ticks = rtos_ticks += elapsed;
+    rtos_shed = rtos_shed > elapsed ? rtos_shed - elapsed : 0;
+
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_task_t *task = rtos_task_list[i];
+
+        if (task->state == RTOS_TASK_RUNNING && depth > task->stats.stack) task->stats.stack = depth;
+
+        uint8_t missed = 0;
+        if (task->state != RTOS_TASK_IDLE &&
+                (uint16_t)(ticks - task->release_tick) >= task->deadline) {
+            _rtos_miss(task, ticks);
+            missed = 1;
+        }
+
+        if (task->suspended) continue;
+
+        if (task->countdown <= elapsed) {
+            task->countdown = task->period;
+            // A shed task skips its release.
+            if (rtos_shed && task->overrun == RTOS_OVERRUN_SHED) continue;
+            /* A task that is still running keeps a deferred
+             * release for rtos_dispatch() to make it ready once
+             * the run ends, the others drop it like a missed one.
+             */
+            if (task->state == RTOS_TASK_RUNNING) {
+                if (task->overrun == RTOS_OVERRUN_DEFER) {
+                    task->released = 1;
+                    task->released_tick = ticks;
+                } else if (!missed && task->stats.misses < 0xFFFF) {
+                    task->stats.misses++;
+                }
+                continue;
+            }
+            task->state = RTOS_TASK_READY;
+            task->release_tick = ticks;
+        } else {
+            task->countdown -= elapsed;
+        }
+    }
+}
\ No newline at end of file
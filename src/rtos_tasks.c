@@ -1,66 +1,296 @@
 #include <rtos_tasks.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "oled.h"
+#include "i2c.h"
 #include "video_rx.h"
 #include "buttons.h"
+#include "scan.h"
+#include "channels.h"
+#include "spectrum.h"
+#include "laps.h"
+#include "pilots.h"
+#include "settings.h"
+#include "state.h"
+#include "uart.h"
+#include "telemetry.h"
+#include "ram.h"
+#include "watchdog.h"
+#include "ui.h"
+#include "trace.h"
 
-/* The bandplan with the most common bands:
- * A, B, E, F, R.
- * Each band has 8 channels.
+/* The position in the channel database (channels.h), the
+ * frequency and the RSSI are kept in the shared state
+ * (state.h), the tasks publish their changes and subscribe
+ * to the ones they need. These are the defaults, replaced
+ * by the saved settings at boot. Band -1 means custom
+ * frequency is set.
  */
-uint16_t bandplan[][8] = {
-    {5865,5845,5825,5805,5785,5765,5745,5725},
-    {5733,5752,5771,5790,5809,5828,5847,5866},
-    {5705,5685,5665,5645,5885,5905,5925,5945},
-    {5740,5760,5780,5800,5820,5840,5860,5880},
-    {5658,5695,5732,5769,5806,5843,5880,5917}
+const rx_state_t default_state = {
+    .band = 4,
+    .channel = 2,
+    .freq = 5732,
+    .rssi = 0,
+    .page = OLED_PAGE_MAIN
 };
 
-/* Keeping track of our current position in the bandplan.
- * Setting rx_band to -1 means custom frequency is set.
+
+// The telemetry streams the host selected
+uint8_t telemetry_streams = TELEMETRY_STREAM_STATUS;
+// The next trace entry that is sent, 0xFF for none
+uint8_t telemetry_trace_next = 0xFF;
+// The passes of the lap timer that were sent
+uint16_t telemetry_laps_sent = 0;
+
+/* This function is used internally to check a position in
+ * the channel database, or a custom frequency if band is -1.
+ * The frequency of a position is read from the database, a
+ * custom one has to be within the lowest and highest channel
+ * of the database. It returns 0 if the position is valid.
+ */
+uint8_t _check_position(int8_t band, int8_t channel, uint16_t *freq) {
+    if (band >= 0) {
+        if (band >= CHANNEL_BANDS || channel < 0 || channel >= CHANNEL_PER_BAND) return 1;
+        *freq = channel_freq(CHANNEL_INDEX(band, channel));
+    } else if (*freq < channel_freq(channel_nth(0))
+               || *freq > channel_freq(channel_nth(CHANNEL_COUNT - 1))) {
+        return 1;
+    }
+    return 0;
+}
+
+/* The subscribers of the state events are fixed, the build
+ * fails if there are more than the state has room for.
+ */
+#define TASKS_SUBSCRIBERS   5
+
+#if TASKS_SUBSCRIBERS > STATE_SUBSCRIBERS
+#error "Raise STATE_SUBSCRIBERS, the tasks subscribe more queues"
+#endif
+
+// Subscriptions that failed anyway, shown on the settings page
+uint8_t tasks_subscribe_errors = 0;
+
+/* This function is used internally to subscribe a task to
+ * the state events. If there is no room, the task won't hear
+ * of the changes. The receiver keeps running and the settings
+ * page shows the error.
  */
-int rx_band = 4;
-int rx_channel = 2;
+void _subscribe(state_queue_t *queue, uint8_t mask, rtos_task_t *task) {
+    if (state_subscribe(queue, mask, task)) tasks_subscribe_errors++;
+}
+
+/* This function is used internally to select a frequency.
+ * If a channel of the database is on it, its position is
+ * selected, otherwise it is a custom frequency and the
+ * channel is kept for the grid.
+ */
+void _select_frequency(uint16_t freq) {
+    uint8_t index = channel_nearest(freq);
+    if (channel_freq(index) == freq) {
+        state_set_position(index / CHANNEL_PER_BAND, index % CHANNEL_PER_BAND, freq);
+        return;
+    }
+
+    rx_state_t state;
+    state_read(&state);
+    state_set_position(-1, state.channel, freq);
+}
+
+/* This function is used internally to tune the RX to the
+ * frequency of the state. The channels of the database have
+ * their SYN_REG_B write ready, so only custom frequencies
+ * are calculated. The buffered RSSI samples are of the old
+ * frequency, or of the channels the scan, the sweep or the
+ * hopping visited, so they are discarded.
+ */
+void _tune(const rx_state_t *state) {
+    if (state->band >= 0) {
+        video_rx_set_word(channel_word(CHANNEL_INDEX(state->band, state->channel)), state->freq);
+    } else {
+        video_rx_set_frequency(state->freq);
+    }
+    video_rx_rssi_flush();
+}
 
-/* Currently set frequency (in MHz) 
- * and RSSI (arbitrary units, 0-99)
+/* The position and the frequency the RX is tuned to are kept
+ * over a watchdog reset, in RAM that the C runtime doesn't
+ * clear. The RX keeps its registers over the reset, so the
+ * receiver comes back on the same channel without writing
+ * the frequency again, which would blank the video. tuned
+ * is 0 while the RX isn't settled on the set frequency.
  */
-uint16_t freq = 5732;
-uint8_t rssi = 0;
+typedef struct retained {
+    settings_t settings;
+    uint16_t tuned;
+    uint16_t check;
+} retained_t;
+
+retained_t retained HAL_NOINIT;
+
+/* This function is used internally to calculate the check
+ * value of the retained state.
+ */
+uint16_t _retained_check(void) {
+    return ~(retained.settings.freq ^ retained.tuned ^
+        ((uint8_t)retained.settings.band << 8) ^ (uint8_t)retained.settings.channel);
+}
+
+/* This function is used internally to update the retained
+ * state.
+ */
+void _retain(const rx_state_t *state, uint16_t tuned) {
+    retained.settings.band = state->band;
+    retained.settings.channel = state->channel;
+    retained.settings.freq = state->freq;
+    retained.tuned = tuned;
+    retained.check = _retained_check();
+}
+
+/* This function is used internally to start a scan of
+ * the whole channel database, or of the frequencies from
+ * freq_low to freq_high if freq_low isn't 0.
+ */
+void _start_scan(uint16_t freq_low, uint16_t freq_high) {
+    // The scan tunes the RX away.
+    rx_state_t state;
+    state_read(&state);
+    _retain(&state, 0);
+
+    if (freq_low) scan_start_range(freq_low, freq_high);
+    else scan_start_channels();
+    rtos_resume(&task_scan);
+    // Odd frequencies are finished by the frequency task.
+    rtos_resume(&task_rx_freq);
+    // The main page shows the scanned frequency.
+    rtos_resume(&task_oled);
+}
+
+/* This function is used internally to cancel a running
+ * scan and go back to the set frequency.
+ */
+void _cancel_scan(void) {
+    scan_cancel();
+    state_publish(STATE_EVENT_RETUNE);
+}
 
 
 /* This task is responsible for updating the RX
  * frequency when it changes. It must update it
  * only on change because even updating with the
  * same value will cause a momentary loss of image.
+ * The scan tunes the RX directly and publishes a
+ * retune event when it's done, so the frequency is
+ * written again. It also finishes tuning to odd
+ * frequencies, for the scan as well, and keeps the
+ * retained state up to date. In between it is
+ * suspended, the events resume it.
  */
 rtos_task_t task_rx_freq = {
     .init = init_rx_freq,
-    .driver = driver_rx_freq
+    .driver = driver_rx_freq,
+    .period = 1,
+    .priority = 1,
+    .wcet_us = 100
 };
 
+/* This function is used internally to restore the retained
+ * position after a watchdog reset. It returns the frequency
+ * the RX is still tuned to, 1 if it has to be tuned again or
+ * 0 if nothing was restored.
+ */
+uint16_t _restore_retained(rx_state_t *state) {
+    settings_t settings = retained.settings;
+    if (!watchdog_recovered() || retained.check != _retained_check()) return 0;
+    if (_check_position(settings.band, settings.channel, &settings.freq)) return 0;
+
+    state->band = settings.band;
+    state->channel = settings.channel;
+    state->freq = settings.freq;
+    return retained.tuned ? retained.tuned : 1;
+}
+
+/* This function is used internally to restore the saved
+ * position, before the RX is tuned for the first time.
+ * Records that don't make sense are ignored.
+ */
+void _restore_settings(rx_state_t *state) {
+    settings_t settings;
+    if (settings_load(&settings)) return;
+    if (_check_position(settings.band, settings.channel, &settings.freq)) return;
+
+    state->band = settings.band;
+    state->channel = settings.channel;
+    state->freq = settings.freq;
+}
+
+state_queue_t rx_freq_events;
+
+// The frequency the RX is actually tuned to
+uint16_t tuned_freq = 0;
+
 void init_rx_freq(void) {
+    // The EEPROM is read here once, the settings task saves into it later.
+    settings_init();
+
+    rx_state_t state = default_state;
+    uint16_t tuned = _restore_retained(&state);
+    if (!tuned) _restore_settings(&state);
+    state_init(&state);
+    _subscribe(&rx_freq_events, STATE_EVENT_FREQ | STATE_EVENT_POSITION | STATE_EVENT_RETUNE, &task_rx_freq);
+
     // RTC6715 - 3 wire SPI
     video_rx_init_spi();
-    video_rx_set_frequency(freq);
+    if (tuned != state.freq) _tune(&state);
+    tuned_freq = state.freq;
+    _retain(&state, video_rx_tuning() ? 0 : tuned_freq);
 }
 
 void driver_rx_freq(void) {
-    static uint16_t old_freq = 0;
-    if (freq != old_freq) {
-        video_rx_set_frequency(freq);
+    video_rx_tune_step();
+    // The events wait until the scan, the sweep or the hopping is done.
+    if (scan_running() || spectrum_running() || pilots_running()) return;
+
+    uint8_t events = 0;
+    uint8_t event;
+    while ((event = state_get_event(&rx_freq_events))) events |= event;
+
+    rx_state_t state;
+    state_read(&state);
+    if (events & (STATE_EVENT_FREQ | STATE_EVENT_RETUNE)) {
+        if (state.freq != tuned_freq || (events & STATE_EVENT_RETUNE)) {
+            _tune(&state);
+            tuned_freq = state.freq;
+        }
     }
-    old_freq = freq;
+
+    if (video_rx_tuning()) {
+        _retain(&state, 0);
+        return;
+    }
+
+    // Nothing to do until the next event.
+    _retain(&state, tuned_freq);
+    rtos_suspend(&task_rx_freq);
 }
 
 
-/* This task is responsible for reading the ADC to
- * determine the current signal strength. The last
- * 16 readings are averaged to smooth out the value.
+/* This task is responsible for processing the RSSI
+ * samples collected by the ADC interrupt. Every run
+ * averages the samples that arrived since the last run,
+ * and the last 16 averages are averaged again to smooth
+ * out the value. The raw samples are also streamed over
+ * the UART if the host asked for them. While the laps page
+ * is shown, every raw sample goes through the lap timer
+ * (laps.h) as well.
  */
 rtos_task_t task_rx_rssi = {
     .init = init_rx_rssi,
-    .driver = driver_rx_rssi
+    .driver = driver_rx_rssi,
+    .period = 4,
+    .priority = 2,
+    .wcet_us = 800,
+    // The next run reads the samples of a skipped one.
+    .overrun = RTOS_OVERRUN_SKIP
 };
 
 void init_rx_rssi(void) {
@@ -68,136 +298,1234 @@ void init_rx_rssi(void) {
 }
 
 void driver_rx_rssi(void) {
-    static int counter = 0;
-    static uint8_t previous_rssi[16] = {0};
-    previous_rssi[counter++ & 15] = video_rx_get_rssi();
-    uint16_t sum = 0;
-    for (int i = 0; i < 16; i++) {
+    static uint8_t counter = 0;
+    static uint16_t previous_rssi[16] = {0};
+
+    rx_state_t state;
+    state_read(&state);
+    // The lap timer runs on the laps page, on the set frequency.
+    if (state.page == OLED_PAGE_LAPS && !scan_running()) {
+        if (!laps_running() || laps_freq() != state.freq) laps_start(state.freq);
+    } else if (laps_running()) {
+        laps_stop();
+    }
+
+    uint16_t samples[16];
+    uint32_t batch_sum = 0;
+    uint16_t batch_count = 0;
+    uint8_t count;
+    while ((count = video_rx_rssi_read(samples, 16)) > 0) {
+        for (uint8_t i = 0; i < count; i++) {
+            batch_sum += samples[i];
+        }
+        batch_count += count;
+        laps_process(samples, count);
+        // The AVR is little endian, like the protocol.
+        if (telemetry_streams & TELEMETRY_STREAM_RSSI) {
+            telemetry_send(TELEMETRY_RSSI, (const uint8_t *)samples, count * 2);
+        }
+    }
+    // The lap timer keeps time by counting the samples.
+    laps_skip(video_rx_rssi_overruns());
+
+    // The scan, the sweep and the hopping take their own readings on other channels.
+    if (scan_running() || spectrum_running() || pilots_running() || batch_count == 0) return;
+
+    previous_rssi[counter++ & 15] = batch_sum / batch_count;
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < 16; i++) {
         sum += previous_rssi[i];
     }
-    rssi = (uint8_t) (sum >> 4);
+    state_set_rssi(video_rx_rssi_scale(sum >> 4));
 }
 
 
 /* This task is responsible for updating the OLED
- * screen whenever the frequency or RSSI change.
+ * screen. Every page is a table of widgets (ui.h),
+ * the task only sets their values and the widgets
+ * that changed are drawn into the tile map, which is
+ * flushed OLED_REFRESH_HZ times per second, so a
+ * jittery RSSI value can't saturate the I2C bus.
+ * It subscribes to all state events and reads the
+ * state only when one arrives, on the main page it
+ * sleeps until then. It has the lowest priority of
+ * all tasks and is the first to be shed when a
+ * deadline is missed.
+ * The receiver works without the display: if it is
+ * missing or stops answering, the task only checks
+ * for it every OLED_PROBE_MS and redraws the page
+ * once it is back.
  */
+#define OLED_REFRESH_HZ 20
+#define OLED_PROBE_MS   1000
+
+// Runs in a row with failed writes before the display counts as missing
+#define OLED_MAX_ERRORS 3
+
 rtos_task_t task_oled = {
     .init = init_oled,
-    .driver = driver_oled
+    .driver = driver_oled,
+    .period = 1000000UL / OLED_REFRESH_HZ / RTOS_SLICE_US,
+    .priority = 4,
+    .wcet_us = 1500,
+    .overrun = RTOS_OVERRUN_SHED
 };
 
-void init_oled() {
-    if(oled_init()) {
-        while(1);
+// The state events and the copy of the state that is shown
+state_queue_t oled_events;
+rx_state_t oled_state;
+
+// 1 while the display answers
+uint8_t oled_online = 0;
+uint8_t oled_errors = 0;
+// Runs until the next probe, and 1 while a probe is being sent
+uint8_t oled_probe_countdown = 1;
+uint8_t oled_probing = 0;
+
+/* The page that is shown and the runs since it was shown. The
+ * runs are 0 only on the first run of a page, after that they
+ * count from 1 to OLED_PAGE_RUNS_WRAP over and over. The wrap is
+ * a multiple of every period the pages count in the runs, so
+ * they go on evenly over it.
+ */
+#define OLED_PAGE_RUNS_WRAP (10 * OLED_REFRESH_HZ)
+
+uint8_t oled_page = 0xFF;
+uint8_t oled_page_runs = 0;
+
+// Texts of the widgets
+const char text_digits[] PROGMEM = "0123456789";
+const char text_channels[] PROGMEM = "12345678";
+const char text_mhz[] PROGMEM = "MHz";
+const char text_rssi[] PROGMEM = "  RSSI ";
+const char text_arrows[] PROGMEM = OLED_LEFT "     " OLED_RIGHT "     " OLED_UP "     " OLED_DOWN;
+const char text_rx[] PROGMEM = "AB";
+const char text_scan[] PROGMEM = "SCAN";
+const char text_scan_mhz[] PROGMEM = " MHz";
+const char text_percent[] PROGMEM = "%";
+const char text_scan_header[] PROGMEM = "MHz  RSSI";
+const char text_scan_help[] PROGMEM = OLED_LEFT "+" OLED_RIGHT " SCAN, ANY: STOP";
+const char text_stats[] PROGMEM = " AVG   MAX  CPU";
+const char text_settings[] PROGMEM = "SETTINGS";
+const char text_saved[] PROGMEM = "SAVED";
+const char text_resets[] PROGMEM = "RESETS";
+const char text_errors[] PROGMEM = "ERRORS";
+const char text_streams[] PROGMEM = "STREAMS";
+const char text_stream_rssi[] PROGMEM = "-R";
+const char text_stream_status[] PROGMEM = "-S";
+const char text_stream_stats[] PROGMEM = "-T";
+const char text_ram[] PROGMEM = "RAM";
+const char text_static[] PROGMEM = "STATIC";
+const char text_stack[] PROGMEM = "STACK";
+const char text_free[] PROGMEM = "FREE";
+const char text_blank[] PROGMEM = "";
+const char text_laps[] PROGMEM = "LAPS";
+const char text_last[] PROGMEM = "LAST";
+const char text_best[] PROGMEM = "BEST";
+const char text_point[] PROGMEM = ".";
+const char text_pilots[] PROGMEM = "PILOTS";
+const char text_hz[] PROGMEM = " HZ";
+const char text_cursor[] PROGMEM = " " OLED_RIGHT;
+const char text_lost[] PROGMEM = " !";
+const char text_pilots_help[] PROGMEM = OLED_UP OLED_DOWN " PILOT " OLED_LEFT OLED_RIGHT " CHANNEL";
+
+/* The main page with the frequency, RSSI and the grid of
+ * the channel database. The grid only has room for
+ * OLED_GRID_BANDS bands, it scrolls to the selected one.
+ */
+#define OLED_GRID_BANDS 5
+
+#define SLOT_MAIN_FREQ  0
+#define SLOT_MAIN_RSSI  1
+#define SLOT_MAIN_RX    2
+#define SLOT_MAIN_GRID  3   // And the first band shown
+
+uint8_t oled_grid_first = 0;
+
+const ui_widget_t page_main[] PROGMEM = {
+    {.type = UI_NUMBER, .col = 0, .row = 0, .width = 4, .slot = SLOT_MAIN_FREQ, .flags = UI_INVERT},
+#if VIDEO_RX_DIVERSITY
+    {.type = UI_LABEL, .col = 4, .row = 0, .width = 7, .flags = UI_INVERT, .text = text_mhz},
+    // The RX on the video output
+    {.type = UI_CHOICE, .col = 11, .row = 0, .slot = SLOT_MAIN_RX, .flags = UI_INVERT, .text = text_rx},
+#else
+    {.type = UI_LABEL, .col = 4, .row = 0, .width = 8, .flags = UI_INVERT, .text = text_mhz},
+#endif
+    {.type = UI_LABEL, .col = 12, .row = 0, .width = 7, .flags = UI_INVERT, .text = text_rssi},
+    {.type = UI_NUMBER, .col = 19, .row = 0, .width = 2, .slot = SLOT_MAIN_RSSI, .flags = UI_INVERT},
+    {.type = UI_GRID, .col = 4, .row = 2, .width = CHANNEL_PER_BAND, .height = OLED_GRID_BANDS, .slot = SLOT_MAIN_GRID, .flags = UI_SCROLL, .text = channel_band_letters},
+    {.type = UI_LABEL, .col = 1, .row = 7, .text = text_arrows},
+};
+
+/* This function is used internally to update the main page.
+ * The scan isn't published, its frequency is shown while
+ * it runs.
+ */
+void _oled_update_main(const rx_state_t *state) {
+    ui_set(SLOT_MAIN_FREQ, scan_running() ? scan_current_freq() : state->freq);
+    ui_set(SLOT_MAIN_RSSI, state->rssi);
+    ui_set(SLOT_MAIN_RX, video_rx_active());
+    // A custom frequency has no dot in the grid.
+    ui_set(SLOT_MAIN_GRID, state->band >= 0 ? CHANNEL_INDEX(state->band, state->channel) : UI_NONE);
+
+    // Scroll only when the selected band is out of sight.
+    if (state->band >= 0 && state->band < oled_grid_first) oled_grid_first = state->band;
+    if (state->band >= oled_grid_first + OLED_GRID_BANDS) oled_grid_first = state->band - OLED_GRID_BANDS + 1;
+    ui_set(SLOT_MAIN_GRID + 1, oled_grid_first);
+}
+
+/* The scanner page with the progress and the strongest
+ * channels of the last scan.
+ */
+#define SLOT_SCAN_FREQ      0
+#define SLOT_SCAN_PROGRESS  1
+#define SLOT_SCAN_RESULTS   2   // SCAN_RESULTS frequencies
+#define SLOT_SCAN_RSSI      (SLOT_SCAN_RESULTS + SCAN_RESULTS)
+
+const ui_widget_t page_scan[] PROGMEM = {
+    {.type = UI_LABEL, .col = 0, .row = 0, .width = 5, .flags = UI_INVERT, .text = text_scan},
+    {.type = UI_NUMBER, .col = 5, .row = 0, .width = 4, .slot = SLOT_SCAN_FREQ, .flags = UI_INVERT},
+    {.type = UI_LABEL, .col = 9, .row = 0, .width = 8, .flags = UI_INVERT, .text = text_scan_mhz},
+    {.type = UI_NUMBER, .col = 17, .row = 0, .width = 3, .slot = SLOT_SCAN_PROGRESS, .flags = UI_INVERT},
+    {.type = UI_LABEL, .col = 20, .row = 0, .width = 1, .flags = UI_INVERT, .text = text_percent},
+    {.type = UI_BAR, .col = 0, .row = 1, .width = OLED_TILE_COLS, .slot = SLOT_SCAN_PROGRESS, .max = 100},
+    {.type = UI_LABEL, .col = 0, .row = 2, .text = text_scan_header},
+    {.type = UI_NUMBER, .col = 0, .row = 3, .width = 4, .height = SCAN_RESULTS, .slot = SLOT_SCAN_RESULTS},
+    {.type = UI_NUMBER, .col = 5, .row = 3, .width = 2, .height = SCAN_RESULTS, .slot = SLOT_SCAN_RSSI},
+    {.type = UI_BAR, .col = 9, .row = 3, .width = 12, .height = SCAN_RESULTS, .slot = SLOT_SCAN_RSSI, .max = 99},
+    {.type = UI_LABEL, .col = 0, .row = 7, .text = text_scan_help},
+};
+
+void _oled_update_scan(const rx_state_t *state) {
+    (void)state;
+    ui_set(SLOT_SCAN_FREQ, scan_current_freq());
+    ui_set(SLOT_SCAN_PROGRESS, scan_progress());
+    for (uint8_t i = 0; i < SCAN_RESULTS; i++) {
+        const scan_result_t *result = scan_get_result(i);
+        ui_set(SLOT_SCAN_RESULTS + i, result ? result->freq : 0);
+        ui_set(SLOT_SCAN_RSSI + i, result ? result->rssi : 0);
     }
+}
+
+/* The task statistics page. The top row shows the total
+ * CPU load, then every task has a row with its index, average
+ * and maximum execution time (us), load (1/1000) and the
+ * number of runs that took longer than declared. There are
+ * more tasks than rows, so the page moves on to the next tasks
+ * every OLED_STATS_FLIP_RUNS, the last rows are filled up with
+ * the tasks before them.
+ */
+#define OLED_STATS_TASKS    (OLED_TILE_ROWS - 1)
+#define OLED_STATS_FLIP_RUNS (2 * OLED_REFRESH_HZ)
+
+#define SLOT_STATS_LOAD     0
+#define SLOT_STATS_INDEX    1
+#define SLOT_STATS_AVG      (SLOT_STATS_INDEX + OLED_STATS_TASKS)
+#define SLOT_STATS_MAX      (SLOT_STATS_AVG + OLED_STATS_TASKS)
+#define SLOT_STATS_TASK     (SLOT_STATS_MAX + OLED_STATS_TASKS)
+#define SLOT_STATS_OVERRUNS (SLOT_STATS_TASK + OLED_STATS_TASKS)
+
+const ui_widget_t page_stats[] PROGMEM = {
+    {.type = UI_LABEL, .col = 0, .row = 0, .width = 17, .flags = UI_INVERT, .text = text_stats},
+    {.type = UI_NUMBER, .col = 17, .row = 0, .width = 4, .slot = SLOT_STATS_LOAD, .flags = UI_INVERT},
+    {.type = UI_CHOICE, .col = 0, .row = 1, .height = OLED_STATS_TASKS, .slot = SLOT_STATS_INDEX, .text = text_digits},
+    {.type = UI_NUMBER, .col = 2, .row = 1, .width = 4, .height = OLED_STATS_TASKS, .slot = SLOT_STATS_AVG},
+    {.type = UI_NUMBER, .col = 7, .row = 1, .width = 5, .height = OLED_STATS_TASKS, .slot = SLOT_STATS_MAX},
+    {.type = UI_NUMBER, .col = 13, .row = 1, .width = 4, .height = OLED_STATS_TASKS, .slot = SLOT_STATS_TASK},
+    {.type = UI_NUMBER, .col = 18, .row = 1, .width = 3, .height = OLED_STATS_TASKS, .slot = SLOT_STATS_OVERRUNS, .max = 999},
+};
+
+// The first task that is shown and the runs since it changed
+uint8_t oled_stats_first;
+uint8_t oled_stats_runs;
+
+void _oled_update_stats(const rx_state_t *state) {
+    (void)state;
+    ui_set(SLOT_STATS_LOAD, rtos_get_load());
 
-    if (i2c_start()) {
-        while(1);
+    uint8_t count = 0;
+    while (rtos_get_stats(count)) count++;
+
+    if (oled_page_runs == 0) {
+        oled_stats_first = 0;
+        oled_stats_runs = 0;
+    } else if (++oled_stats_runs == OLED_STATS_FLIP_RUNS) {
+        oled_stats_runs = 0;
+        oled_stats_first += OLED_STATS_TASKS;
+        if (oled_stats_first >= count) oled_stats_first = 0;
     }
+    uint8_t first = oled_stats_first;
+    if (count > OLED_STATS_TASKS && first > count - OLED_STATS_TASKS) first = count - OLED_STATS_TASKS;
 
-    for (int i = 0; i < 1024; i++) {
-        oled_raw_write(0);
+    for (uint8_t i = 0; i < OLED_STATS_TASKS; i++) {
+        const rtos_stats_t *stats = rtos_get_stats(first + i);
+        ui_set(SLOT_STATS_INDEX + i, stats ? first + i : UI_NONE);
+        ui_set(SLOT_STATS_AVG + i, stats ? stats->avg_us : 0);
+        ui_set(SLOT_STATS_MAX + i, stats ? stats->max_us : 0);
+        ui_set(SLOT_STATS_TASK + i, stats ? stats->load : 0);
+        ui_set(SLOT_STATS_OVERRUNS + i, stats ? stats->overruns : 0);
     }
+}
 
-    // Fill in some blank spaces so it looks better
-    int fill_coords[] = {0,25,26,88,113,114,115,-1};
+/* The settings page with the saved position, the watchdog
+ * resets since power on, the subscriptions to the state
+ * events that failed and the telemetry streams.
+ */
+#define SLOT_SETTINGS_FREQ      0
+#define SLOT_SETTINGS_BAND      1
+#define SLOT_SETTINGS_CHANNEL   2
+#define SLOT_SETTINGS_RESETS    3
+#define SLOT_SETTINGS_STREAMS   4   // One per stream
+#define SLOT_SETTINGS_ERRORS    7
+
+const ui_widget_t page_settings[] PROGMEM = {
+    {.type = UI_LABEL, .col = 0, .row = 0, .width = OLED_TILE_COLS, .flags = UI_INVERT, .text = text_settings},
+    {.type = UI_LABEL, .col = 0, .row = 2, .text = text_saved},
+    {.type = UI_NUMBER, .col = 8, .row = 2, .width = 4, .slot = SLOT_SETTINGS_FREQ},
+    {.type = UI_LABEL, .col = 13, .row = 2, .text = text_mhz},
+    {.type = UI_CHOICE, .col = 17, .row = 2, .slot = SLOT_SETTINGS_BAND, .text = channel_band_letters},
+    {.type = UI_CHOICE, .col = 18, .row = 2, .slot = SLOT_SETTINGS_CHANNEL, .text = text_channels},
+    {.type = UI_LABEL, .col = 0, .row = 3, .text = text_resets},
+    {.type = UI_NUMBER, .col = 8, .row = 3, .width = 3, .slot = SLOT_SETTINGS_RESETS},
+    {.type = UI_LABEL, .col = 0, .row = 4, .text = text_streams},
+    {.type = UI_CHOICE, .col = 8, .row = 4, .slot = SLOT_SETTINGS_STREAMS, .text = text_stream_rssi},
+    {.type = UI_CHOICE, .col = 9, .row = 4, .slot = SLOT_SETTINGS_STREAMS + 1, .text = text_stream_status},
+    {.type = UI_CHOICE, .col = 10, .row = 4, .slot = SLOT_SETTINGS_STREAMS + 2, .text = text_stream_stats},
+    {.type = UI_LABEL, .col = 0, .row = 5, .text = text_errors},
+    {.type = UI_NUMBER, .col = 8, .row = 5, .width = 3, .slot = SLOT_SETTINGS_ERRORS},
+};
 
-    for (int i = 0; fill_coords[i] != -1; i++) {
-        oled_raw_set_position(fill_coords[i], 0);
-        oled_raw_write(0xFF);
+/* The saved settings come from the copy in RAM
+ * (settings_load()), so the page can be updated on every run,
+ * also while the settings task is writing the EEPROM.
+ */
+void _oled_update_settings(const rx_state_t *state) {
+    (void)state;
+    settings_t settings;
+    if (settings_load(&settings)) {
+        settings.freq = 0;
+        settings.band = -1;
     }
+    ui_set(SLOT_SETTINGS_FREQ, settings.freq);
+    // A custom frequency has no position.
+    ui_set(SLOT_SETTINGS_BAND, settings.band >= 0 ? settings.band : UI_NONE);
+    ui_set(SLOT_SETTINGS_CHANNEL, settings.band >= 0 ? settings.channel : UI_NONE);
+    ui_set(SLOT_SETTINGS_RESETS, watchdog_resets());
+    ui_set(SLOT_SETTINGS_STREAMS, (telemetry_streams & TELEMETRY_STREAM_RSSI) ? 1 : 0);
+    ui_set(SLOT_SETTINGS_STREAMS + 1, (telemetry_streams & TELEMETRY_STREAM_STATUS) ? 1 : 0);
+    ui_set(SLOT_SETTINGS_STREAMS + 2, (telemetry_streams & TELEMETRY_STREAM_STATS) ? 1 : 0);
+    ui_set(SLOT_SETTINGS_ERRORS, tasks_subscribe_errors);
+}
 
-    i2c_stop();
+/* The RAM page with the size of the variables, the deepest
+ * the stack has been and the RAM that was never used, in
+ * bytes. Below are the index and the deepest sampled stack
+ * of the tasks, two per row. Like the statistics page it moves
+ * on to the next tasks every OLED_RAM_FLIP_RUNS.
+ */
+#define OLED_RAM_TASKS      8
+#define OLED_RAM_FLIP_RUNS  (2 * OLED_REFRESH_HZ)
+
+#define SLOT_RAM_STATIC     0
+#define SLOT_RAM_PEAK       1
+#define SLOT_RAM_FREE       2
+#define SLOT_RAM_INDEX      3   // Even rows of the window, then odd ones
+#define SLOT_RAM_STACK      (SLOT_RAM_INDEX + OLED_RAM_TASKS)
+
+const ui_widget_t page_ram[] PROGMEM = {
+    {.type = UI_LABEL, .col = 0, .row = 0, .width = OLED_TILE_COLS, .flags = UI_INVERT, .text = text_ram},
+    {.type = UI_LABEL, .col = 0, .row = 1, .text = text_static},
+    {.type = UI_NUMBER, .col = 8, .row = 1, .width = 4, .slot = SLOT_RAM_STATIC},
+    {.type = UI_LABEL, .col = 0, .row = 2, .text = text_stack},
+    {.type = UI_NUMBER, .col = 8, .row = 2, .width = 4, .slot = SLOT_RAM_PEAK},
+    {.type = UI_LABEL, .col = 0, .row = 3, .text = text_free},
+    {.type = UI_NUMBER, .col = 8, .row = 3, .width = 4, .slot = SLOT_RAM_FREE},
+    {.type = UI_CHOICE, .col = 0, .row = 4, .height = OLED_RAM_TASKS / 2, .slot = SLOT_RAM_INDEX, .text = text_digits},
+    {.type = UI_NUMBER, .col = 2, .row = 4, .width = 4, .height = OLED_RAM_TASKS / 2, .slot = SLOT_RAM_STACK},
+    {.type = UI_CHOICE, .col = 11, .row = 4, .height = OLED_RAM_TASKS / 2, .slot = SLOT_RAM_INDEX + OLED_RAM_TASKS / 2, .text = text_digits},
+    {.type = UI_NUMBER, .col = 13, .row = 4, .width = 4, .height = OLED_RAM_TASKS / 2, .slot = SLOT_RAM_STACK + OLED_RAM_TASKS / 2},
+};
+
+// The first task that is shown
+uint8_t oled_ram_first;
 
-    // Write the top row text
-    oled_write_num_fixed(freq, 4, 1, 0, 1);
-    oled_write_num_fixed(rssi, 2, 128-6*2, 0, 1);
-    oled_write_text(OLED_M OLED_H OLED_z, 27, 0, 1);
-    oled_write_text(OLED_R OLED_S OLED_S OLED_I, 89, 0, 1);
+/* Finding the peak of the stack walks through the free
+ * RAM, so the page is only updated once per second.
+ */
+void _oled_update_ram(const rx_state_t *state) {
+    (void)state;
+    if (oled_page_runs % OLED_REFRESH_HZ) return;
+
+    ui_set(SLOT_RAM_STATIC, ram_static());
+    ui_set(SLOT_RAM_PEAK, ram_stack_peak());
+    ui_set(SLOT_RAM_FREE, ram_stack_free());
+
+    uint8_t count = 0;
+    while (rtos_get_stats(count)) count++;
 
-    // Write the channel numbers
-    for (int i = 1; i < 9; i++) {
-        oled_write_num_fixed(i, 1, 12 + 12*i, 1, 0);
+    if (oled_page_runs == 0) {
+        oled_ram_first = 0;
+    } else if (oled_page_runs % OLED_RAM_FLIP_RUNS == 0) {
+        oled_ram_first += OLED_RAM_TASKS;
+        if (oled_ram_first >= count) oled_ram_first = 0;
     }
+    uint8_t first = oled_ram_first;
+    if (count > OLED_RAM_TASKS && first > count - OLED_RAM_TASKS) first = count - OLED_RAM_TASKS;
 
-    // Write the band letters
-    char *channel_letters[] = {OLED_A,OLED_B,OLED_E,OLED_F,OLED_R,0};
-    for (int i = 0; channel_letters[i] != 0; i++) {
-        oled_write_text(channel_letters[i], 12, 2+i, 0);
+    for (uint8_t i = 0; i < OLED_RAM_TASKS; i++) {
+        const rtos_stats_t *stats = rtos_get_stats(first + i);
+        uint8_t slot = (i & 1) * (OLED_RAM_TASKS / 2) + i / 2;
+        ui_set(SLOT_RAM_INDEX + slot, stats ? first + i : UI_NONE);
+        ui_set(SLOT_RAM_STACK + slot, stats ? stats->stack : 0);
     }
+}
 
-    // Write the square grid
-    for (int x = 0; x < 8; x++) {
-        for (int y = 0; y < 5; y++) {
-            if (x == 2 && y == 4) {
-                oled_write_symbol(OLED_LARGE_DOT, 24 + 12*x, 2 + y, 0);
-                continue;
-            }
-            oled_write_symbol(OLED_SMALL_DOT, 24 + 12*x, 2 + y, 0);
-        }
+/* The spectrum page with the band and the frequency of the
+ * strongest bin in the top row. The rows below are reserved,
+ * the spectrum task draws a bar per bin there.
+ */
+#define SPECTRUM_ROWS       0xFE    // All but the top row
+#define SPECTRUM_HEIGHT     ((OLED_TILE_ROWS - 1) * 8)
+#define SPECTRUM_BAR_WIDTH  2
+
+#define SLOT_SPECTRUM_LOW   0
+#define SLOT_SPECTRUM_PEAK  1
+#define SLOT_SPECTRUM_HIGH  2
+
+const ui_widget_t page_spectrum[] PROGMEM = {
+    {.type = UI_NUMBER, .col = 0, .row = 0, .width = 4, .slot = SLOT_SPECTRUM_LOW, .flags = UI_INVERT},
+    {.type = UI_LABEL, .col = 4, .row = 0, .width = 2, .flags = UI_INVERT, .text = text_blank},
+    {.type = UI_NUMBER, .col = 6, .row = 0, .width = 4, .slot = SLOT_SPECTRUM_PEAK, .flags = UI_INVERT},
+    {.type = UI_LABEL, .col = 10, .row = 0, .width = 7, .flags = UI_INVERT, .text = text_scan_mhz},
+    {.type = UI_NUMBER, .col = 17, .row = 0, .width = 4, .slot = SLOT_SPECTRUM_HIGH, .flags = UI_INVERT},
+};
+
+// The height of every bar on the display, 0xFF if it isn't known
+uint8_t spectrum_drawn[SPECTRUM_BINS];
+
+void _oled_update_spectrum(const rx_state_t *state) {
+    (void)state;
+    ui_set(SLOT_SPECTRUM_LOW, SPECTRUM_FREQ_LOW);
+    ui_set(SLOT_SPECTRUM_PEAK, spectrum_freq(spectrum_peak()));
+    ui_set(SLOT_SPECTRUM_HIGH, SPECTRUM_FREQ_HIGH);
+}
+
+/* This function is used internally to have every bar of
+ * the spectrum drawn again, as its bin is measured.
+ */
+void _spectrum_invalidate(void) {
+    for (uint8_t bin = 0; bin < SPECTRUM_BINS; bin++) spectrum_drawn[bin] = 0xFF;
+}
+
+/* The lap timer page with the number of laps and the
+ * filtered RSSI in the top row, the last and the best lap,
+ * a bar of the RSSI and the newest OLED_LAPS_SHOWN laps.
+ * The times are in seconds and milliseconds.
+ */
+#define OLED_LAPS_SHOWN     4
+
+#define SLOT_LAPS_COUNT     0
+#define SLOT_LAPS_RSSI      1
+#define SLOT_LAPS_SECONDS   2   // Last, best, then the newest laps
+#define SLOT_LAPS_MS        (SLOT_LAPS_SECONDS + 2 + OLED_LAPS_SHOWN)
+#define SLOT_LAPS_NUMBER    (SLOT_LAPS_MS + 2 + OLED_LAPS_SHOWN)
+
+const ui_widget_t page_laps[] PROGMEM = {
+    {.type = UI_LABEL, .col = 0, .row = 0, .width = 5, .flags = UI_INVERT, .text = text_laps},
+    {.type = UI_NUMBER, .col = 5, .row = 0, .width = 3, .slot = SLOT_LAPS_COUNT, .flags = UI_INVERT, .max = 999},
+    {.type = UI_LABEL, .col = 8, .row = 0, .width = 4, .flags = UI_INVERT, .text = text_blank},
+    {.type = UI_LABEL, .col = 12, .row = 0, .width = 7, .flags = UI_INVERT, .text = text_rssi},
+    {.type = UI_NUMBER, .col = 19, .row = 0, .width = 2, .slot = SLOT_LAPS_RSSI, .flags = UI_INVERT},
+    {.type = UI_LABEL, .col = 0, .row = 1, .text = text_last},
+    {.type = UI_LABEL, .col = 0, .row = 2, .text = text_best},
+    {.type = UI_NUMBER, .col = 6, .row = 1, .width = 3, .height = 2, .slot = SLOT_LAPS_SECONDS, .max = 999},
+    {.type = UI_LABEL, .col = 9, .row = 1, .text = text_point},
+    {.type = UI_LABEL, .col = 9, .row = 2, .text = text_point},
+    {.type = UI_NUMBER, .col = 10, .row = 1, .width = 3, .height = 2, .slot = SLOT_LAPS_MS},
+    {.type = UI_BAR, .col = 0, .row = 3, .width = OLED_TILE_COLS, .slot = SLOT_LAPS_RSSI, .max = 99},
+    {.type = UI_NUMBER, .col = 0, .row = 4, .width = 3, .height = OLED_LAPS_SHOWN, .slot = SLOT_LAPS_NUMBER, .max = 999},
+    {.type = UI_NUMBER, .col = 6, .row = 4, .width = 3, .height = OLED_LAPS_SHOWN, .slot = SLOT_LAPS_SECONDS + 2, .max = 999},
+    {.type = UI_LABEL, .col = 9, .row = 4, .text = text_point},
+    {.type = UI_LABEL, .col = 9, .row = 5, .text = text_point},
+    {.type = UI_LABEL, .col = 9, .row = 6, .text = text_point},
+    {.type = UI_LABEL, .col = 9, .row = 7, .text = text_point},
+    {.type = UI_NUMBER, .col = 10, .row = 4, .width = 3, .height = OLED_LAPS_SHOWN, .slot = SLOT_LAPS_MS + 2},
+};
+
+/* This function is used internally to show a time in us
+ * in the i-th seconds and milliseconds slots.
+ */
+void _laps_show(uint8_t i, uint32_t us) {
+    uint32_t ms = (us + 500) / 1000;
+    ui_set(SLOT_LAPS_SECONDS + i, ms / 1000);
+    ui_set(SLOT_LAPS_MS + i, ms % 1000);
+}
+
+void _oled_update_laps(const rx_state_t *state) {
+    (void)state;
+    uint16_t count = laps_count();
+    ui_set(SLOT_LAPS_COUNT, count);
+    ui_set(SLOT_LAPS_RSSI, laps_rssi());
+    _laps_show(0, laps_time(0));
+    _laps_show(1, laps_best());
+    for (uint8_t i = 0; i < OLED_LAPS_SHOWN; i++) {
+        ui_set(SLOT_LAPS_NUMBER + i, count > i ? count - i : 0);
+        _laps_show(2 + i, laps_time(i));
     }
+}
+
+/* The pilots page, a table of the pilots in two columns
+ * with their channel, filtered RSSI and a ! while their
+ * signal is lost. The top row has how many times per second
+ * every pilot is read, the arrow marks the pilot whose
+ * channel the buttons change.
+ */
+#define SLOT_PILOTS_RATE    0
+#define SLOT_PILOTS_CURSOR  1
+#define SLOT_PILOTS_BAND    (SLOT_PILOTS_CURSOR + PILOTS_MAX)
+#define SLOT_PILOTS_CHANNEL (SLOT_PILOTS_BAND + PILOTS_MAX)
+#define SLOT_PILOTS_RSSI    (SLOT_PILOTS_CHANNEL + PILOTS_MAX)
+#define SLOT_PILOTS_LOST    (SLOT_PILOTS_RSSI + PILOTS_MAX)
 
-    // Write the arrows
-    char *arrow_symbols[] = {OLED_LEFT,OLED_RIGHT,OLED_UP,OLED_DOWN,0};
-    for (int i = 0; arrow_symbols[i] != 0; i++) {
-        oled_write_symbol(arrow_symbols[i], 6 + 36*i, 7, 0);
+// Half of the pilots in every column
+#define PILOTS_ROWS         (PILOTS_MAX / 2)
+
+const ui_widget_t page_pilots[] PROGMEM = {
+    {.type = UI_LABEL, .col = 0, .row = 0, .width = 15, .flags = UI_INVERT, .text = text_pilots},
+    {.type = UI_NUMBER, .col = 15, .row = 0, .width = 3, .slot = SLOT_PILOTS_RATE, .flags = UI_INVERT, .max = 999},
+    {.type = UI_LABEL, .col = 18, .row = 0, .width = 3, .flags = UI_INVERT, .text = text_hz},
+    {.type = UI_CHOICE, .col = 0, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_CURSOR, .text = text_cursor},
+    {.type = UI_CHOICE, .col = 1, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_BAND, .text = channel_band_letters},
+    {.type = UI_CHOICE, .col = 2, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_CHANNEL, .text = text_channels},
+    {.type = UI_NUMBER, .col = 4, .row = 2, .width = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_RSSI},
+    {.type = UI_CHOICE, .col = 7, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_LOST, .text = text_lost},
+    {.type = UI_CHOICE, .col = 11, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_CURSOR + PILOTS_ROWS, .text = text_cursor},
+    {.type = UI_CHOICE, .col = 12, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_BAND + PILOTS_ROWS, .text = channel_band_letters},
+    {.type = UI_CHOICE, .col = 13, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_CHANNEL + PILOTS_ROWS, .text = text_channels},
+    {.type = UI_NUMBER, .col = 15, .row = 2, .width = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_RSSI + PILOTS_ROWS},
+    {.type = UI_CHOICE, .col = 18, .row = 2, .height = PILOTS_ROWS, .slot = SLOT_PILOTS_LOST + PILOTS_ROWS, .text = text_lost},
+    {.type = UI_LABEL, .col = 1, .row = 7, .text = text_pilots_help},
+};
+
+// The pilot whose channel the buttons change
+uint8_t pilots_cursor = 0;
+
+void _oled_update_pilots(const rx_state_t *state) {
+    (void)state;
+    uint16_t cycle = pilots_cycle_ms();
+    ui_set(SLOT_PILOTS_RATE, cycle ? (1000 + cycle / 2) / cycle : 0);
+
+    for (uint8_t i = 0; i < PILOTS_MAX; i++) {
+        uint8_t index = pilots_channel(i);
+        ui_set(SLOT_PILOTS_CURSOR + i, i == pilots_cursor);
+        ui_set(SLOT_PILOTS_BAND + i, index != PILOTS_NONE ? index / CHANNEL_PER_BAND : UI_NONE);
+        ui_set(SLOT_PILOTS_CHANNEL + i, index != PILOTS_NONE ? index % CHANNEL_PER_BAND : UI_NONE);
+        ui_set(SLOT_PILOTS_RSSI + i, pilots_rssi(i));
+        ui_set(SLOT_PILOTS_LOST + i, index != PILOTS_NONE && pilots_lost(i));
     }
 }
 
-void driver_oled() {
-    static uint8_t old_rx_band = 0;
-    static uint8_t old_rx_channel = 0;
-    static uint8_t old_rssi = 0;
+/* The pages in the order of OLED_PAGE_, with the function
+ * that sets the values of their widgets on every run. The
+ * pages that don't show the state ignore it.
+ */
+typedef void (* oled_update_t)(const rx_state_t *state);
+
+typedef struct oled_page {
+    const ui_widget_t *widgets;
+    uint8_t count;
+    oled_update_t update;
+} oled_page_t;
+
+const oled_page_t oled_pages[OLED_PAGES] PROGMEM = {
+    {page_main, UI_COUNT(page_main), _oled_update_main},
+    {page_scan, UI_COUNT(page_scan), _oled_update_scan},
+    {page_stats, UI_COUNT(page_stats), _oled_update_stats},
+    {page_settings, UI_COUNT(page_settings), _oled_update_settings},
+    {page_ram, UI_COUNT(page_ram), _oled_update_ram},
+    {page_spectrum, UI_COUNT(page_spectrum), _oled_update_spectrum},
+    {page_laps, UI_COUNT(page_laps), _oled_update_laps},
+    {page_pilots, UI_COUNT(page_pilots), _oled_update_pilots},
+};
+
+/* This function is used internally to draw the page that
+ * is selected in the state into the tile map. Only the
+ * widgets whose values changed are drawn, or the whole page
+ * after a switch.
+ */
+void _oled_draw(const rx_state_t *state) {
+    const oled_page_t *page = &oled_pages[state->page < OLED_PAGES ? state->page : OLED_PAGE_MAIN];
 
-    uint8_t error = 0;
-    if (rx_band != old_rx_band || rx_channel != old_rx_channel) {
-        error |= oled_write_num_fixed(freq, 4, 1, 0, 1);
-        error |= oled_write_symbol(OLED_SMALL_DOT, 24 + 12*old_rx_channel, 2 + old_rx_band, 0);
-        error |= oled_write_symbol(OLED_LARGE_DOT, 24 + 12*rx_channel, 2 + rx_band, 0);
-        old_rx_band = rx_band;
-        old_rx_channel = rx_channel;
+    if (state->page != oled_page) {
+        // The spectrum draws its bars past the tile map.
+        oled_tile_reserve(state->page == OLED_PAGE_SPECTRUM ? SPECTRUM_ROWS : 0);
+        _spectrum_invalidate();
+        oled_page = state->page;
+        oled_page_runs = 0;
+        ui_show((const ui_widget_t *)pgm_read_ptr(&page->widgets), pgm_read_byte(&page->count));
     }
-    if (rssi != old_rssi) {
-        error |= oled_write_num_fixed(rssi, 2, 128-6*2, 0, 1);
-        old_rssi = rssi;
+
+    ((oled_update_t)pgm_read_ptr(&page->update))(state);
+    oled_page_runs = oled_page_runs < OLED_PAGE_RUNS_WRAP ? oled_page_runs + 1 : 1;
+    ui_render();
+}
+
+/* This function is used internally to look for the display
+ * while it is missing. Every OLED_PROBE_MS its configuration
+ * is queued, and if that went through by the next run, the
+ * display is back. Its RAM holds garbage then, so the edge
+ * columns are drawn and the whole tile map is sent again.
+ * It returns 1 once the display is back.
+ */
+uint8_t _oled_probe(void) {
+    if (oled_probing) {
+        oled_probing = 0;
+        if (i2c_busy() || oled_async_error()) return 0;
+
+        oled_online = 1;
+        oled_errors = 0;
+        // The edge columns are outside of the tile map, the top row is a bar.
+        oled_fill_region_async(0, 0, 0, 0, 0xFF);
+        oled_fill_region_async(0, 0, 1, OLED_TILE_ROWS - 1, 0);
+        oled_fill_region_async(127, 127, 0, 0, 0xFF);
+        oled_fill_region_async(127, 127, 1, OLED_TILE_ROWS - 1, 0);
+        oled_tile_invalidate();
+        _spectrum_invalidate();
+        return 1;
     }
 
-    // Cause an error if any write commands failed.
-    if (error) _delay_ms(1000);
+    if (--oled_probe_countdown) return 0;
+    oled_probe_countdown = (uint32_t)OLED_PROBE_MS * OLED_REFRESH_HZ / 1000;
+    // Forget the errors of the writes before.
+    oled_async_error();
+    if (oled_init_async() == 0) oled_probing = 1;
+    return 0;
+}
+
+/* The display is initialized with the blocking functions,
+ * before the RTOS runs. If it doesn't answer, the receiver
+ * starts without it.
+ */
+void init_oled() {
+    _subscribe(&oled_events, STATE_EVENT_ALL, &task_oled);
+    uint8_t error = oled_init() || oled_clear();
+
+    state_read(&oled_state);
+    _oled_draw(&oled_state);
+    if (error) return;
+
+    // The edge columns of the top row are outside of the tile map.
+    oled_fill_region(0, 0, 0, 0, 0xFF);
+    oled_fill_region(127, 127, 0, 0, 0xFF);
+
+    if (oled_flush()) return;
+
+    // Only show the screen once it is completely drawn.
+    if (oled_display_on()) return;
+    oled_online = 1;
+}
+
+void driver_oled() {
+    // Abort the transfer if the I2C engine got stuck.
+    i2c_poll();
+
+    if (!oled_online && !_oled_probe()) return;
+
+    // The copy of the state is only read again when it changed.
+    uint8_t events = 0;
+    uint8_t event;
+    while ((event = state_get_event(&oled_events))) events |= event;
+    if (events) state_read(&oled_state);
+    _oled_draw(&oled_state);
+
+    // Give up on the display after a few runs with failed writes.
+    if (!oled_async_error()) {
+        oled_errors = 0;
+    } else if (++oled_errors >= OLED_MAX_ERRORS) {
+        oled_online = 0;
+        oled_probe_countdown = 1;
+        return;
+    }
+
+    /* The tiles are only queued here, the I2C interrupt sends
+     * them in the background. Tiles that don't fit into the
+     * queue stay dirty until the next flush.
+     */
+    if (oled_flush_async()) return;
+
+    /* The main page only shows the state, so once it is sent
+     * there is nothing to do until the next event. The scan and
+     * the diversity switch change it without one.
+     */
+    if (oled_state.page == OLED_PAGE_MAIN && VIDEO_RX_COUNT == 1 && !scan_running()) {
+        rtos_suspend(&task_oled);
+    }
 }
 
 
 /* This task is responsible for reading the buttons
- * and updating the bandplan position and the frequency.
+ * and updating the channel position and the frequency.
+ * It is suspended while no button is down, the pin
+ * change interrupt resumes it.
  */
 rtos_task_t task_buttons = {
     .init = init_buttons,
-    .driver = driver_buttons
+    .driver = driver_buttons,
+    .period = 1,
+    .priority = 0,
+    .wcet_us = 100
 };
 
+/* This function is used internally to resume the task
+ * from the pin change interrupt.
+ */
+void _buttons_wakeup(void) {
+    rtos_resume(&task_buttons);
+}
+
 void init_buttons() {
-    buttons_init();
+    buttons_init(_buttons_wakeup);
 }
 
-void driver_buttons() {
-    uint8_t button_press = buttons_get_press();
-    if (button_press & 1) rx_channel = rx_channel > 0 ? rx_channel - 1 : 7;
-    if (button_press & 2) rx_channel = rx_channel < 7 ? rx_channel + 1 : 0;
-    if (button_press & 4) rx_band = rx_band > 0 ? rx_band - 1 : 4;
-    if (button_press & 8) rx_band = rx_band < 4 ? rx_band + 1 : 0;
+/* This function is used internally to change the pilots
+ * with the buttons. Up and down select a pilot, left and right
+ * step its channel through the channel database by frequency,
+ * with an empty slot past both ends.
+ */
+void _pilots_step(uint8_t button) {
+    if (button & BUTTON_UP) pilots_cursor = pilots_cursor > 0 ? pilots_cursor - 1 : PILOTS_MAX - 1;
+    if (button & BUTTON_DOWN) pilots_cursor = pilots_cursor < PILOTS_MAX - 1 ? pilots_cursor + 1 : 0;
+    if (!(button & (BUTTON_LEFT | BUTTON_RIGHT))) return;
 
-    freq = bandplan[rx_band][rx_channel];
+    // The position in frequency order, CHANNEL_COUNT for none
+    uint8_t index = pilots_channel(pilots_cursor);
+    uint8_t n = 0;
+    while (n < CHANNEL_COUNT && channel_nth(n) != index) n++;
 
+    if (button & BUTTON_RIGHT) n = n < CHANNEL_COUNT ? n + 1 : 0;
+    else n = n > 0 ? n - 1 : CHANNEL_COUNT;
+    pilots_set_channel(pilots_cursor, n < CHANNEL_COUNT ? channel_nth(n) : PILOTS_NONE);
+}
+
+/* This function is used internally to move through the
+ * channel database in the direction of the button. Left and
+ * right go to the channel with the next lower or higher
+ * frequency, in whatever band it is, up and down go to the
+ * same channel of the band above or below. On the pilots
+ * page the buttons change the pilots instead.
+ */
+void _channel_step(uint8_t button) {
+    rx_state_t state;
+    state_read(&state);
+
+    if (state.page == OLED_PAGE_PILOTS) {
+        _pilots_step(button);
+        return;
+    }
+
+    if (button & (BUTTON_LEFT | BUTTON_RIGHT)) {
+        uint8_t index = channel_next(state.freq, (button & BUTTON_LEFT) ? -1 : 1);
+        state_set_position(index / CHANNEL_PER_BAND, index % CHANNEL_PER_BAND, channel_freq(index));
+        return;
+    }
+
+    int8_t band = state.band;
+    int8_t channel = state.channel;
+
+    // Leave a custom frequency at the current grid position.
+    if (band < 0) band = 0;
+
+    if (button & BUTTON_UP) band = band > 0 ? band - 1 : CHANNEL_BANDS - 1;
+    if (button & BUTTON_DOWN) band = band < CHANNEL_BANDS - 1 ? band + 1 : 0;
+
+    state_set_position(band, channel, channel_freq(CHANNEL_INDEX(band, channel)));
+}
+
+/* This function is used internally to handle a button
+ * press, state holds all the buttons that are down.
+ */
+void _button_press(uint8_t button, uint8_t state) {
+    // Any button cancels a running scan.
+    if (scan_running()) {
+        _cancel_scan();
+        return;
+    }
+
+    // Left and right together start a scan of all channels.
+    if (state == (BUTTON_LEFT | BUTTON_RIGHT)) {
+        _start_scan(0, 0);
+        return;
+    }
+
+    // Up and down together switch to the next page.
+    if (state == (BUTTON_UP | BUTTON_DOWN)) {
+        rx_state_t rx_state;
+        state_read(&rx_state);
+        state_set_page(rx_state.page + 1 < OLED_PAGES ? rx_state.page + 1 : OLED_PAGE_MAIN);
+        return;
+    }
+
+    _channel_step(button);
+
+#if WATCHDOG_TEST
     /* If all buttons are pressed, create a 1 second delay
-     * to test the RTOS error state.
+     * to test the recovery, the watchdog resets the receiver
+     * back onto the same channel.
      */
-    if (buttons_get_state() == 0xf) _delay_ms(1000);
+    if (state == 0xf) _delay_ms(1000);
+#endif
+}
+
+void driver_buttons() {
+    buttons_update();
+
+    button_event_t event;
+    while (buttons_get_event(&event)) {
+        trace_event(TRACE_BUTTON_EVENT, (event.type << 4) | event.button);
+        if (event.type == BUTTON_EVENT_PRESS) {
+            _button_press(event.button, event.state);
+        } else if (event.type == BUTTON_EVENT_REPEAT && !scan_running()) {
+            _channel_step(event.button);
+        }
+    }
+
+    // Sleep until the next edge once everything is settled.
+    cli();
+    if (buttons_idle()) rtos_suspend(&task_buttons);
+    sei();
+}
+
+
+/* This task runs the automatic scan. It advances the
+ * scan state machine and once the scan is done, it locks
+ * onto the strongest channel that was found. It is
+ * suspended while no scan is running.
+ */
+rtos_task_t task_scan = {
+    .init = init_scan,
+    .driver = driver_scan,
+    .period = 1,
+    .priority = 3,
+    .wcet_us = 100
+};
+
+void init_scan() {
+}
+
+void driver_scan() {
+    uint8_t step = scan_step();
+    // Nothing to do until the next scan is started.
+    if (step == SCAN_IDLE) rtos_suspend(&task_scan);
+    if (step != SCAN_DONE) return;
+
+    const scan_result_t *best = scan_get_result(0);
+    if (best) _select_frequency(best->freq);
+    // The RX was left on the last scanned channel.
+    state_publish(STATE_EVENT_RETUNE);
+}
+
+
+/* This task runs the spectrum analyzer while its page is
+ * shown. Every run that measured a bin (spectrum.h) draws the
+ * bar of the bin straight to the display, and only the part of
+ * the bar that changed is sent. The sweep tunes the RX away, so
+ * there is no video on this page, the RX is tuned back once
+ * the page is left. A scan stops the sweep until it is done.
+ * The task is suspended on the other pages, the page event
+ * resumes it.
+ */
+rtos_task_t task_spectrum = {
+    .init = init_spectrum,
+    .driver = driver_spectrum,
+    .period = 1,
+    .priority = 3,
+    .wcet_us = 300
+};
+
+state_queue_t spectrum_events;
+
+void init_spectrum() {
+    _subscribe(&spectrum_events, STATE_EVENT_PAGE, &task_spectrum);
+}
+
+void driver_spectrum() {
+    while (state_get_event(&spectrum_events));
+
+    rx_state_t state;
+    state_read(&state);
+    if (state.page != OLED_PAGE_SPECTRUM || scan_running()) {
+        if (spectrum_running()) {
+            spectrum_stop();
+            // The scan retunes the RX when it is done.
+            if (!scan_running()) state_publish(STATE_EVENT_RETUNE);
+        }
+        // Nothing to do until the page is shown again.
+        if (state.page != OLED_PAGE_SPECTRUM) rtos_suspend(&task_spectrum);
+        return;
+    }
+
+    if (!spectrum_running()) {
+        // The sweep tunes the RX away.
+        _retain(&state, 0);
+        spectrum_start();
+    }
+
+    uint8_t bin = spectrum_step();
+    if (bin == SPECTRUM_NONE || !oled_online) return;
+
+    uint8_t height = (uint16_t)spectrum_level(bin) * SPECTRUM_HEIGHT / 99;
+    uint8_t x = OLED_TILE_X0 + bin * SPECTRUM_BAR_WIDTH;
+    // A bar that doesn't fit into the queue is drawn in the next sweep.
+    if (oled_bar_async(x, x + SPECTRUM_BAR_WIDTH - 1, 1, OLED_TILE_ROWS - 1, height, spectrum_drawn[bin]) == 0) {
+        spectrum_drawn[bin] = height;
+    }
+}
+
+
+/* This task watches the pilots (pilots.h) while their page
+ * is shown. It hops the RX through their channels and reads
+ * one of them per hop, the OLED task shows the readings. Like
+ * the sweep, the hopping leaves no video on this page, the RX
+ * is tuned back once the page is left, and a scan stops it
+ * until it is done. The task is suspended on the other pages.
+ */
+rtos_task_t task_pilots = {
+    .init = init_pilots,
+    .driver = driver_pilots,
+    .period = 1,
+    .priority = 3,
+    .wcet_us = 200
+};
+
+state_queue_t pilots_events;
+
+void init_pilots() {
+    _subscribe(&pilots_events, STATE_EVENT_PAGE, &task_pilots);
+}
+
+void driver_pilots() {
+    while (state_get_event(&pilots_events));
+
+    rx_state_t state;
+    state_read(&state);
+    if (state.page != OLED_PAGE_PILOTS || scan_running()) {
+        if (pilots_running()) {
+            pilots_stop();
+            // The scan retunes the RX when it is done.
+            if (!scan_running()) state_publish(STATE_EVENT_RETUNE);
+        }
+        // Nothing to do until the page is shown again.
+        if (state.page != OLED_PAGE_PILOTS) rtos_suspend(&task_pilots);
+        return;
+    }
+
+    if (!pilots_running()) {
+        // The hopping tunes the RX away.
+        _retain(&state, 0);
+        pilots_start();
+    }
+    pilots_step();
+}
+
+
+/* This task is responsible for saving the position in the
+ * channel database and the frequency, so they survive a
+ * power cycle.
+ * A change is saved once it has been left alone for
+ * SETTINGS_SAVE_DELAY_MS, so browsing through channels doesn't
+ * wear out the EEPROM. The write itself runs in the background.
+ */
+#define SETTINGS_SAVE_DELAY_MS 2000
+
+rtos_task_t task_settings = {
+    .init = init_settings,
+    .driver = driver_settings,
+    .period = 100000UL / RTOS_SLICE_US,
+    .priority = 5,
+    .wcet_us = 100
+};
+
+state_queue_t settings_events;
+
+// The settings that are waiting to be saved
+settings_t last_settings;
+uint8_t settings_countdown = 0;
+
+void init_settings() {
+    // The restored settings don't need to be saved again.
+    _subscribe(&settings_events, STATE_EVENT_FREQ | STATE_EVENT_POSITION, 0);
+
+    // Unless they were retained over a watchdog reset before they were saved.
+    rx_state_t state;
+    state_read(&state);
+    settings_t saved;
+    if (watchdog_recovered() && (settings_load(&saved) || saved.band != state.band ||
+            saved.channel != state.channel || saved.freq != state.freq)) {
+        last_settings.band = state.band;
+        last_settings.channel = state.channel;
+        last_settings.freq = state.freq;
+        settings_countdown = SETTINGS_SAVE_DELAY_MS / 100;
+    }
+}
+
+void driver_settings() {
+    // The scan changes the frequency on its own.
+    if (scan_running()) return;
+
+    uint8_t changed = 0;
+    while (state_get_event(&settings_events)) changed = 1;
+    if (changed) {
+        rx_state_t state;
+        state_read(&state);
+        last_settings.band = state.band;
+        last_settings.channel = state.channel;
+        last_settings.freq = state.freq;
+        settings_countdown = SETTINGS_SAVE_DELAY_MS / 100;
+        return;
+    }
+
+    if (settings_countdown == 0) return;
+    // Try again on the next run if the last record is still being written.
+    if (--settings_countdown == 0 && settings_save(&last_settings)) settings_countdown = 1;
+}
+
+
+/* This task is responsible for the telemetry over the
+ * UART. It runs the commands from the host and sends the
+ * status and the task statistics, if they are streamed.
+ * Frames that don't fit into the UART buffer are dropped,
+ * so the task never waits for the UART.
+ */
+#define TELEMETRY_STATUS_MS 100
+#define TELEMETRY_STATS_MS  1000
+
+rtos_task_t task_telemetry = {
+    .init = init_telemetry,
+    .driver = driver_telemetry,
+    .period = 10000UL / RTOS_SLICE_US,
+    .priority = 5,
+    .wcet_us = 600,
+    .overrun = RTOS_OVERRUN_SHED
+};
+
+/* The boot frame tells the host why the receiver was
+ * reset. It is sent as soon as interrupts are enabled.
+ */
+void init_telemetry() {
+    uart_init();
+
+    uint8_t payload[2];
+    payload[0] = watchdog_reset_flags();
+    payload[1] = watchdog_resets();
+    telemetry_send(TELEMETRY_BOOT, payload, 2);
+}
+
+/* This function is used internally to put a 16-bit
+ * value into a payload.
+ */
+void _put_u16(uint8_t *payload, uint16_t value) {
+    payload[0] = value & 0xFF;
+    payload[1] = value >> 8;
+}
+
+/* This function is used internally to run a command
+ * from the host.
+ */
+void _telemetry_command(uint8_t type, const uint8_t *payload, uint8_t length) {
+    uint8_t reply[5];
+    uint8_t result = TELEMETRY_OK;
+
+    if (type == TELEMETRY_CMD_TUNE && length == 4) {
+        int8_t band = payload[0];
+        int8_t channel = payload[1];
+        uint16_t freq = payload[2] | (payload[3] << 8);
+        if (_check_position(band, channel, &freq)) {
+            result = TELEMETRY_INVALID;
+        } else {
+            if (scan_running()) _cancel_scan();
+            // A custom frequency on a channel selects the channel.
+            if (band < 0) _select_frequency(freq);
+            else state_set_position(band, channel, freq);
+        }
+    } else if (type == TELEMETRY_CMD_SCAN && length == 0) {
+        if (!scan_running()) _start_scan(0, 0);
+    } else if (type == TELEMETRY_CMD_SCAN && length == 4) {
+        uint16_t low = payload[0] | (payload[1] << 8);
+        uint16_t high = payload[2] | (payload[3] << 8);
+        if (low > high || _check_position(-1, 0, &low) || _check_position(-1, 0, &high)) {
+            result = TELEMETRY_INVALID;
+        } else {
+            if (scan_running()) scan_cancel();
+            _start_scan(low, high);
+        }
+    } else if (type == TELEMETRY_CMD_SETTINGS && length == 0) {
+        // Without a saved record the position is sent as zeros.
+        settings_t settings = {0};
+        reply[0] = settings_load(&settings);
+        reply[1] = settings.band;
+        reply[2] = settings.channel;
+        _put_u16(&reply[3], settings.freq);
+        telemetry_send(TELEMETRY_SETTINGS, reply, 5);
+        return;
+    } else if (type == TELEMETRY_CMD_STREAM && length == 1) {
+        telemetry_streams = payload[0];
+    } else if (type == TELEMETRY_CMD_TRACE && length == 0) {
+        telemetry_trace_next = 0;
+    } else if (type == TELEMETRY_CMD_LAPS && length == 5) {
+        laps_config_t config;
+        config.enter = payload[0];
+        config.exit = payload[1];
+        config.filter = payload[2];
+        config.min_lap_ms = payload[3] | (payload[4] << 8);
+        if (laps_configure(&config)) result = TELEMETRY_INVALID;
+    } else if (type == TELEMETRY_CMD_PILOTS && length == PILOTS_MAX) {
+        for (uint8_t i = 0; i < PILOTS_MAX; i++) {
+            if (payload[i] >= CHANNEL_COUNT && payload[i] != PILOTS_NONE) result = TELEMETRY_INVALID;
+        }
+        for (uint8_t i = 0; i < PILOTS_MAX && result == TELEMETRY_OK; i++) pilots_set_channel(i, payload[i]);
+    } else {
+        result = TELEMETRY_UNKNOWN;
+    }
+
+    reply[0] = type;
+    reply[1] = result;
+    telemetry_send(TELEMETRY_ACK, reply, 2);
+}
+
+/* This function is used internally to send the status.
+ */
+void _telemetry_status(void) {
+    rx_state_t state;
+    state_read(&state);
+
+    uint8_t payload[10];
+    _put_u16(&payload[0], scan_running() ? scan_current_freq() : state.freq);
+    payload[2] = state.band;
+    payload[3] = state.channel;
+    payload[4] = state.rssi;
+    payload[5] = video_rx_active();
+    payload[6] = scan_running();
+    payload[7] = oled_online;
+    _put_u16(&payload[8], video_rx_switches());
+    telemetry_send(TELEMETRY_STATUS, payload, 10);
+}
+
+/* This function is used internally to send the statistics
+ * of the i-th task. It returns 1 if there is no such task.
+ */
+uint8_t _telemetry_stats(uint8_t i) {
+    const rtos_stats_t *stats = rtos_get_stats(i);
+    if (!stats) return 1;
+
+    uint8_t payload[11];
+    payload[0] = i;
+    _put_u16(&payload[1], stats->avg_us);
+    _put_u16(&payload[3], stats->max_us);
+    _put_u16(&payload[5], stats->load);
+    _put_u16(&payload[7], stats->overruns);
+    _put_u16(&payload[9], stats->misses);
+    telemetry_send(TELEMETRY_STATS, payload, 11);
+    return 0;
+}
+
+/* This function is used internally to send the trace
+ * entries from first on. It returns the next entry to send,
+ * or 0xFF once the whole trace was sent. An empty trace is
+ * a single frame without entries.
+ */
+uint8_t _telemetry_trace(uint8_t first) {
+    uint8_t payload[4 + TELEMETRY_TRACE_ENTRIES * 4];
+    trace_entry_t entries[TELEMETRY_TRACE_ENTRIES];
+
+    uint8_t count = trace_read(entries, first, TELEMETRY_TRACE_ENTRIES);
+    payload[0] = trace_number();
+    payload[1] = trace_count();
+    payload[2] = trace_open();
+    payload[3] = first;
+    for (uint8_t i = 0; i < count; i++) {
+        payload[4 + 4*i] = entries[i].event;
+        payload[5 + 4*i] = entries[i].arg;
+        _put_u16(&payload[6 + 4*i], entries[i].time);
+    }
+    telemetry_send(TELEMETRY_TRACE, payload, 4 + count * 4);
+
+    first += count;
+    return count == TELEMETRY_TRACE_ENTRIES && first < payload[1] ? first : 0xFF;
+}
+
+/* This function is used internally to send the readings
+ * of the pilots.
+ */
+void _telemetry_pilots(void) {
+    uint8_t payload[2 + 3 * PILOTS_MAX];
+    _put_u16(&payload[0], pilots_cycle_ms());
+    for (uint8_t i = 0; i < PILOTS_MAX; i++) {
+        payload[2 + 3*i] = pilots_channel(i);
+        payload[3 + 3*i] = pilots_rssi(i);
+        payload[4 + 3*i] = pilots_lost(i);
+    }
+    telemetry_send(TELEMETRY_PILOTS, payload, sizeof(payload));
+}
+
+/* This function is used internally to send the newest
+ * pass of the lap timer.
+ */
+void _telemetry_lap(void) {
+    laps_pass_t pass;
+    laps_last_pass(&pass);
+
+    uint8_t payload[11];
+    _put_u16(&payload[0], pass.lap);
+    _put_u16(&payload[2], pass.time_us & 0xFFFF);
+    _put_u16(&payload[4], pass.time_us >> 16);
+    _put_u16(&payload[6], pass.lap_us & 0xFFFF);
+    _put_u16(&payload[8], pass.lap_us >> 16);
+    payload[10] = pass.peak;
+    telemetry_send(TELEMETRY_LAP, payload, 11);
+}
+
+void driver_telemetry() {
+    static uint8_t status_countdown = 1;
+    static uint8_t stats_countdown = 1;
+    // The next task whose statistics are sent, 0xFF for none
+    static uint8_t stats_task = 0xFF;
+
+    uint8_t type;
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+    uint8_t length;
+    while (telemetry_receive(&type, payload, &length)) {
+        _telemetry_command(type, payload, length);
+    }
+
+    // The countdowns count the runs of the task.
+    uint8_t period_ms = task_telemetry.period * (RTOS_SLICE_US / 1000);
+    if (--status_countdown == 0) {
+        status_countdown = TELEMETRY_STATUS_MS / period_ms;
+        if (telemetry_streams & TELEMETRY_STREAM_STATUS) {
+            _telemetry_status();
+            if (pilots_running()) _telemetry_pilots();
+        }
+    }
+    if (--stats_countdown == 0) {
+        stats_countdown = TELEMETRY_STATS_MS / period_ms;
+        if (telemetry_streams & TELEMETRY_STREAM_STATS) stats_task = 0;
+    }
+    // One task per run keeps the bursts short.
+    if (stats_task != 0xFF && _telemetry_stats(stats_task++)) stats_task = 0xFF;
+    if (telemetry_trace_next != 0xFF) telemetry_trace_next = _telemetry_trace(telemetry_trace_next);
+
+    // A pass is sent once, the passes are seconds apart.
+    if (laps_passes() != telemetry_laps_sent) {
+        telemetry_laps_sent = laps_passes();
+        _telemetry_lap();
+    }
 }
 
 
 /* The list of tasks to be used by the RTOS.
+ * Periods are in RTOS slices, a lower priority
+ * number means a higher priority.
  */
 rtos_task_t *rtos_task_list[] = {
-    &task_rx_freq, &task_rx_rssi, &task_oled, &task_buttons
-, 0};
+    &task_rx_freq, &task_rx_rssi, &task_oled, &task_buttons, &task_scan,
+    &task_settings, &task_telemetry, &task_spectrum, &task_pilots, 0};
@@ -0,0 +1,199 @@
+#include "scan.h"
+#include "video_rx.h"
+#include "channels.h"
+#include "rtos.h"
+#include "hal.h"
+
+/* The scan is a state machine that is advanced by scan_step().
+ * Each call either waits for the receiver to settle, or takes
+ * the RSSI reading on the current channel and hops to the next
+ * one, so a call never blocks.
+ */
+uint8_t scan_state = SCAN_IDLE;
+
+/* Channel mode: the channel database, in the order of its
+ * frequency index (channels.h)
+ */
+uint8_t scan_channels;
+
+// Range mode: the frequency range in 2 MHz steps
+uint16_t scan_freq_low;
+
+uint8_t scan_count;         // Number of channels to visit
+uint8_t scan_position;      // Channel that is currently settling
+uint8_t scan_measured;      // Channels done so far
+uint16_t scan_freq;         // Its frequency
+uint16_t scan_tuned;        // Where the receiver is, 0 if not known
+uint32_t scan_hop_us;       // When the receiver was tuned to it
+uint16_t scan_settle_us;    // How long it needs to settle
+
+scan_result_t scan_results[SCAN_RESULTS];
+uint8_t scan_results_count;
+
+
+/* This function is used internally to get the frequency of
+ * the n-th channel of the scan.
+ */
+uint16_t _scan_freq_of(uint8_t n) {
+    if (scan_channels) return channel_freq(channel_nth(n));
+    return scan_freq_low + 2 * n;
+}
+
+/* This function is used internally to tune the receiver to
+ * the n-th channel and calculate its settle time. Odd channels
+ * are measured 1 MHz lower, like the pilots do, so no hop has to
+ * wait for the deferred SYN_REG_A write.
+ */
+void _scan_hop(uint8_t n) {
+    uint16_t freq = _scan_freq_of(n);
+    uint16_t tune = freq & ~1;
+    uint16_t jump = tune > scan_tuned ? tune - scan_tuned : scan_tuned - tune;
+
+    scan_position = n;
+    scan_freq = freq;
+    scan_hop_us = rtos_get_time_us();
+    // Channels 1 MHz apart share the reading.
+    if (jump == 0) {
+        scan_settle_us = 0;
+        return;
+    }
+
+    uint32_t settle_us = SCAN_SETTLE_BASE_US + (uint32_t)jump * SCAN_SETTLE_PER_MHZ_US;
+    if (settle_us > SCAN_SETTLE_MAX_US) settle_us = SCAN_SETTLE_MAX_US;
+
+    // The even channels have their SYN_REG_B write ready.
+    if (scan_channels && tune == freq) video_rx_set_word(channel_word(channel_nth(n)), tune);
+    else video_rx_set_frequency(tune);
+    scan_tuned = tune;
+    scan_settle_us = settle_us;
+}
+
+/* This function is used internally to insert a reading into
+ * the results, which are kept sorted from strongest down.
+ */
+void _scan_rank(uint16_t freq, uint8_t index, uint8_t rssi) {
+    uint8_t i = scan_results_count;
+    if (i == SCAN_RESULTS) {
+        if (rssi <= scan_results[SCAN_RESULTS - 1].rssi) return;
+        i--;
+    } else {
+        scan_results_count++;
+    }
+
+    // Shift the weaker results down to make room
+    while (i > 0 && scan_results[i - 1].rssi < rssi) {
+        scan_results[i] = scan_results[i - 1];
+        i--;
+    }
+    scan_results[i].freq = freq;
+    scan_results[i].index = index;
+    scan_results[i].rssi = rssi;
+}
+
+/* This function is used internally to start a scan once
+ * the channels to visit are known.
+ */
+void _scan_begin(void) {
+    scan_results_count = 0;
+    scan_measured = 0;
+    // The receiver can be anywhere, give it the longest settle time.
+    scan_tuned = 0;
+    _scan_hop(0);
+    scan_state = SCAN_RUNNING;
+}
+
+/* This function starts a scan of every channel in the
+ * database. The channels are visited in frequency order, which
+ * the database already has, and a frequency that is shared by
+ * several channels is only measured once. The results refer
+ * to the channel indices.
+ */
+void scan_start_channels(void) {
+    scan_channels = 1;
+    scan_count = CHANNEL_COUNT;
+    _scan_begin();
+}
+
+/* This function starts a scan of every frequency between
+ * freq_low and freq_high in 2 MHz steps, from the even
+ * frequency at or below freq_low.
+ */
+void scan_start_range(uint16_t freq_low, uint16_t freq_high) {
+    if (freq_high < freq_low) return;
+    freq_low &= ~1;
+    uint16_t count = (freq_high - freq_low) / 2 + 1;
+
+    scan_channels = 0;
+    scan_freq_low = freq_low;
+    scan_count = count > 0xFF ? 0xFF : count;
+    _scan_begin();
+}
+
+/* This function stops a running scan. The receiver stays
+ * on the last scanned frequency, so it must be retuned.
+ */
+void scan_cancel(void) {
+    scan_state = SCAN_IDLE;
+}
+
+/* This function advances the scan. It returns SCAN_RUNNING while
+ * the scan is in progress and SCAN_DONE once, when the last
+ * channel has been measured. After that it returns SCAN_IDLE.
+ */
+uint8_t scan_step(void) {
+    if (scan_state != SCAN_RUNNING) return SCAN_IDLE;
+
+    /* The settle time is measured in us, counting the slices
+     * could cut it short by the part of the slice that had
+     * already passed at the hop.
+     */
+    if (rtos_elapsed_us(scan_hop_us) < scan_settle_us) return SCAN_RUNNING;
+
+    // The newest sample is already an average of several conversions.
+    _scan_rank(scan_freq, scan_channels ? channel_nth(scan_position) : 0xFF, video_rx_get_rssi());
+
+    uint8_t next = scan_position + 1;
+    while (next < scan_count && _scan_freq_of(next) == scan_freq) next++;
+    scan_measured = next;
+
+    if (next >= scan_count) {
+        scan_state = SCAN_IDLE;
+        return SCAN_DONE;
+    }
+
+    _scan_hop(next);
+    return SCAN_RUNNING;
+}
+
+/* This function returns 1 while a scan is in progress.
+ */
+uint8_t scan_running(void) {
+    return scan_state == SCAN_RUNNING;
+}
+
+/* This function returns the frequency that is being measured.
+ */
+uint16_t scan_current_freq(void) {
+    return scan_freq;
+}
+
+/* This function returns how much of the last scan was
+ * done, in percent of the channels.
+ */
+uint8_t scan_progress(void) {
+    if (scan_count == 0) return 0;
+    return (uint16_t)scan_measured * 100 / scan_count;
+}
+
+/* These functions return the results of the last scan. Rank 0
+ * is the strongest channel. Ranks past the number of results
+ * return a null pointer.
+ */
+uint8_t scan_result_count(void) {
+    return scan_results_count;
+}
+
+const scan_result_t *scan_get_result(uint8_t rank) {
+    if (rank >= scan_results_count) return 0;
+    return &scan_results[rank];
+}
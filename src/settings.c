@@ -0,0 +1,171 @@
+#include "settings.h"
+#include "hal.h"
+
+/* Layout of a record:
+ *  0   sequence number, one more than in the previous slot
+ *  1   SETTINGS_VERSION
+ *  2   band
+ *  3   channel
+ *  4-5 frequency, little endian
+ *  6   reserved, 0
+ *  7   CRC-8 of bytes 0-6
+ * The sequence number is written last, so a record that was
+ * interrupted by a power loss doesn't look like the newest one.
+ */
+#define RECORD_SEQ      0
+#define RECORD_VERSION  1
+#define RECORD_CRC      7
+
+/* Slot and sequence number of the newest record. They are
+ * found once by settings_init() and only moved on by
+ * settings_save() after that.
+ */
+uint8_t settings_slot = 0;
+uint8_t settings_seq = 0xFF;
+
+/* A copy of the newest valid record, so the settings can be
+ * read without touching the EEPROM while the interrupt is
+ * writing it. A record being written replaces it once its
+ * sequence number is written.
+ */
+settings_t settings_saved;
+uint8_t settings_saved_valid = 0;
+settings_t settings_pending;
+
+/* The record that the EEPROM ready interrupt is writing, and
+ * the byte it writes next. SETTINGS_RECORD_LEN means idle.
+ */
+uint8_t settings_record[SETTINGS_RECORD_LEN];
+volatile uint8_t settings_write_pos = SETTINGS_RECORD_LEN;
+uint16_t settings_write_address;
+
+/* This function is used internally to calculate the CRC-8
+ * (polynomial 0x07) of a record.
+ */
+uint8_t _settings_crc(const uint8_t *data, uint8_t len) {
+    uint8_t crc = 0;
+    while (len-- > 0) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/* This function finds the newest record in the ring and
+ * keeps a copy of it for settings_load(). The slot with the
+ * newest record is found from the sequence numbers alone, so
+ * only one byte per slot is read. It must be called once at
+ * boot, before any other function of the settings.
+ */
+void settings_init(void) {
+    while (hal_eeprom_busy());
+
+    // The newest record is in front of the first break in the sequence.
+    uint8_t newest = SETTINGS_SLOTS - 1;
+    uint8_t seq = hal_eeprom_read(RECORD_SEQ);
+    for (uint8_t slot = 1; slot < SETTINGS_SLOTS; slot++) {
+        uint8_t next = hal_eeprom_read(slot * SETTINGS_RECORD_LEN + RECORD_SEQ);
+        if (next != (uint8_t)(seq + 1)) {
+            newest = slot - 1;
+            break;
+        }
+        seq = next;
+    }
+    settings_slot = newest;
+    settings_seq = hal_eeprom_read(newest * SETTINGS_RECORD_LEN + RECORD_SEQ);
+
+    /* Check the newest record and the one before it. Only the
+     * record that was being written can be damaged.
+     */
+    settings_saved_valid = 0;
+    for (uint8_t i = 0; i < 2; i++) {
+        uint8_t slot = (uint8_t)(newest - i) % SETTINGS_SLOTS;
+        uint8_t record[SETTINGS_RECORD_LEN];
+        for (uint8_t j = 0; j < SETTINGS_RECORD_LEN; j++) {
+            record[j] = hal_eeprom_read(slot * SETTINGS_RECORD_LEN + j);
+        }
+        if (record[RECORD_VERSION] != SETTINGS_VERSION) continue;
+        if (_settings_crc(record, RECORD_CRC) != record[RECORD_CRC]) continue;
+
+        settings_saved.band = record[2];
+        settings_saved.channel = record[3];
+        settings_saved.freq = record[4] | (record[5] << 8);
+        settings_saved_valid = 1;
+        return;
+    }
+}
+
+/* This function copies the newest saved record into
+ * settings. It doesn't read the EEPROM, so it can be called
+ * while a record is being written, it returns the one before.
+ * A return value of 0 means success, 1 means there is no
+ * valid record and settings was not changed.
+ */
+uint8_t settings_load(settings_t *settings) {
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t valid = settings_saved_valid;
+    if (valid) *settings = settings_saved;
+    SREG = sreg;
+    return !valid;
+}
+
+/* This function starts writing the settings into the next
+ * slot. It returns immediately, the EEPROM ready interrupt
+ * writes the record one byte at a time (3.3 ms per byte).
+ * A return value of 0 means success, 1 means the previous
+ * record is still being written.
+ */
+uint8_t settings_save(const settings_t *settings) {
+    if (settings_busy()) return 1;
+
+    settings_slot = (settings_slot + 1) % SETTINGS_SLOTS;
+    settings_seq++;
+    settings_pending = *settings;
+
+    settings_record[RECORD_SEQ] = settings_seq;
+    settings_record[RECORD_VERSION] = SETTINGS_VERSION;
+    settings_record[2] = settings->band;
+    settings_record[3] = settings->channel;
+    settings_record[4] = settings->freq & 0xFF;
+    settings_record[5] = settings->freq >> 8;
+    settings_record[6] = 0;
+    settings_record[RECORD_CRC] = _settings_crc(settings_record, RECORD_CRC);
+
+    settings_write_address = settings_slot * SETTINGS_RECORD_LEN;
+    settings_write_pos = RECORD_SEQ + 1;
+    EECR |= (1 << EERIE);
+    return 0;
+}
+
+/* This function returns 1 while a record is being written.
+ */
+uint8_t settings_busy(void) {
+    return settings_write_pos != SETTINGS_RECORD_LEN;
+}
+
+/* This is the EEPROM ready interrupt handler. It writes the
+ * bytes of the record after the sequence number, then the
+ * sequence number. Bytes that already have the right value
+ * are skipped.
+ */
+ISR(EE_READY_vect) {
+    uint8_t pos = settings_write_pos;
+    uint16_t address = settings_write_address + pos;
+
+    if (hal_eeprom_read(address) != settings_record[pos]) {
+        hal_eeprom_write(address, settings_record[pos]);
+    }
+
+    if (pos == RECORD_SEQ) {
+        // The record is complete with its sequence number.
+        settings_saved = settings_pending;
+        settings_saved_valid = 1;
+        settings_write_pos = SETTINGS_RECORD_LEN;
+        EECR &= ~(1 << EERIE);
+    } else {
+        settings_write_pos = (pos + 1) % SETTINGS_RECORD_LEN;
+    }
+}
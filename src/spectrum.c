@@ -0,0 +1,107 @@
+#include "spectrum.h"
+#include "scan.h"
+#include "video_rx.h"
+#include "rtos.h"
+
+// Largest jump between neighbouring bins, in MHz
+#define SPECTRUM_STEP_MAX_MHZ \
+    (2 * ((SPECTRUM_FREQ_HIGH - SPECTRUM_FREQ_LOW) / 2 + SPECTRUM_BINS - 2) / (SPECTRUM_BINS - 1))
+
+/* The spectrum analyzer sweeps the band over and over, one bin
+ * per spectrum_step(), from the lowest frequency up. Like the
+ * scan (scan.c) it never blocks: a call either waits for the
+ * receiver to settle, or takes the RSSI reading of the current
+ * bin and hops to the next one.
+ */
+uint8_t spectrum_active = 0;
+
+uint8_t spectrum_bin;           // Bin that is currently settling
+uint32_t spectrum_hop_us;       // When the receiver was tuned to it
+uint16_t spectrum_settle_us;    // How long it needs to settle
+
+// The newest RSSI of every bin
+uint8_t spectrum_levels[SPECTRUM_BINS];
+
+
+/* This function is used internally to tune the receiver to
+ * a bin, jump MHz away from where it was.
+ */
+void _spectrum_hop(uint8_t bin, uint16_t jump) {
+    uint32_t settle_us = SPECTRUM_SETTLE_US;
+    if (jump > SPECTRUM_STEP_MAX_MHZ) {
+        settle_us = SCAN_SETTLE_BASE_US + (uint32_t)jump * SCAN_SETTLE_PER_MHZ_US;
+        if (settle_us > SCAN_SETTLE_MAX_US) settle_us = SCAN_SETTLE_MAX_US;
+    }
+
+    video_rx_set_frequency(spectrum_freq(bin));
+    spectrum_bin = bin;
+    spectrum_hop_us = rtos_get_time_us();
+    spectrum_settle_us = settle_us;
+}
+
+/* This function starts sweeping. The levels of the last
+ * sweep are kept until their bins are measured again.
+ */
+void spectrum_start(void) {
+    // The receiver can be anywhere, give it the longest settle time.
+    _spectrum_hop(0, 0xFFFF);
+    spectrum_active = 1;
+}
+
+/* This function stops sweeping. The receiver stays on the
+ * last bin, so it must be retuned.
+ */
+void spectrum_stop(void) {
+    spectrum_active = 0;
+}
+
+/* This function advances the sweep. It returns the bin that
+ * was measured, or SPECTRUM_NONE while the receiver settles
+ * or if the sweep is stopped.
+ */
+uint8_t spectrum_step(void) {
+    if (!spectrum_active) return SPECTRUM_NONE;
+    // Like the scan's, the settle time is measured in us, not in slices.
+    if (rtos_elapsed_us(spectrum_hop_us) < spectrum_settle_us) return SPECTRUM_NONE;
+
+    // The newest sample is already an average of several conversions.
+    uint8_t bin = spectrum_bin;
+    spectrum_levels[bin] = video_rx_get_rssi();
+
+    if (bin + 1 < SPECTRUM_BINS) {
+        _spectrum_hop(bin + 1, spectrum_freq(bin + 1) - spectrum_freq(bin));
+    } else {
+        _spectrum_hop(0, SPECTRUM_FREQ_HIGH - SPECTRUM_FREQ_LOW);
+    }
+    return bin;
+}
+
+/* This function returns 1 while the sweep is running.
+ */
+uint8_t spectrum_running(void) {
+    return spectrum_active;
+}
+
+/* This function returns the frequency of a bin. The bins
+ * are spread evenly over the band, on even frequencies.
+ */
+uint16_t spectrum_freq(uint8_t bin) {
+    return SPECTRUM_FREQ_LOW + 2 * ((uint16_t)bin * ((SPECTRUM_FREQ_HIGH - SPECTRUM_FREQ_LOW) / 2) / (SPECTRUM_BINS - 1));
+}
+
+/* This function returns the newest RSSI of a bin, 0-99.
+ */
+uint8_t spectrum_level(uint8_t bin) {
+    if (bin >= SPECTRUM_BINS) return 0;
+    return spectrum_levels[bin];
+}
+
+/* This function returns the bin with the strongest RSSI.
+ */
+uint8_t spectrum_peak(void) {
+    uint8_t peak = 0;
+    for (uint8_t bin = 1; bin < SPECTRUM_BINS; bin++) {
+        if (spectrum_levels[bin] > spectrum_levels[peak]) peak = bin;
+    }
+    return peak;
+}
@@ -0,0 +1,151 @@
+#include "state.h"
+#include "hal.h"
+
+/* The state is odd while it is being written. A reader copies
+ * it and checks that the counter didn't change in between.
+ */
+volatile uint8_t state_seq = 0;
+rx_state_t state_data;
+
+state_queue_t *state_subscribers[STATE_SUBSCRIBERS];
+uint8_t state_subscriber_count = 0;
+
+// Keeps the compiler from moving the copy across the counter
+#define _state_barrier()    __asm__ __volatile__ ("" ::: "memory")
+
+/* This function is used internally to start a write.
+ */
+void _state_write_begin(void) {
+    state_seq++;
+    _state_barrier();
+}
+
+/* This function is used internally to finish a write.
+ */
+void _state_write_end(void) {
+    _state_barrier();
+    state_seq++;
+}
+
+/* This function sets the initial state without publishing
+ * any events. It should be called before the tasks read it.
+ */
+void state_init(const rx_state_t *state) {
+    _state_write_begin();
+    state_data = *state;
+    _state_write_end();
+}
+
+/* This function makes one attempt to copy the state. It returns
+ * 1 if a write was in progress and the copy is not valid. An
+ * interrupt that preempted the writer would never succeed, so
+ * it must use this function and try again later.
+ */
+uint8_t state_try_read(rx_state_t *state) {
+    uint8_t seq = state_seq;
+    if (seq & 1) return 1;
+    _state_barrier();
+    *state = state_data;
+    _state_barrier();
+    return state_seq != seq;
+}
+
+/* This function copies the state, retrying until the copy
+ * is consistent. Tasks never preempt each other, so in a task
+ * the first attempt always succeeds.
+ */
+void state_read(rx_state_t *state) {
+    while (state_try_read(state));
+}
+
+/* This function sets the position in the channel database and the
+ * frequency, and publishes what changed.
+ */
+void state_set_position(int8_t band, int8_t channel, uint16_t freq) {
+    uint8_t event = 0;
+    if (band != state_data.band || channel != state_data.channel) event |= STATE_EVENT_POSITION;
+    if (freq != state_data.freq) event |= STATE_EVENT_FREQ;
+    if (!event) return;
+
+    _state_write_begin();
+    state_data.band = band;
+    state_data.channel = channel;
+    state_data.freq = freq;
+    _state_write_end();
+    state_publish(event);
+}
+
+/* This function sets the RSSI and publishes it if it changed.
+ */
+void state_set_rssi(uint8_t rssi) {
+    if (rssi == state_data.rssi) return;
+
+    _state_write_begin();
+    state_data.rssi = rssi;
+    _state_write_end();
+    state_publish(STATE_EVENT_RSSI);
+}
+
+/* This function selects the screen and publishes it if it
+ * changed.
+ */
+void state_set_page(uint8_t page) {
+    if (page == state_data.page) return;
+
+    _state_write_begin();
+    state_data.page = page;
+    _state_write_end();
+    state_publish(STATE_EVENT_PAGE);
+}
+
+/* This function sends an event to every subscriber whose mask
+ * contains any of its bits.
+ */
+void state_publish(uint8_t event) {
+    for (uint8_t i = 0; i < state_subscriber_count; i++) {
+        state_queue_t *queue = state_subscribers[i];
+        uint8_t masked = event & queue->mask;
+        if (!masked) continue;
+
+        uint8_t head = queue->head;
+        if ((uint8_t)(head - queue->tail) >= STATE_QUEUE_LEN) {
+            queue->overrun = 1;
+        } else {
+            queue->events[head & (STATE_QUEUE_LEN - 1)] = masked;
+            queue->head = head + 1;
+        }
+        if (queue->task) rtos_resume(queue->task);
+    }
+}
+
+/* This function adds a queue that receives the events in
+ * the mask, and resumes the task, if any, when one arrives.
+ * It returns 1 if there are too many subscribers.
+ */
+uint8_t state_subscribe(state_queue_t *queue, uint8_t mask, rtos_task_t *task) {
+    if (state_subscriber_count >= STATE_SUBSCRIBERS) return 1;
+
+    queue->head = 0;
+    queue->tail = 0;
+    queue->overrun = 0;
+    queue->mask = mask;
+    queue->task = task;
+    state_subscribers[state_subscriber_count++] = queue;
+    return 0;
+}
+
+/* This function takes the oldest event from the queue. It
+ * returns 0 if the queue is empty.
+ */
+uint8_t state_get_event(state_queue_t *queue) {
+    uint8_t tail = queue->tail;
+    if (tail == queue->head) {
+        if (!queue->overrun) return 0;
+        queue->overrun = 0;
+        return queue->mask;
+    }
+
+    uint8_t event = queue->events[tail & (STATE_QUEUE_LEN - 1)];
+    queue->tail = tail + 1;
+    return event;
+}
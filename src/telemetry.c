@@ -0,0 +1,148 @@
+#include "telemetry.h"
+#include "uart.h"
+
+// Type, payload, CRC, COBS overhead and the delimiter
+#define TELEMETRY_FRAME_LEN (TELEMETRY_MAX_PAYLOAD + 5)
+
+// The frame that is being encoded
+uint8_t tx_frame[TELEMETRY_FRAME_LEN];
+uint8_t tx_length;
+uint8_t tx_code_position;
+
+/* The frame that is being received, decoded on the fly.
+ * rx_remaining counts the bytes left in the current COBS
+ * block, rx_block is its code.
+ */
+uint8_t rx_frame[TELEMETRY_MAX_PAYLOAD + 3];
+uint8_t rx_length = 0;
+uint8_t rx_remaining = 0;
+uint8_t rx_block = 0xFF;
+uint8_t rx_broken = 0;
+
+uint16_t telemetry_dropped_frames = 0;
+uint16_t telemetry_bad_frames = 0;
+
+/* This function is used internally to add a byte to the
+ * CRC-16/MCRF4XX, without a table.
+ */
+uint16_t _crc16_update(uint16_t crc, uint8_t data) {
+    data ^= crc & 0xFF;
+    data ^= data << 4;
+    return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+/* This function is used internally to COBS encode a byte
+ * into the frame. A zero closes the current block.
+ */
+void _telemetry_put(uint8_t byte) {
+    if (byte == 0) {
+        tx_frame[tx_code_position] = tx_length - tx_code_position;
+        tx_code_position = tx_length++;
+        return;
+    }
+    tx_frame[tx_length++] = byte;
+}
+
+/* This function encodes a frame and queues it for sending.
+ * A frame that doesn't fit into the UART buffer is dropped
+ * instead of waiting. It returns 0 if it was queued, 1 if it
+ * was dropped and 2 if the payload is too long.
+ */
+uint8_t telemetry_send(uint8_t type, const uint8_t *payload, uint8_t length) {
+    if (length > TELEMETRY_MAX_PAYLOAD) return 2;
+
+    tx_code_position = 0;
+    tx_length = 1;
+
+    uint16_t crc = _crc16_update(0xFFFF, type);
+    _telemetry_put(type);
+    for (uint8_t i = 0; i < length; i++) {
+        crc = _crc16_update(crc, payload[i]);
+        _telemetry_put(payload[i]);
+    }
+    _telemetry_put(crc & 0xFF);
+    _telemetry_put(crc >> 8);
+
+    // Close the last block and end the frame
+    tx_frame[tx_code_position] = tx_length - tx_code_position;
+    tx_frame[tx_length++] = 0;
+
+    if (uart_write(tx_frame, tx_length)) {
+        telemetry_dropped_frames++;
+        return 1;
+    }
+    return 0;
+}
+
+/* This function is used internally to check a received
+ * frame. It returns 1 if it is valid.
+ */
+uint8_t _telemetry_check(void) {
+    if (rx_broken || rx_remaining || rx_length < 3) return 0;
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < rx_length - 2; i++) {
+        crc = _crc16_update(crc, rx_frame[i]);
+    }
+    return rx_frame[rx_length - 2] == (crc & 0xFF) && rx_frame[rx_length - 1] == (crc >> 8);
+}
+
+/* This function decodes the received bytes. Once a whole
+ * frame with a valid CRC has arrived, it copies its type
+ * and payload (up to TELEMETRY_MAX_PAYLOAD bytes) and
+ * returns 1. Otherwise it returns 0 and keeps the bytes
+ * for the next call.
+ */
+uint8_t telemetry_receive(uint8_t *type, uint8_t *payload, uint8_t *length) {
+    uint8_t byte;
+    while (uart_read(&byte)) {
+        if (byte == 0) {
+            uint8_t valid = _telemetry_check();
+            if (!valid && (rx_length || rx_broken)) telemetry_bad_frames++;
+
+            uint8_t received = rx_length;
+            rx_length = 0;
+            rx_remaining = 0;
+            rx_block = 0xFF;
+            rx_broken = 0;
+            if (!valid) continue;
+
+            *type = rx_frame[0];
+            *length = received - 3;
+            for (uint8_t i = 0; i < *length; i++) payload[i] = rx_frame[i + 1];
+            return 1;
+        }
+
+        if (rx_remaining == 0) {
+            // Every block but the first and the full ones stands for a zero.
+            uint8_t zero = rx_block != 0xFF;
+            rx_block = byte;
+            rx_remaining = byte - 1;
+            if (!zero) continue;
+            byte = 0;
+        } else {
+            rx_remaining--;
+        }
+
+        if (rx_length >= sizeof(rx_frame)) {
+            rx_broken = 1;
+            continue;
+        }
+        rx_frame[rx_length++] = byte;
+    }
+    return 0;
+}
+
+/* This function returns the number of frames that were
+ * dropped because the UART buffer was full.
+ */
+uint16_t telemetry_dropped(void) {
+    return telemetry_dropped_frames;
+}
+
+/* This function returns the number of received frames
+ * that were broken.
+ */
+uint16_t telemetry_errors(void) {
+    return telemetry_bad_frames;
+}
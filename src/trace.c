@@ -0,0 +1,116 @@
+#include "trace.h"
+#include "video_rx.h"
+#include "pins.h"
+#include "rtos.h"
+
+/* The trace is written from the interrupts (button edges,
+ * RSSI samples, I2C completions) and from the tasks, so the
+ * entries are only touched with interrupts disabled.
+ */
+trace_entry_t trace_entries[TRACE_LEN];
+volatile uint8_t trace_entries_count = 0;
+volatile uint8_t trace_is_open = 0;
+// Counts the traces, so the host can tell them apart
+volatile uint8_t trace_serial = 0;
+// Time of the edge that opened the trace, in us
+uint32_t trace_start_us;
+
+/* The RSSI sample after a write is compared with the
+ * threshold: 2 skips the one that was being taken during
+ * the write, 1 records the first one above it.
+ */
+volatile uint8_t trace_rssi_armed = 0;
+
+/* This function records an event, if a trace is open. A
+ * button edge opens one once the last one is over. It may
+ * be called from interrupts. A trace that runs over the
+ * wrap of rtos_get_time_us() ends early.
+ */
+void trace_event(uint8_t event, uint8_t arg) {
+    if (!trace_is_open && event != TRACE_BUTTON_EDGE) return;
+
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t elapsed = rtos_get_time_us() - trace_start_us;
+    if (trace_is_open && elapsed >= TRACE_WINDOW_MS * 1000UL) trace_is_open = 0;
+
+    if (!trace_is_open) {
+        if (event != TRACE_BUTTON_EDGE) {
+            SREG = sreg;
+            return;
+        }
+        trace_start_us += elapsed;
+        elapsed = 0;
+        trace_entries_count = 0;
+        trace_rssi_armed = 0;
+        trace_serial++;
+        trace_is_open = 1;
+    }
+
+    if (trace_entries_count < TRACE_LEN) {
+        trace_entry_t *entry = &trace_entries[trace_entries_count++];
+        entry->event = event;
+        entry->arg = arg;
+        entry->time = elapsed >> TRACE_TIME_SHIFT;
+        if (event == TRACE_RX_TUNE) trace_rssi_armed = 2;
+#if TRACE_GPIO
+        toggleGpio(TRACE_PIN);
+#endif
+    }
+    SREG = sreg;
+}
+
+/* This function is called by the ADC interrupt with every
+ * RSSI sample of the RX on the video output. It records the
+ * first one above TRACE_RSSI_THRESHOLD after a write.
+ */
+void trace_rssi(uint16_t sample) {
+    if (!trace_rssi_armed) return;
+    if (trace_rssi_armed == 2) {
+        trace_rssi_armed = 1;
+        return;
+    }
+
+    uint8_t rssi = video_rx_rssi_scale(sample);
+    if (rssi < TRACE_RSSI_THRESHOLD) return;
+    trace_rssi_armed = 0;
+    trace_event(TRACE_RSSI_LOCK, rssi);
+}
+
+/* This function copies up to max entries of the trace into
+ * entries, from entry first on, and returns how many were
+ * copied.
+ */
+uint8_t trace_read(trace_entry_t *entries, uint8_t first, uint8_t max) {
+    uint8_t count = 0;
+    cli();
+    while (count < max && first + count < trace_entries_count) {
+        entries[count] = trace_entries[first + count];
+        count++;
+    }
+    sei();
+    return count;
+}
+
+/* This function returns the number of entries in the trace.
+ */
+uint8_t trace_count(void) {
+    return trace_entries_count;
+}
+
+/* This function returns the number of the trace, it goes
+ * up by one with every new trace.
+ */
+uint8_t trace_number(void) {
+    return trace_serial;
+}
+
+/* This function returns 1 while the trace can still grow.
+ */
+uint8_t trace_open(void) {
+    cli();
+    if (trace_is_open && rtos_get_time_us() - trace_start_us >= TRACE_WINDOW_MS * 1000UL) trace_is_open = 0;
+    uint8_t open = trace_is_open && trace_entries_count < TRACE_LEN;
+    sei();
+    return open;
+}
@@ -0,0 +1,106 @@
+#include "uart.h"
+#include "hal.h"
+
+/* Both buffers are single producer, single consumer rings
+ * with free running indices, like the I2C queue. The TX ring
+ * is filled by the tasks and emptied by the data register
+ * empty interrupt, the RX ring the other way around.
+ */
+uint8_t uart_tx[UART_TX_LEN];
+volatile uint8_t uart_tx_head = 0;
+volatile uint8_t uart_tx_tail = 0;
+
+uint8_t uart_rx[UART_RX_LEN];
+volatile uint8_t uart_rx_head = 0;
+volatile uint8_t uart_rx_tail = 0;
+
+// Received bytes that didn't fit into the RX ring
+volatile uint8_t uart_rx_lost = 0;
+
+/* This function powers up the USART and sets it up
+ * for 8N1 at UART_BAUD, in the double speed mode.
+ */
+void uart_init(void) {
+    PRR &= ~(1 << PRUSART0);
+
+    UCSR0A = (1 << U2X0);
+    UBRR0 = (F_CPU / 8 + UART_BAUD / 2) / UART_BAUD - 1;
+    // 8 data bits, no parity, 1 stop bit
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+    // Enable the receiver with its interrupt and the transmitter
+    UCSR0B = (1 << RXEN0) | (1 << RXCIE0) | (1 << TXEN0);
+}
+
+/* This function returns the free space in the TX ring.
+ */
+uint8_t uart_tx_free(void) {
+    return UART_TX_LEN - (uint8_t)(uart_tx_head - uart_tx_tail);
+}
+
+/* This function queues the data for sending. Either all of
+ * it is queued or nothing, so frames are never cut. It never
+ * waits, a return value of 1 means there wasn't enough room.
+ */
+uint8_t uart_write(const uint8_t *data, uint8_t length) {
+    if (length > uart_tx_free()) return 1;
+
+    uint8_t head = uart_tx_head;
+    for (uint8_t i = 0; i < length; i++) {
+        uart_tx[head++ & (UART_TX_LEN - 1)] = data[i];
+    }
+    uart_tx_head = head;
+
+    // Let the interrupt send it
+    UCSR0B |= (1 << UDRIE0);
+    return 0;
+}
+
+/* This function takes the oldest received byte. It
+ * returns 1 if there was one, otherwise 0.
+ */
+uint8_t uart_read(uint8_t *byte) {
+    uint8_t tail = uart_rx_tail;
+    if (tail == uart_rx_head) return 0;
+    *byte = uart_rx[tail & (UART_RX_LEN - 1)];
+    uart_rx_tail = tail + 1;
+    return 1;
+}
+
+/* This function returns the number of received bytes that
+ * were lost since the last call.
+ */
+uint8_t uart_rx_overruns(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t lost = uart_rx_lost;
+    uart_rx_lost = 0;
+    SREG = sreg;
+    return lost;
+}
+
+/* This is the data register empty interrupt. It sends the
+ * next byte and disables itself once the ring is empty.
+ */
+ISR(USART_UDRE_vect) {
+    uint8_t tail = uart_tx_tail;
+    if (tail == uart_tx_head) {
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+    hal_uart_set_data(uart_tx[tail & (UART_TX_LEN - 1)]);
+    uart_tx_tail = tail + 1;
+}
+
+/* This is the receive complete interrupt. It only stores
+ * the byte, the frames are decoded by the telemetry task.
+ */
+ISR(USART_RX_vect) {
+    uint8_t byte = hal_uart_data();
+    uint8_t head = uart_rx_head;
+    if ((uint8_t)(head - uart_rx_tail) >= UART_RX_LEN) {
+        if (uart_rx_lost < 0xFF) uart_rx_lost++;
+        return;
+    }
+    uart_rx[head & (UART_RX_LEN - 1)] = byte;
+    uart_rx_head = head + 1;
+}
@@ -0,0 +1,198 @@
+#include "ui.h"
+#include "oled.h"
+
+// The page that is shown
+const ui_widget_t *ui_page = 0;
+uint8_t ui_count = 0;
+
+/* The values of the slots, one bit per slot that changed
+ * since the last render, and 1 if everything has to be
+ * drawn again.
+ */
+uint16_t ui_values[UI_SLOTS];
+uint8_t ui_dirty[UI_SLOTS / 8];
+uint8_t ui_all = 0;
+
+/* This function is used internally to copy a widget from
+ * program memory.
+ */
+void _ui_read(const ui_widget_t *widget, ui_widget_t *w) {
+    w->type = pgm_read_byte(&widget->type);
+    w->col = pgm_read_byte(&widget->col);
+    w->row = pgm_read_byte(&widget->row);
+    w->width = pgm_read_byte(&widget->width);
+    w->height = pgm_read_byte(&widget->height);
+    w->slot = pgm_read_byte(&widget->slot);
+    w->flags = pgm_read_byte(&widget->flags);
+    w->text = (PGM_P)pgm_read_ptr(&widget->text);
+    w->max = pgm_read_word(&widget->max);
+    if (w->height == 0) w->height = 1;
+}
+
+/* This function is used internally to get the length of a
+ * label, which is its text up to width characters.
+ */
+uint8_t _ui_label_len(const ui_widget_t *w) {
+    uint8_t len = 0;
+    while ((w->width == 0 || len < w->width) && pgm_read_byte(&w->text[len]) != 0) len++;
+    return len;
+}
+
+/* This function is used internally to check if a slot has
+ * to be drawn.
+ */
+uint8_t _ui_dirty(uint8_t slot) {
+    return ui_all || (ui_dirty[slot >> 3] & (1 << (slot & 7)));
+}
+
+/* This function is used internally to draw the cells of a
+ * grid. Everything around them is only drawn if all is set.
+ */
+void _ui_draw_grid(const ui_widget_t *w, uint8_t all) {
+    uint8_t selected = ui_values[w->slot];
+    uint8_t invert = w->flags & UI_INVERT;
+    uint8_t first = (w->flags & UI_SCROLL) ? ui_values[w->slot + 1] : 0;
+
+    if (all) {
+        for (uint8_t x = 0; x < w->width; x++) {
+            oled_tile_set(w->col + 2*x, w->row - 1, OLED_GLYPH_DIGIT + x + 1, invert);
+            oled_tile_set(w->col + 2*x + 1, w->row - 1, OLED_GLYPH_BLANK, invert);
+        }
+        oled_tile_fill(OLED_GLYPH_BLANK, 2, w->col - 2, w->row - 1, invert);
+    }
+
+    uint8_t cell = first * w->width;
+    for (uint8_t y = 0; y < w->height; y++) {
+        uint8_t row = w->row + y;
+        if (all) {
+            oled_tile_set(w->col - 2, row, OLED_GLYPH(pgm_read_byte(&w->text[first + y])), invert);
+            oled_tile_set(w->col - 1, row, OLED_GLYPH_BLANK, invert);
+        }
+        for (uint8_t x = 0; x < w->width; x++, cell++) {
+            uint8_t glyph = OLED_GLYPH(cell == selected ? OLED_LARGE_DOT[0] : OLED_SMALL_DOT[0]);
+            oled_tile_set(w->col + 2*x, row, glyph, invert);
+            if (all) oled_tile_set(w->col + 2*x + 1, row, OLED_GLYPH_BLANK, invert);
+        }
+    }
+}
+
+/* This function is used internally to draw a widget into the
+ * tile map, or only the rows whose slots changed.
+ */
+void _ui_draw(const ui_widget_t *w) {
+    uint8_t invert = w->flags & UI_INVERT;
+
+    if (w->type == UI_LABEL) {
+        if (!ui_all) return;
+        uint8_t len = _ui_label_len(w);
+        for (uint8_t i = 0; i < len; i++) {
+            oled_tile_set(w->col + i, w->row, OLED_GLYPH(pgm_read_byte(&w->text[i])), invert);
+        }
+        if (w->width > len) oled_tile_fill(OLED_GLYPH_BLANK, w->width - len, w->col + len, w->row, invert);
+        return;
+    }
+
+    if (w->type == UI_GRID) {
+        // The row labels change when the grid scrolls.
+        uint8_t scrolled = (w->flags & UI_SCROLL) && _ui_dirty(w->slot + 1);
+        if (scrolled || _ui_dirty(w->slot)) _ui_draw_grid(w, ui_all || scrolled);
+        return;
+    }
+
+    for (uint8_t i = 0; i < w->height; i++) {
+        uint8_t slot = w->slot + i;
+        if (!_ui_dirty(slot)) continue;
+
+        uint16_t value = ui_values[slot];
+        uint8_t row = w->row + i;
+
+        if (w->type == UI_NUMBER) {
+            if (w->max && value > w->max) value = w->max;
+            oled_tile_num_fixed(value, w->width, w->col, row, invert);
+        } else if (w->type == UI_CHOICE) {
+            // Indices past the end of the text are blank.
+            uint8_t j = 0;
+            char c;
+            while ((c = pgm_read_byte(&w->text[j])) != 0 && j < value) j++;
+            oled_tile_set(w->col, row, c ? OLED_GLYPH(c) : OLED_GLYPH_BLANK, invert);
+        } else if (w->type == UI_BAR) {
+            if (value > w->max) value = w->max;
+            uint8_t filled = w->max ? (uint32_t)value * w->width / w->max : 0;
+            oled_tile_fill(OLED_GLYPH_BLOCK, filled, w->col, row, invert);
+            oled_tile_fill(OLED_GLYPH_BLANK, w->width - filled, w->col + filled, row, invert);
+        }
+    }
+}
+
+/* This function shows a page. The tiles that no widget
+ * covers are blanked, the others are drawn over by the next
+ * ui_render(), so only the tiles that differ between the old
+ * and the new page are sent to the display. The slots keep
+ * their values, set the new ones before rendering.
+ */
+void ui_show(const ui_widget_t *page, uint8_t count) {
+    ui_page = page;
+    ui_count = count;
+
+    uint8_t covered[OLED_TILE_ROWS][(OLED_TILE_COLS + 7) / 8] = {{0}};
+    ui_widget_t w;
+    for (uint8_t i = 0; i < count; i++) {
+        _ui_read(&page[i], &w);
+        uint8_t col = w.col;
+        uint8_t row = w.row;
+        uint8_t width = w.width;
+        uint8_t height = w.height;
+        if (w.type == UI_LABEL) {
+            if (width == 0) width = _ui_label_len(&w);
+        } else if (w.type == UI_CHOICE) {
+            width = 1;
+        } else if (w.type == UI_GRID) {
+            col -= 2;
+            row -= 1;
+            width = 2 * width + 2;
+            height += 1;
+        }
+        for (uint8_t y = row; y < row + height && y < OLED_TILE_ROWS; y++) {
+            for (uint8_t x = col; x < col + width && x < OLED_TILE_COLS; x++) {
+                covered[y][x >> 3] |= 1 << (x & 7);
+            }
+        }
+    }
+
+    for (uint8_t row = 0; row < OLED_TILE_ROWS; row++) {
+        for (uint8_t col = 0; col < OLED_TILE_COLS; col++) {
+            if (!(covered[row][col >> 3] & (1 << (col & 7)))) oled_tile_set(col, row, OLED_GLYPH_BLANK, 0);
+        }
+    }
+
+    ui_invalidate();
+}
+
+/* This function sets the value of a slot. The widgets that
+ * show it are only drawn again if the value changed.
+ */
+void ui_set(uint8_t slot, uint16_t value) {
+    if (slot >= UI_SLOTS || ui_values[slot] == value) return;
+    ui_values[slot] = value;
+    ui_dirty[slot >> 3] |= 1 << (slot & 7);
+}
+
+/* This function marks the whole page for drawing again.
+ */
+void ui_invalidate(void) {
+    ui_all = 1;
+}
+
+/* This function draws the widgets whose slots changed
+ * into the tile map. The tile map still has to be flushed.
+ */
+void ui_render(void) {
+    ui_widget_t w;
+    for (uint8_t i = 0; i < ui_count; i++) {
+        _ui_read(&ui_page[i], &w);
+        _ui_draw(&w);
+    }
+
+    ui_all = 0;
+    for (uint8_t i = 0; i < sizeof(ui_dirty); i++) ui_dirty[i] = 0;
+}
@@ -1,35 +1,123 @@
 #include "video_rx.h"
-#include <avr/io.h>
+#include "hal.h"
 #include "pins.h"
+#include "rtos.h"
+#include "trace.h"
 
 // RTC6715 register addresses
 #define SYN_REG_A 0x00
 #define SYN_REG_B 0x01
 
+// SYN_REG_A value for 1 MHz steps (R = 16, the default is 8)
+#define SYN_REG_A_FINE 0x10
+
+// The shortest safe delay between a SYN_REG_B and a SYN_REG_A write
+#define SYN_REG_A_DELAY_US 27000
+
+// Number of conversions summed for every RSSI sample (4^n)
+#define OVERSAMPLE_COUNT (1 << (2 * VIDEO_RX_OVERSAMPLE_BITS))
+
+// ADC conversions per second
+#if VIDEO_RX_ADC_TRIGGER == VIDEO_RX_ADC_TIMER0
+#define ADC_CONVERSIONS_HZ VIDEO_RX_ADC_RATE_HZ
+#else
+#define ADC_CONVERSIONS_HZ (F_CPU / 128 / 13)
+#endif
+
+/* The dwell time in RSSI samples of either RX. The samples of
+ * each RX are smoothed with a 1/2^n exponential filter before
+ * they are compared.
+ */
+#define SWITCH_DWELL_SAMPLES ((uint32_t)VIDEO_RX_SWITCH_DWELL_MS * ADC_CONVERSIONS_HZ / OVERSAMPLE_COUNT / 1000)
+#define SWITCH_FILTER_SHIFT 2
+
+/* The RSSI samples are stored in a single producer (ADC
+ * interrupt), single consumer ring buffer. The indices run
+ * freely and are masked on access. If the buffer is full,
+ * new samples are dropped and counted as overruns.
+ */
+uint16_t rssi_buffer[VIDEO_RX_RSSI_BUFFER_LEN];
+volatile uint8_t rssi_head = 0;
+volatile uint8_t rssi_tail = 0;
+volatile uint8_t rssi_overruns = 0;
+
+// The newest sample of every RX, also kept when the buffer is full
+volatile uint16_t rssi_latest[VIDEO_RX_COUNT];
+
+/* Deferred SYN_REG_A write for odd frequencies. It is set by
+ * video_rx_set_frequency() and done by video_rx_tune_step().
+ */
+uint8_t syn_a_pending = 0;
+uint32_t syn_a_us;
+
+// Oversampling accumulators
+uint16_t rssi_sum[VIDEO_RX_COUNT];
+uint8_t rssi_count[VIDEO_RX_COUNT];
+
+// The RX on the video output, only its samples are buffered
+volatile uint8_t rx_active = 0;
+
+#if VIDEO_RX_DIVERSITY
+/* The ADC channel of the conversion in progress and the one
+ * the multiplexer is set to. They differ in free running mode,
+ * because the next conversion starts before the interrupt.
+ */
+uint8_t adc_converting = 0;
+uint8_t adc_mux = 0;
+
+int16_t rssi_filtered[VIDEO_RX_COUNT];
+uint16_t switch_dwell = 0;
+volatile uint16_t switch_count = 0;
+#endif
+
 /* This function is used internally to calculate the N
  * and A parameters for the RX chip, as specified in
  * the datasheet. The parameters are combined into a
- * value that fits into the Synthesizer Register A.
- * Due to the way the receiver is configured, it is
- * only possible to change the frequency in steps of
- * 2 MHz. Theoretically this could be fixed by writing
- * a value of 0x10 to SYN_REG_A, but due to a glitch
- * in the receiver chip you can only change the A
- * register after about 27 ms after setting the B
- * register. Writing sooner than this overwrites the
- * B register as well, and writing to the B register
- * after the A register simply resets the A register
- * to the default value of 0x08. To avoid the long
- * wait between writes, this code does not attempt
- * to change the SYN_REG_A value.
+ * value that fits into the Synthesizer Register B.
+ * With the default SYN_REG_A value of 0x08 the
+ * frequency can only be changed in steps of 2 MHz.
+ * Writing 0x10 to SYN_REG_A gives 1 MHz steps, but
+ * due to a glitch in the receiver chip you can only
+ * change the A register about 27 ms after setting
+ * the B register. Writing sooner than this overwrites
+ * the B register as well, and writing to the B
+ * register after the A register simply resets the A
+ * register to the default value of 0x08. So even
+ * frequencies are set with the default A register,
+ * and odd ones are calculated for 1 MHz steps and
+ * need a deferred A write (see video_rx_tune_step()).
  */
 uint32_t _freq_to_data(uint16_t freq) {
-    uint16_t f_lo_half = (freq - 479) >> 1;
-    uint32_t N = f_lo_half / 32;
-    uint8_t A = f_lo_half % 32;
+    uint16_t f_lo = freq - 479;
+    if (!(freq & 1)) f_lo >>= 1;
+    uint32_t N = f_lo / 32;
+    uint8_t A = f_lo % 32;
     return (N << 7) | A;
 }
 
+/* This function is used internally to send a register
+ * write to the RTC6715: 25 bits of data, write bit and
+ * register address, least significant bit first.
+ */
+void _spi_send(uint32_t word) {
+    setGpioLow(VIDEO_RX_CS);        // CS low
+#if VIDEO_RX_DIVERSITY
+    // Both RX get the same data, so they stay on the same frequency.
+    setGpioLow(VIDEO_RX_B_CS);
+#endif
+    // Send data in four packets of 8 bits.
+    for (uint8_t i = 0; i < 4; i++) {
+        hal_spi_set_data(word & 0xFF);
+        word = word >> 8;
+        /* Wait for transmission complete */
+        while(!hal_spi_done());
+    }
+    setGpioHigh(VIDEO_RX_CS);        // CS high
+#if VIDEO_RX_DIVERSITY
+    setGpioHigh(VIDEO_RX_B_CS);
+#endif
+}
+
 /* This function is used internally to write to the
  * RTC6715's configuration registers.
  */
@@ -37,16 +125,7 @@ void _spi_write(uint32_t data, uint8_t address) {
     // Combine the data with the RW bit and the address.
     data = (data << 1) + 1;         // Set RW bit to W
     data = (data << 4) + address;     // Set register address
-
-    setGpioLow(VIDEO_RX_CS);        // CS low
-    // Send data in four packets of 8 bits.
-    for (int i = 0; i < 4; i++) {
-        SPDR = data & 0xFF;
-        data = data >> 8;
-        /* Wait for transmission complete */
-        while(!(SPSR & (1<<SPIF)));
-    }
-    setGpioHigh(VIDEO_RX_CS);        // CS high
+    _spi_send(data);
 }
 
 /* This function initializes the output pins for
@@ -62,50 +141,260 @@ void video_rx_init_spi() {
     SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPR0) | (1 << DORD);
     // CS High
     setGpioHigh(VIDEO_RX_CS);
+
+#if VIDEO_RX_DIVERSITY
+    setGpioOutput(VIDEO_RX_B_CS);
+    setGpioHigh(VIDEO_RX_B_CS);
+    // Start on the first RX
+    setGpioOutput(VIDEO_SWITCH);
+    setGpioLow(VIDEO_SWITCH);
+#endif
 }
 
-/* This function initializes the ADC and starts
- * a conversion, since the first conversion takes
- * longer than the later ones.
+/* This function initializes the ADC for continuous RSSI
+ * acquisition. Conversions are started either by the ADC itself
+ * (free running) or by Timer0, and every result is handled by
+ * the ADC interrupt, so nothing ever waits for a conversion.
  */
 void video_rx_init_adc() {
-    // Enable ADC, set prescaler to /128 for 125 kHz
-    ADCSRA = (1 << ADEN) | 0b111;
     // Set VCC as ADC reference, select channel 0
     ADMUX = (1 << REFS0);
-    // Start first conversion
+    // Disable the digital input buffer on the RSSI pin
+    DIDR0 = (1 << ADC0D);
+#if VIDEO_RX_DIVERSITY
+    // and on the second RX's RSSI pin (ADC1)
+    DIDR0 |= (1 << ADC1D);
+#endif
+
+#if VIDEO_RX_ADC_TRIGGER == VIDEO_RX_ADC_TIMER0
+    // Timer0 in CTC mode, clk/64, compare match A triggers the ADC
+    PRR &= ~(1 << PRTIM0);
+    TCCR0A = (1 << WGM01);
+    TCCR0B = (1 << CS01) | (1 << CS00);
+    OCR0A = F_CPU / 64 / VIDEO_RX_ADC_RATE_HZ - 1;
+    ADCSRB = (1 << ADTS1) | (1 << ADTS0);
+#else
+    // Free running mode, Timer0 isn't needed
+    ADCSRB = 0;
+    PRR |= (1 << PRTIM0);
+#endif
+
+    // Enable ADC with auto trigger and interrupt, prescaler /128 for 125 kHz
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | (1 << ADIF) | 0b111;
+    // Start the first conversion, the trigger keeps it going
     ADCSRA |= (1 << ADSC);
-    while (!(ADCSRA & (1 << ADIF)));
-    // Clear ADIF flag
-    ADCSRA |= (1 << ADIF);
+}
+
+#if VIDEO_RX_DIVERSITY
+/* This function is used internally by the ADC interrupt to
+ * select the stronger RX. It is called with every new sample,
+ * so with the free running ADC and n = 1 every RX is compared
+ * about every 0.8 ms, and a clear loss of signal is detected
+ * within a few samples (a few ms), not counting the dwell time.
+ */
+void _video_rx_switch(uint8_t rx, uint16_t sample) {
+    rssi_filtered[rx] += ((int16_t)sample - rssi_filtered[rx]) >> SWITCH_FILTER_SHIFT;
+
+    if (switch_dwell) {
+        switch_dwell--;
+        return;
+    }
+    if (rx == rx_active) return;
+    if (rssi_filtered[rx] <= rssi_filtered[rx_active] + VIDEO_RX_SWITCH_HYSTERESIS) return;
+
+    rx_active = rx;
+    if (rx) setGpioHigh(VIDEO_SWITCH);
+    else setGpioLow(VIDEO_SWITCH);
+    switch_dwell = SWITCH_DWELL_SAMPLES;
+    switch_count++;
+}
+#endif
+
+/* This is the ADC interrupt handler. It sums up 4^n conversions
+ * and stores the sum shifted right by n, which gives n extra bits
+ * of resolution, as long as there is some noise on the input.
+ * With diversity the channels are alternated after every
+ * conversion, and each RX has its own sum.
+ */
+ISR(ADC_vect) {
+#if VIDEO_RX_ADC_TRIGGER == VIDEO_RX_ADC_TIMER0
+    // The trigger is the rising edge of the flag, so clear it.
+    TIFR0 = (1 << OCF0A);
+#endif
+
+#if VIDEO_RX_DIVERSITY
+    uint8_t rx = adc_converting;
+#if VIDEO_RX_ADC_TRIGGER == VIDEO_RX_ADC_TIMER0
+    // The next conversion starts on the trigger, after this.
+    adc_mux = rx ^ 1;
+    adc_converting = adc_mux;
+#else
+    // The next conversion has already started with the old channel.
+    adc_converting = adc_mux;
+    adc_mux ^= 1;
+#endif
+    ADMUX = (1 << REFS0) | adc_mux;
+#else
+    const uint8_t rx = 0;
+#endif
+
+    rssi_sum[rx] += hal_adc_result();
+    if (++rssi_count[rx] < OVERSAMPLE_COUNT) return;
+
+    uint16_t sample = rssi_sum[rx] >> VIDEO_RX_OVERSAMPLE_BITS;
+    rssi_sum[rx] = 0;
+    rssi_count[rx] = 0;
+
+    rssi_latest[rx] = sample;
+#if VIDEO_RX_DIVERSITY
+    _video_rx_switch(rx, sample);
+    if (rx != rx_active) return;
+#endif
+    trace_rssi(sample);
+    if ((uint8_t)(rssi_head - rssi_tail) >= VIDEO_RX_RSSI_BUFFER_LEN) {
+        rssi_overruns++;
+        return;
+    }
+    rssi_buffer[rssi_head & (VIDEO_RX_RSSI_BUFFER_LEN - 1)] = sample;
+    rssi_head++;
+}
+
+/* This function copies up to max buffered RSSI samples into
+ * samples and returns how many were copied. The samples have
+ * VIDEO_RX_OVERSAMPLE_BITS more bits than the ADC. With
+ * diversity they come from the RX on the video output.
+ */
+uint8_t video_rx_rssi_read(uint16_t *samples, uint8_t max) {
+    uint8_t count = 0;
+    uint8_t tail = rssi_tail;
+    while (count < max && tail != rssi_head) {
+        samples[count++] = rssi_buffer[tail & (VIDEO_RX_RSSI_BUFFER_LEN - 1)];
+        tail++;
+    }
+    rssi_tail = tail;
+    return count;
+}
+
+/* This function discards all buffered RSSI samples, for
+ * example after a frequency change.
+ */
+void video_rx_rssi_flush(void) {
+    rssi_tail = rssi_head;
+}
+
+/* This function returns the number of samples that were
+ * dropped because the buffer was full, and resets it.
+ */
+uint8_t video_rx_rssi_overruns(void) {
+    uint8_t overruns = rssi_overruns;
+    rssi_overruns = 0;
+    return overruns;
+}
+
+/* This function converts a (possibly averaged) sample to an
+ * RSSI value. The RX datasheet does not specify an exact
+ * conversion formula so the RSSI value is only an indicator.
+ * Values range from 0 (bad) to 99 (good).
+ */
+uint8_t video_rx_rssi_scale(uint16_t sample) {
+    int16_t rssi = (sample >> VIDEO_RX_OVERSAMPLE_BITS) - 130;
+    if (rssi < 0) return 0;
+    if (rssi > 99) return 99;
+    return (uint8_t) rssi;
 }
 
 /* This function writes a new frequency setting to
  * the RX. Note that every write causes a momentary
  * video loss so the frequency should only be written
- * when it actually changes.
+ * when it actually changes. Any frequency in 1 MHz
+ * steps can be set, but odd frequencies are only
+ * reached once video_rx_tune_step() has written
+ * the A register. A pending A write from an earlier
+ * call is cancelled, the B write has reset it anyway.
  */
 void video_rx_set_frequency(uint16_t freq) {
     // Combine the frequency data with the RW bit and the address.
     uint32_t data = _freq_to_data(freq);
     _spi_write(data, SYN_REG_B);
+    trace_event(TRACE_RX_TUNE, SYN_REG_B);
+
+    syn_a_pending = freq & 1;
+    syn_a_us = rtos_get_time_us();
+}
+
+/* This function is the same as video_rx_set_frequency(),
+ * with the SYN_REG_B write already calculated, as it is
+ * kept in the channel database (channels.h). The word is
+ * sent as it is, freq only tells if the A register has
+ * to be written as well.
+ */
+void video_rx_set_word(uint32_t word, uint16_t freq) {
+    _spi_send(word);
+    trace_event(TRACE_RX_TUNE, SYN_REG_B);
+
+    syn_a_pending = freq & 1;
+    syn_a_us = rtos_get_time_us();
+}
+
+/* This function finishes tuning to an odd frequency by
+ * writing the A register once it is safe to do so. It
+ * must be called regularly from a task, it never waits.
+ */
+void video_rx_tune_step(void) {
+    if (!syn_a_pending) return;
+    // In us, the slices could cut the delay short like the scan's settle time.
+    if (rtos_elapsed_us(syn_a_us) < SYN_REG_A_DELAY_US) return;
+
+    _spi_write(SYN_REG_A_FINE, SYN_REG_A);
+    trace_event(TRACE_RX_TUNE, SYN_REG_A);
+    syn_a_pending = 0;
 }
 
-/* This function reads the ADC and converts the value to
- * an RSSI value. The RX datasheet does not specify an
- * exact conversion formula so the RSSI value is only
- * an indicator. Values range from 0 (bad) to 99 (good).
+/* This function returns 1 while the RX is not yet
+ * on the frequency that was set last.
+ */
+uint8_t video_rx_tuning(void) {
+    return syn_a_pending;
+}
+
+/* This function returns the newest RSSI sample of the RX
+ * on the video output converted to an RSSI value. It doesn't
+ * wait for a conversion and doesn't remove anything from
+ * the buffer.
  */
 uint8_t video_rx_get_rssi() {
-    ADCSRA |= (1 << ADSC);
-    while (!(ADCSRA & (1 << ADIF)));
-    // Clear ADIF flag
-    ADCSRA |= (1 << ADIF);
+    return video_rx_get_rssi_of(rx_active);
+}
 
-    // Read the results
-    uint16_t adc_result = ADCL | (ADCH << 8);
-    int16_t rssi = (adc_result - 130);
-    if (rssi < 0) return 0;
-    if (rssi > 99) return 99;
-    return (uint8_t) rssi;
-}
\ No newline at end of file
+/* This function returns the newest RSSI value of one RX,
+ * 0 for the first one and 1 for the second one.
+ */
+uint8_t video_rx_get_rssi_of(uint8_t rx) {
+    if (rx >= VIDEO_RX_COUNT) return 0;
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t sample = rssi_latest[rx];
+    SREG = sreg;
+    return video_rx_rssi_scale(sample);
+}
+
+/* This function returns the RX on the video output.
+ */
+uint8_t video_rx_active(void) {
+    return rx_active;
+}
+
+/* This function returns how many times the video output
+ * was switched to the other RX. The counter wraps around.
+ */
+uint16_t video_rx_switches(void) {
+#if VIDEO_RX_DIVERSITY
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t count = switch_count;
+    SREG = sreg;
+    return count;
+#else
+    return 0;
+#endif
+}
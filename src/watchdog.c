@@ -0,0 +1,69 @@
+#include "watchdog.h"
+
+/* The reset flags (MCUSR) of the last reset and the number of
+ * watchdog resets since power on. They are in .noinit, which the
+ * C runtime doesn't clear, so the counter survives the resets.
+ */
+uint8_t watchdog_flags HAL_NOINIT;
+uint8_t watchdog_count HAL_NOINIT;
+
+/* This function is used internally to save and clear the reset
+ * flags and to stop the watchdog. After a watchdog reset the
+ * watchdog keeps running with the shortest timeout, so on the
+ * AVR this runs in .init3, before the C runtime clears .bss.
+ * The bootloader (Optiboot) may have cleared MCUSR already, it
+ * leaves the flags in r2 then.
+ */
+#ifndef HAL_NATIVE
+void _watchdog_boot(void) __attribute__((naked, used, section(".init3")));
+#endif
+void _watchdog_boot(void) {
+    uint8_t flags = hal_reset_flags();
+#ifndef HAL_NATIVE
+    if (flags == 0) __asm__ __volatile__ ("mov %0, r2" : "=r" (flags));
+#endif
+    MCUSR = 0;
+    wdt_disable();
+
+    // The RAM holds garbage after a power on.
+    if (flags & ((1 << PORF) | (1 << BORF))) watchdog_count = 0;
+    if ((flags & (1 << WDRF)) && watchdog_count < 0xFF) watchdog_count++;
+    watchdog_flags = flags;
+}
+
+/* This function starts the watchdog. From now on it has to
+ * be kicked at least every WATCHDOG_TIMEOUT.
+ */
+void watchdog_init(void) {
+#ifdef HAL_NATIVE
+    _watchdog_boot();
+#endif
+    wdt_enable(WATCHDOG_TIMEOUT);
+}
+
+/* This function restarts the watchdog timeout.
+ */
+void watchdog_kick(void) {
+    wdt_reset();
+}
+
+/* This function returns the reset flags of the last reset,
+ * as they were in MCUSR.
+ */
+uint8_t watchdog_reset_flags(void) {
+    return watchdog_flags;
+}
+
+/* This function returns 1 if the last reset was caused by
+ * the watchdog.
+ */
+uint8_t watchdog_recovered(void) {
+    return (watchdog_flags & (1 << WDRF)) ? 1 : 0;
+}
+
+/* This function returns the number of watchdog resets since
+ * power on.
+ */
+uint8_t watchdog_resets(void) {
+    return watchdog_count;
+}
@@ -0,0 +1,354 @@
+/* Unit tests of the native build, "pio test -e native".
+ *
+ * They run the modules against the simulated peripherals of
+ * hal_native.c, which are reset before every test. The firmware's
+ * own main() is left out of the test build (PIO_UNIT_TESTING).
+ */
+
+#include <unity.h>
+#include "hal.h"
+#include "channels.h"
+#include "font.h"
+#include "laps.h"
+#include "oled.h"
+#include "rtos.h"
+#include "rtos_tasks.h"
+#include "settings.h"
+#include "state.h"
+#include "telemetry.h"
+#include "uart.h"
+#include "video_rx.h"
+
+// Internal functions and variables of the modules under test
+uint16_t _crc16_update(uint16_t crc, uint8_t data);
+uint32_t _freq_to_data(uint16_t freq);
+uint16_t _laps_to_sample(uint8_t rssi);
+extern uint8_t settings_slot;
+extern uint8_t state_subscriber_count;
+
+void setUp(void) {
+    hal_native_reset();
+    sei();
+}
+
+void tearDown(void) {
+}
+
+/* Settings */
+
+/* This function is used internally to save settings and let
+ * the EEPROM ready interrupt write the whole record.
+ */
+void _save(int8_t band, int8_t channel, uint16_t freq) {
+    settings_t settings = {band, channel, freq};
+    TEST_ASSERT_EQUAL_UINT8(0, settings_save(&settings));
+    hal_native_run_eeprom();
+    TEST_ASSERT_FALSE(settings_busy());
+}
+
+void test_settings_empty(void) {
+    settings_t settings = {1, 2, 3};
+    settings_init();
+    TEST_ASSERT_EQUAL_UINT8(1, settings_load(&settings));
+    TEST_ASSERT_EQUAL_UINT16(3, settings.freq);
+}
+
+void test_settings_load_during_write(void) {
+    settings_t settings;
+    settings_init();
+    _save(4, 7, 5917);
+
+    settings_t next = {-1, 0, 5800};
+    TEST_ASSERT_EQUAL_UINT8(0, settings_save(&next));
+    TEST_ASSERT_TRUE(settings_busy());
+    // The record being written isn't returned before it is complete.
+    TEST_ASSERT_EQUAL_UINT8(0, settings_load(&settings));
+    TEST_ASSERT_EQUAL_UINT16(5917, settings.freq);
+    TEST_ASSERT_EQUAL_UINT8(1, settings_save(&next));
+
+    hal_native_run_eeprom();
+    TEST_ASSERT_EQUAL_UINT8(0, settings_load(&settings));
+    TEST_ASSERT_EQUAL_INT8(-1, settings.band);
+    TEST_ASSERT_EQUAL_UINT16(5800, settings.freq);
+}
+
+void test_settings_ring_wraps(void) {
+    settings_t settings;
+    settings_init();
+    for (uint16_t i = 0; i < SETTINGS_SLOTS + 3; i++) _save(-1, 0, 5000 + i);
+
+    settings_init();
+    TEST_ASSERT_EQUAL_UINT8(3, settings_slot);
+    TEST_ASSERT_EQUAL_UINT8(0, settings_load(&settings));
+    TEST_ASSERT_EQUAL_UINT16(5000 + SETTINGS_SLOTS + 2, settings.freq);
+}
+
+void test_settings_damaged_record(void) {
+    settings_t settings;
+    settings_init();
+    _save(4, 0, 5658);
+    _save(4, 1, 5695);
+
+    // Power lost while the CRC of the newest record was written
+    hal_native_eeprom[3 * SETTINGS_RECORD_LEN - 1] ^= 0xFF;
+    settings_init();
+    TEST_ASSERT_EQUAL_UINT8(0, settings_load(&settings));
+    TEST_ASSERT_EQUAL_INT8(0, settings.channel);
+    TEST_ASSERT_EQUAL_UINT16(5658, settings.freq);
+}
+
+/* Telemetry */
+
+void test_crc16(void) {
+    const char *check = "123456789";
+    uint16_t crc = 0xFFFF;
+    while (*check) crc = _crc16_update(crc, *check++);
+    TEST_ASSERT_EQUAL_HEX16(0x6F91, crc);
+}
+
+void test_telemetry_cobs(void) {
+    // The same frame as encode_frame() in scripts/telemetry.py
+    const uint8_t payload[] = {0x00, 0x11, 0x00};
+    const uint8_t frame[] = {0x02, 0x02, 0x02, 0x11, 0x03, 0x1E, 0xB6, 0x00};
+
+    uart_init();
+    TEST_ASSERT_EQUAL_UINT8(0, telemetry_send(0x02, payload, sizeof(payload)));
+    hal_native_run_uart();
+    TEST_ASSERT_EQUAL_UINT16(sizeof(frame), hal_native_uart_log_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, hal_native_uart_log, sizeof(frame));
+
+    uint8_t type, length;
+    uint8_t received[TELEMETRY_MAX_PAYLOAD];
+    for (uint8_t i = 0; i < sizeof(frame); i++) hal_native_uart_receive(frame[i]);
+    TEST_ASSERT_EQUAL_UINT8(1, telemetry_receive(&type, received, &length));
+    TEST_ASSERT_EQUAL_HEX8(0x02, type);
+    TEST_ASSERT_EQUAL_UINT8(sizeof(payload), length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(payload, received, sizeof(payload));
+
+    // A broken CRC is counted and the frame is dropped.
+    uint16_t errors = telemetry_errors();
+    for (uint8_t i = 0; i < sizeof(frame); i++) hal_native_uart_receive(i == 5 ? 0x1F : frame[i]);
+    TEST_ASSERT_EQUAL_UINT8(0, telemetry_receive(&type, received, &length));
+    TEST_ASSERT_EQUAL_UINT16(errors + 1, telemetry_errors());
+}
+
+/* Font */
+
+/* The 26 glyphs of the original 156x8 pixel sheet, the same bits as
+ * the lookup tables oled.c had before the font was generated.
+ */
+const char test_font_chars[] = "0123456789ABEFHIMRSz\x80\x81\x82\x83\x84\x85";
+const uint8_t test_font_glyphs[][FONT_WIDTH] = {
+    {0x3C, 0x52, 0x4A, 0x46, 0x3C, 0x00}, // '0'
+    {0x00, 0x44, 0x7E, 0x40, 0x00, 0x00}, // '1'
+    {0x44, 0x62, 0x52, 0x4A, 0x44, 0x00}, // '2'
+    {0x24, 0x42, 0x4A, 0x4A, 0x34, 0x00}, // '3'
+    {0x30, 0x28, 0x24, 0x7E, 0x20, 0x00}, // '4'
+    {0x2E, 0x4A, 0x4A, 0x4A, 0x32, 0x00}, // '5'
+    {0x3C, 0x4A, 0x4A, 0x4A, 0x32, 0x00}, // '6'
+    {0x02, 0x02, 0x72, 0x0A, 0x06, 0x00}, // '7'
+    {0x34, 0x4A, 0x4A, 0x4A, 0x34, 0x00}, // '8'
+    {0x24, 0x4A, 0x4A, 0x4A, 0x3C, 0x00}, // '9'
+    {0x7C, 0x0A, 0x0A, 0x0A, 0x7C, 0x00}, // 'A'
+    {0x7E, 0x4A, 0x4A, 0x4A, 0x34, 0x00}, // 'B'
+    {0x7E, 0x4A, 0x4A, 0x4A, 0x42, 0x00}, // 'E'
+    {0x7E, 0x0A, 0x0A, 0x0A, 0x02, 0x00}, // 'F'
+    {0x7E, 0x08, 0x08, 0x08, 0x7E, 0x00}, // 'H'
+    {0x00, 0x42, 0x7E, 0x42, 0x00, 0x00}, // 'I'
+    {0x7E, 0x04, 0x08, 0x04, 0x7E, 0x00}, // 'M'
+    {0x7E, 0x0A, 0x0A, 0x0A, 0x74, 0x00}, // 'R'
+    {0x44, 0x4A, 0x4A, 0x4A, 0x32, 0x00}, // 'S'
+    {0x44, 0x64, 0x54, 0x4C, 0x44, 0x00}, // 'z'
+    {0x00, 0x00, 0x18, 0x18, 0x00, 0x00}, // 0x80
+    {0x00, 0x3C, 0x3C, 0x3C, 0x3C, 0x00}, // 0x81
+    {0x08, 0x1C, 0x2A, 0x08, 0x08, 0x08}, // 0x82
+    {0x08, 0x08, 0x08, 0x2A, 0x1C, 0x08}, // 0x83
+    {0x08, 0x04, 0x7E, 0x04, 0x08, 0x00}, // 0x84
+    {0x10, 0x20, 0x7E, 0x20, 0x10, 0x00}, // 0x85
+};
+
+void test_font_original_glyphs(void) {
+    for (uint8_t i = 0; test_font_chars[i]; i++) {
+        uint8_t glyph = (uint8_t)test_font_chars[i] - FONT_FIRST;
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(test_font_glyphs[i], font_glyphs[glyph], FONT_WIDTH);
+    }
+}
+
+/* OLED */
+
+void test_oled_clear_stream(void) {
+    // One command run for the window, one data run for the RAM
+    const uint8_t window[] = {0x00, 0x21, 0, 127, 0x22, 0, 7, 0x40};
+
+    TEST_ASSERT_EQUAL_UINT8(0, oled_init());
+    hal_native_twi_log_len = 0;
+    TEST_ASSERT_EQUAL_UINT8(0, oled_clear());
+    TEST_ASSERT_EQUAL_UINT16(sizeof(window) + 1024, hal_native_twi_log_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(window, hal_native_twi_log, sizeof(window));
+    for (uint16_t i = sizeof(window); i < hal_native_twi_log_len; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0, hal_native_twi_log[i]);
+    }
+}
+
+/* Video RX */
+
+void test_freq_to_data(void) {
+    // Raceband 1, N = 80 and A = 29 in 2 MHz steps
+    TEST_ASSERT_EQUAL_HEX32(0x281D, _freq_to_data(5658));
+    // The channel database was generated with the same formula.
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        uint32_t word = (((_freq_to_data(channel_freq(i)) << 1) | 1) << 4) | 0x01;
+        TEST_ASSERT_EQUAL_HEX32(channel_word(i), word);
+    }
+}
+
+/* Scheduler */
+
+// Runs of the test driver, and the slices it lets pass during them
+uint8_t test_runs;
+uint8_t test_ticks_inside;
+
+void _test_driver(void) {
+    test_runs++;
+    while (test_ticks_inside) {
+        test_ticks_inside--;
+        TIMER1_CAPT_vect();
+    }
+}
+
+/* This function is used internally to start the scheduler
+ * with only the first task, which runs _test_driver() every
+ * slice with the overrun policy.
+ */
+rtos_task_t *_test_task(uint8_t overrun, uint8_t deadline) {
+    state_subscriber_count = 0;
+    TEST_ASSERT_EQUAL_UINT8(0, rtos_init(RTOS_SLICE_US));
+    for (uint8_t i = 0; rtos_task_list[i] != 0; i++) {
+        rtos_task_list[i]->driver = _test_driver;
+        rtos_task_list[i]->suspended = 1;
+    }
+
+    rtos_task_t *task = rtos_task_list[0];
+    task->suspended = 0;
+    task->period = 1;
+    task->deadline = deadline;
+    task->overrun = overrun;
+
+    TIMER1_CAPT_vect();
+    while (rtos_dispatch());
+    test_runs = 0;
+    task->stats.misses = 0;
+    return task;
+}
+
+void test_rtos_defer_keeps_release(void) {
+    rtos_task_t *task = _test_task(RTOS_OVERRUN_DEFER, 3);
+
+    // Released again while it runs, it runs once more after.
+    test_ticks_inside = 1;
+    TIMER1_CAPT_vect();
+    while (rtos_dispatch());
+    TEST_ASSERT_EQUAL_UINT8(2, test_runs);
+    TEST_ASSERT_EQUAL_UINT16(0, task->stats.misses);
+    TEST_ASSERT_EQUAL_UINT8(RTOS_TASK_IDLE, task->state);
+}
+
+void test_rtos_skip_drops_release(void) {
+    rtos_task_t *task = _test_task(RTOS_OVERRUN_SKIP, 3);
+
+    test_ticks_inside = 1;
+    TIMER1_CAPT_vect();
+    while (rtos_dispatch());
+    TEST_ASSERT_EQUAL_UINT8(1, test_runs);
+    TEST_ASSERT_EQUAL_UINT16(1, task->stats.misses);
+}
+
+void test_rtos_deadline_miss(void) {
+    rtos_task_t *task = _test_task(RTOS_OVERRUN_SKIP, 1);
+
+    // The deadline and the release fall on the same slice, one miss.
+    test_ticks_inside = 1;
+    TIMER1_CAPT_vect();
+    while (rtos_dispatch());
+    TEST_ASSERT_EQUAL_UINT16(1, task->stats.misses);
+}
+
+/* Lap timer */
+
+/* This function is used internally to feed the detector
+ * count samples of the same RSSI.
+ */
+void _laps_feed(uint8_t rssi, uint16_t count) {
+    uint16_t samples[VIDEO_RX_RSSI_BUFFER_LEN];
+    for (uint8_t i = 0; i < VIDEO_RX_RSSI_BUFFER_LEN; i++) {
+        samples[i] = _laps_to_sample(rssi);
+    }
+    while (count) {
+        uint8_t n = count < VIDEO_RX_RSSI_BUFFER_LEN ? count : VIDEO_RX_RSSI_BUFFER_LEN;
+        laps_process(samples, n);
+        count -= n;
+    }
+}
+
+/* Samples of a pass. The peak is the 6th of them, the last
+ * one falls below the exit threshold and ends the pass.
+ */
+#define TEST_PASS_SAMPLES   12
+
+void _laps_pass_by(void) {
+    for (uint8_t i = 0; i < TEST_PASS_SAMPLES - 1; i++) {
+        _laps_feed(90 - 5 * (i > 5 ? i - 5 : 5 - i), 1);
+    }
+    _laps_feed(20, 1);
+}
+
+void test_laps(void) {
+    laps_config_t config = {.enter = 60, .exit = 45, .filter = 0, .min_lap_ms = 3000};
+    TEST_ASSERT_EQUAL_UINT8(0, laps_configure(&config));
+    laps_start(5800);
+
+    // The first pass starts the clock.
+    _laps_feed(20, 100);
+    _laps_pass_by();
+    TEST_ASSERT_EQUAL_UINT16(0, laps_count());
+
+    // 10000 samples later, a lap of 4.16 s
+    _laps_feed(20, 10000 - TEST_PASS_SAMPLES);
+    _laps_pass_by();
+    TEST_ASSERT_EQUAL_UINT16(1, laps_count());
+    TEST_ASSERT_EQUAL_UINT32(10000 * VIDEO_RX_SAMPLE_US, laps_time(0));
+
+    // Too soon after it, ignored
+    _laps_feed(20, 100);
+    _laps_pass_by();
+    TEST_ASSERT_EQUAL_UINT16(1, laps_count());
+
+    _laps_feed(20, 9000 - 100 - 2 * TEST_PASS_SAMPLES);
+    _laps_pass_by();
+    TEST_ASSERT_EQUAL_UINT16(2, laps_count());
+    TEST_ASSERT_EQUAL_UINT32(9000 * VIDEO_RX_SAMPLE_US, laps_time(0));
+    TEST_ASSERT_EQUAL_UINT32(9000 * VIDEO_RX_SAMPLE_US, laps_best());
+
+    laps_pass_t pass;
+    laps_last_pass(&pass);
+    TEST_ASSERT_EQUAL_UINT16(2, pass.lap);
+    TEST_ASSERT_EQUAL_UINT8(90, pass.peak);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_settings_empty);
+    RUN_TEST(test_settings_load_during_write);
+    RUN_TEST(test_settings_ring_wraps);
+    RUN_TEST(test_settings_damaged_record);
+    RUN_TEST(test_crc16);
+    RUN_TEST(test_telemetry_cobs);
+    RUN_TEST(test_font_original_glyphs);
+    RUN_TEST(test_oled_clear_stream);
+    RUN_TEST(test_freq_to_data);
+    RUN_TEST(test_rtos_defer_keeps_release);
+    RUN_TEST(test_rtos_skip_drops_release);
+    RUN_TEST(test_rtos_deadline_miss);
+    RUN_TEST(test_laps);
+    return UNITY_END();
+}